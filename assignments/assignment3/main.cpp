@@ -361,11 +361,14 @@ int main() {
 		deferredShader.setVec3("_EyePos", mainCamera.position);
 
 		for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
-			//Creates prefix "_PointLights[0]." etc
-			std::string prefix = "_PointLights[" + std::to_string(i) + "].";
-			deferredShader.setVec3(prefix + "position", pointLights[i].position);
-			deferredShader.setFloat(prefix + "radius", pointLights[i].radius);
-			deferredShader.setVec4(prefix + "color", pointLights[i].color);
+			//Builds "_PointLights[0].position" etc on the stack rather than in a new string per field
+			char name[64];
+			snprintf(name, sizeof(name), "_PointLights[%d].position", i);
+			deferredShader.setVec3(name, pointLights[i].position);
+			snprintf(name, sizeof(name), "_PointLights[%d].radius", i);
+			deferredShader.setFloat(name, pointLights[i].radius);
+			snprintf(name, sizeof(name), "_PointLights[%d].color", i);
+			deferredShader.setVec4(name, pointLights[i].color);
 		}
 
 
@@ -30,8 +30,42 @@ struct PointLight{
 	vec4 color;
 };
 
-#define MAX_POINT_LIGHTS 64
-uniform PointLight _PointLights[MAX_POINT_LIGHTS];
+#ifdef LEGACY_UNIFORM_LIGHTS
+//The uniform array lights were set through before ew::LightBuffer. Only built for the light upload benchmark.
+#define LEGACY_MAX_POINT_LIGHTS 64
+uniform int _NumPointLights;
+uniform PointLight _PointLights[LEGACY_MAX_POINT_LIGHTS];
+#else
+//Filled by ew::LightBuffer
+layout(std430, binding = 0) readonly buffer PointLightBuffer
+{
+	int _NumPointLights;
+	PointLight _PointLights[];
+};
+#endif
+
+//Filled by ew::ClusterBuffer. Each cluster is (offset, count) into _ClusterLightIndices
+layout(std430, binding = 1) readonly buffer ClusterBuffer
+{
+	uvec2 _Clusters[];
+};
+layout(std430, binding = 2) readonly buffer ClusterLightIndexBuffer
+{
+	uint _ClusterLightIndices[];
+};
+
+//Filled by an ew::UniformBlock
+layout(std140, binding = 0) uniform ClusterParams
+{
+	mat4 _View;
+	float _NearPlane;
+	float _FarPlane;
+	int _ClusterTilesX;
+	int _ClusterTilesY;
+	int _ClusterSlices;
+	int _UseClusters;
+	ivec2 _ClusterPadding; //Rounds the block up to 96 bytes, the size of ClusterParams on the CPU
+};
 
 uniform Material _Material;
 
@@ -74,29 +108,7 @@ vec3 calcPointLight(PointLight light,vec3 normal,vec3 pos)
 
 
 
-float calcShadow(sampler2D shadowMap, vec4 lightSpacePos, float bias)
-{
-	vec3 sampleCoord = lightSpacePos.xyz / lightSpacePos.w;
-	sampleCoord = sampleCoord * 0.5 + 0.5;
-
-	float myDepth = sampleCoord.z - bias;
-
-	float totalShadow = 0;
-	vec2 texelOffset = 1.0 / textureSize(_ShadowMap,0);
-
-	for(int y = -1; y <=1; y++)
-	{
-		for(int x = -1; x <=1; x++)
-		{
-			vec2 uv = sampleCoord.xy + vec2(x * texelOffset.x, y * texelOffset.y);
-			totalShadow+=step(texture(_ShadowMap,uv).r,myDepth);
-		}
-	}
-
-	totalShadow /= 9.0;
-
-	return totalShadow;
-}
+#include "include/shadows.glsl"
 
 
 vec3 calculateLighting(vec3 normal, vec3 worldPos, vec3 albedo, vec4 LightSpacePos)
@@ -134,9 +146,25 @@ void main()
 	LightSpacePos = _LightViewProjection * vec4(worldPos, 1);
 	ligthColor += calculateLighting(normal,worldPos,albedo,LightSpacePos);
 
-	for (int i = 0; i < MAX_POINT_LIGHTS; i++)
+	if (_UseClusters == 1)
 	{
-		ligthColor += calcPointLight(_PointLights[i], normal, worldPos);
+		//Same exponential depth slicing as ew::ClusterGrid
+		float depth = -(_View * vec4(worldPos, 1)).z;
+		int slice = int(floor(log(depth / _NearPlane) / log(_FarPlane / _NearPlane) * _ClusterSlices));
+		slice = clamp(slice, 0, _ClusterSlices - 1);
+		ivec2 tile = clamp(ivec2(UV * vec2(_ClusterTilesX, _ClusterTilesY)), ivec2(0), ivec2(_ClusterTilesX - 1, _ClusterTilesY - 1));
+		uvec2 cluster = _Clusters[(slice * _ClusterTilesY + tile.y) * _ClusterTilesX + tile.x];
+		for (uint i = 0u; i < cluster.y; i++)
+		{
+			ligthColor += calcPointLight(_PointLights[_ClusterLightIndices[cluster.x + i]], normal, worldPos);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < _NumPointLights; i++)
+		{
+			ligthColor += calcPointLight(_PointLights[i], normal, worldPos);
+		}
 	}
 
 	//Worldspace lighting calculations, same as in forward shading
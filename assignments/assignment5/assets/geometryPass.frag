@@ -10,11 +10,25 @@ in Surface{
 }fs_in;
 
 
-uniform sampler2D _MainTex;
+//Every material packed into one array, see ew::packTextures
+uniform sampler2DArray _Materials;
+struct MaterialRegion{
+	vec4 rect; //xy offset, zw scale
+	int layer;
+};
+layout(std430, binding = 3) readonly buffer MaterialRegions{
+	MaterialRegion _Regions[];
+};
+uniform int _MaterialIndex;
 
 void main()
 {
 	gPosition = fs_in.WorldPos;
 	gNormal = normalize(fs_in.WorldNormal);
-	gAlbedo = texture(_MainTex, fs_in.TexCoord).rgb;
+	MaterialRegion region = _Regions[_MaterialIndex];
+	//fract repeats inside the rect, gradients come from the unwrapped UV so mips don't jump at the seams
+	vec2 uv = region.rect.xy + fract(fs_in.TexCoord) * region.rect.zw;
+	vec2 dx = dFdx(fs_in.TexCoord) * region.rect.zw;
+	vec2 dy = dFdy(fs_in.TexCoord) * region.rect.zw;
+	gAlbedo = textureGrad(_Materials, vec3(uv, region.layer), dx, dy).rgb;
 }
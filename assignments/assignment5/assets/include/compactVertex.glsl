@@ -0,0 +1,10 @@
+#pragma once
+
+//Inverse of ew::encodeOctahedral, the normal encoding of ew::CompactLayout. Keep the two in step.
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
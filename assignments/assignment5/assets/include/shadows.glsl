@@ -0,0 +1,26 @@
+#pragma once
+
+//3x3 PCF lookup of a depth map. Returns 0 when fully lit and 1 when fully shadowed.
+float calcShadow(sampler2D shadowMap, vec4 lightSpacePos, float bias)
+{
+	vec3 sampleCoord = lightSpacePos.xyz / lightSpacePos.w;
+	sampleCoord = sampleCoord * 0.5 + 0.5;
+
+	float myDepth = sampleCoord.z - bias;
+
+	float totalShadow = 0;
+	vec2 texelOffset = 1.0 / textureSize(shadowMap,0);
+
+	for(int y = -1; y <=1; y++)
+	{
+		for(int x = -1; x <=1; x++)
+		{
+			vec2 uv = sampleCoord.xy + vec2(x * texelOffset.x, y * texelOffset.y);
+			totalShadow+=step(texture(shadowMap,uv).r,myDepth);
+		}
+	}
+
+	totalShadow /= 9.0;
+
+	return totalShadow;
+}
@@ -0,0 +1,69 @@
+#version 450
+
+layout(location = 0) in vec3 vPos;
+#ifdef COMPACT_VERTEX
+layout(location = 1) in vec2 vNormal; //Octahedral, see ew::CompactLayout
+#else
+layout(location = 1) in vec3 vNormal;
+#endif
+layout(location = 2) in vec2 vTexCoord;
+
+uniform mat4 _ViewProjection;
+
+//Global matrices of every node per frame, see ew::BakedAnimation
+uniform sampler2D _BakedAnimation;
+uniform int _NumNodes;
+uniform int _NumFrames;
+uniform float _FrameRate;
+uniform float _Time;
+
+struct RigInstance{
+	vec3 position;
+	float timeOffset;
+};
+layout(std430, binding = 4) readonly buffer RigInstances{
+	RigInstance _Instances[];
+};
+
+out Surface{
+	vec3 WorldPos;
+	vec3 WorldNormal;
+	vec2 TexCoord;
+}vs_out;
+
+#ifdef COMPACT_VERTEX
+#include "include/compactVertex.glsl"
+#endif
+
+mat4 fetchMatrix(int frame, int node)
+{
+	return mat4(texelFetch(_BakedAnimation, ivec2(node * 4, frame), 0),
+		texelFetch(_BakedAnimation, ivec2(node * 4 + 1, frame), 0),
+		texelFetch(_BakedAnimation, ivec2(node * 4 + 2, frame), 0),
+		texelFetch(_BakedAnimation, ivec2(node * 4 + 3, frame), 0));
+}
+
+void main()
+{
+	RigInstance instance = _Instances[gl_InstanceID / _NumNodes];
+	int node = gl_InstanceID % _NumNodes;
+
+	//Same looping and lerp as ew::sampleBakedAnimation
+	float frame = (_Time + instance.timeOffset) * _FrameRate;
+	frame -= floor(frame / float(_NumFrames)) * float(_NumFrames);
+	int frame0 = min(int(frame), _NumFrames - 1);
+	int frame1 = frame0 + 1 < _NumFrames ? frame0 + 1 : 0;
+	float t = clamp(frame - float(frame0), 0.0, 1.0);
+	mat4 model = fetchMatrix(frame0, node) * (1.0 - t) + fetchMatrix(frame1, node) * t;
+	model[3].xyz += instance.position;
+
+#ifdef COMPACT_VERTEX
+	vec3 normal = decodeOctahedral(vNormal);
+#else
+	vec3 normal = vNormal;
+#endif
+	vs_out.WorldPos = vec3(model * vec4(vPos, 1.0));
+	vs_out.WorldNormal = transpose(inverse(mat3(model))) * normal;
+	vs_out.TexCoord = vTexCoord;
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos, 1.0);
+}
@@ -31,29 +31,7 @@ struct Material
 
 uniform Material _Material;
 
-float calcShadow(sampler2D shadowMap, vec4 lightSpacePos, float bias)
-{
-	vec3 sampleCoord = lightSpacePos.xyz / lightSpacePos.w;
-	sampleCoord = sampleCoord * 0.5 + 0.5;
-
-	float myDepth = sampleCoord.z - bias;
-
-	float shadows = 0;
-	vec2 texelOffset = 1.0 / textureSize(_ShadowMap,0);
-
-	for(int y = -1; y <=1; y++)
-	{
-		for(int x = -1; x <=1; x++)
-		{
-			vec2 uv = sampleCoord.xy + vec2(x * texelOffset.x, y * texelOffset.y);
-			shadows+=step(texture(_ShadowMap,uv).r,myDepth);
-		}
-	}
-
-	shadows /= 9.0;
-
-	return shadows;
-}
+#include "include/shadows.glsl"
 
 void main()
 {
@@ -1,7 +1,11 @@
 #version 450
 
 layout(location = 0) in vec3 vPos;
+#ifdef COMPACT_VERTEX
+layout(location = 1) in vec2 vNormal; //Octahedral, see ew::CompactLayout
+#else
 layout(location = 1) in vec3 vNormal;
+#endif
 layout(location = 2) in vec2 vTexCoord;
 
 uniform mat4 _Model;
@@ -16,10 +20,19 @@ out Surface{
 
 out vec4 LightSpacePos;
 
+#ifdef COMPACT_VERTEX
+#include "include/compactVertex.glsl"
+#endif
+
 void main()
 {
+#ifdef COMPACT_VERTEX
+	vec3 normal = decodeOctahedral(vNormal);
+#else
+	vec3 normal = vNormal;
+#endif
 	vs_out.WorldPos = vec3(_Model * vec4(vPos, 1.0));
-	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * vNormal;
+	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * normal;
 	vs_out.TexCoord = vTexCoord;
 	LightSpacePos = _LightViewProjection * _Model * vec4(vPos, 1);
 	gl_Position = _ViewProjection * _Model * vec4(vPos, 1.0);
@@ -9,13 +9,37 @@
 #include <ew/transform.h>
 #include <ew/cameraController.h>
 #include <ew/texture.h>
+#include <ew/mipmap.h>
+#include <ew/textureCompression.h>
+#include <ew/texturePacker.h>
+#include <ew/textureStreamer.h>
 #include <ew/procGen.h>
+#include <ew/lightBuffer.h>
+#include <ew/clusterGrid.h>
+#include <ew/modelLoader.h>
+#include <ew/frameArena.h>
+#include <ew/allocationCounter.h>
+#include <ew/transformHierarchy.h>
+#include <ew/animation.h>
+#include <ew/animationCompression.h>
+#include <ew/jobSystem.h>
+#include <ew/animationBaker.h>
+#include <ew/instancedRig.h>
+
+#include <chrono>
+#include <vector>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+// Shaders are read from the source tree when CMake defines SHADER_DIR, so edits that hot reload land in the files
+// under version control rather than in the copies the next build overwrites
+#ifndef SHADER_DIR
+#define SHADER_DIR "assets/"
+#endif
+
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
 
@@ -52,13 +76,138 @@ struct Light {
 	glm::vec3 lightColor = glm::vec3(1);
 }light;
 
-struct PointLight {
-	glm::vec3 position;
-	float radius;
-	glm::vec4 color;
+const int MAX_POINT_LIGHTS = 16384;
+int numPointLights = 64;
+std::vector<ew::PointLight> pointLights;
+
+// Lays lights out in a square grid, 5 units apart
+void createPointLights(int count)
+{
+	pointLights.resize(count);
+	int side = (int)ceilf(sqrtf((float)count));
+	for (int i = 0; i < count; i++)
+	{
+		int x = i / side;
+		int y = i % side;
+		pointLights[i].position = glm::vec3((x * 5) + 1, -0.5, (y * 5) + 1);
+		pointLights[i].radius = 5.0;
+		pointLights[i].color = glm::vec4(rand() % 4, rand() % 4, rand() % 4, 1);
+	}
+}
+
+struct ClusteredLighting {
+	bool enabled = true;
+	float buildMs = 0.0f;
+	unsigned int numIndices = 0;
+}clusteredLighting;
+
+// Matches the std140 ClusterParams block in deferredLit.frag
+struct ClusterParams {
+	glm::mat4 view;
+	float nearPlane;
+	float farPlane;
+	int tilesX;
+	int tilesY;
+	int slices;
+	int useClusters;
+	int padding[2];
 };
-const int MAX_POINT_LIGHTS = 64;
-PointLight pointLights[MAX_POINT_LIGHTS];
+
+struct LightUploadBenchmark {
+	static const int LEGACY_MAX_LIGHTS = 64; //Size of the uniform array in the LEGACY_UNIFORM_LIGHTS permutation
+	int counts[3] = { 64, 1024, 16384 };
+	float uniformMs[3] = {}; //Negative where the count is over the uniform array's size
+	float lightBufferMs[3] = {};
+	bool hasRun = false;
+}lightUploadBenchmark;
+
+struct MeshCacheBenchmark {
+	float coldMs = 0.0f;
+	float warmMs = 0.0f;
+	bool hasRun = false;
+}meshCacheBenchmark;
+
+struct HierarchyBenchmark {
+	int numNodes = 100000;
+	float recursiveMs = 0.0f;
+	float flatMs = 0.0f;
+	float flatPartialMs = 0.0f; //With a few nodes' local transforms changed
+	unsigned int partialUpdated = 0;
+	bool hasRun = false;
+}hierarchyBenchmark;
+
+struct AnimationBenchmark {
+	int numRigs = 10000;
+	int numChannels = 0;
+	float updateMs = 0.0f;
+	bool hasRun = false;
+}animationBenchmark;
+
+struct AnimationCompressionBenchmark {
+	int numChannels = 30;
+	int numKeys = 300; //10 seconds at 30 keys a second
+	int numInstances = 1000;
+	size_t rawBytes = 0;
+	size_t compressedBytes = 0;
+	float maxError = 0.0f; //Largest difference in any local matrix element
+	float rawMs = 0.0f;
+	float compressedMs = 0.0f;
+	bool hasRun = false;
+}animationCompressionBenchmark;
+
+struct JobScalingBenchmark {
+	static const int MAX_THREADS = 64;
+	int numMechs = 500;
+	int numThreads = 0; //Frame times for 1 through this many
+	float frameMs[MAX_THREADS] = {};
+	uint64_t allocations = 0; //Over every timed frame
+	bool hasRun = false;
+}jobScalingBenchmark;
+
+struct ObjReaderBenchmark {
+	int sizesMb[4] = { 1, 10, 100, 1000 };
+	float objReaderMs[4] = {};
+	float assimpMs[4] = {};
+	bool includeLargest = false; //The 1GB file takes minutes through Assimp
+	bool hasRun = false;
+}objReaderBenchmark;
+
+struct TextureCompressionBenchmark {
+	const char* names[4] = { "BC1", "BC3", "BC5", "BC7" };
+	ew::TextureCompression formats[4] = { ew::TextureCompression::BC1, ew::TextureCompression::BC3, ew::TextureCompression::BC5, ew::TextureCompression::BC7 };
+	float encodeMs[4] = {};
+	float psnr[4] = {}; //Over the channels each format stores, level 0
+	size_t compressedBytes[4] = {}; //Whole mip chain
+	size_t uncompressedBytes = 0; //Whole mip chain as RGBA8, which is how drivers store RGB8
+	int width = 0;
+	int height = 0;
+	bool hasRun = false;
+}textureCompressionBenchmark;
+
+struct TextureStreaming {
+	int brickTexture = -1;
+	int floorTexture = -1;
+	float budgetMb = 4.0f;
+}textureStreaming;
+
+struct FrameMemory {
+	ew::AllocationCounter allocations; //Over the whole previous frame
+	size_t arenaBytes = 0;
+	size_t arenaPeakBytes = 0;
+}frameMemory;
+
+struct LevelOfDetail {
+	bool enabled = true;
+	float maxScreenError = 0.001f; //Fraction of the screen height
+}levelOfDetail;
+
+struct BakedCrowd {
+	bool enabled = false;
+	int numMechs = 100;
+	float spacing = 10.0f;
+	int numFrames = 0; //Of the bake
+	size_t bakedBytes = 0;
+}bakedCrowd;
 
 struct Shadow {
 	float minBias = 0.007;
@@ -162,106 +311,35 @@ Framebuffer createGBuffer(unsigned int width, unsigned int height)
 #pragma endregion
 
 
-void drawUI(Framebuffer& gBuffer, unsigned int shadowMap);
+void drawUI(Framebuffer& gBuffer, unsigned int shadowMap, const ew::Shader& deferredShader, const ew::ModelLoadOptions& modelOptions, ew::JobSystem* jobs,
+	ew::TextureStreamer* textureStreamer, const ew::CompactModelHandle& monkeyModel, const ew::TransformHierarchy& mech, const std::vector<ew::AnimationClip>& mechClips);
+void runLightUploadBenchmark();
+void runMeshCacheBenchmark(const std::string& filePath, const ew::ModelLoadOptions& options);
+void runHierarchyBenchmark();
+void runAnimationBenchmark(const std::vector<ew::AnimationClip>& mechClips);
+void runAnimationCompressionBenchmark();
+void runJobScalingBenchmark(const ew::TransformHierarchy& mech, const std::vector<ew::AnimationClip>& mechClips);
+void runObjReaderBenchmark(ew::JobSystem* jobs);
+void runTextureCompressionBenchmark(const char* filePath, ew::JobSystem* jobs);
 
 
 // Monkey Mech structs and functs
 
-struct KeyFrame 
-{
-	glm::vec3 position;
-	glm::quat rotation;
-	glm::vec3 scale;
-	float time;
-};
-
-float InvLerp(float prevTime, float nextTime, float currentTime) 
-{
-	float time = (currentTime - prevTime) / (nextTime - prevTime);
-	return time;
-}
-
-glm::vec3 Lerp(glm::vec3 prevKey, glm::vec3 nextKey, float time) 
-{
-	glm::vec3 vec = ((nextKey - prevKey) * time) + prevKey;
-	return vec;
-}
-
-glm::quat Slerp(glm::quat q1, glm::quat q2, float t) 
-{
-	float angle = acos(dot(q1, q2));
-	float denominator = sin(angle);
-
-	if (denominator == 0)
-	{
-		return q1;
-	}
-
-	return (q1 * sin((1 - t) * angle) + q2 * sin(t * angle)) / denominator;
-}
-
 glm::mat4 CalcTransform(glm::vec3 position, glm::quat rotation, glm::vec3 scale) 
 {
-	glm::mat4 mat = glm::mat4(1.0f);
-	mat = glm::translate(mat, position);
-	mat *= glm::mat4_cast(rotation);
-	mat = glm::scale(mat, scale);
-
-	return mat;
+	return ew::composeTransform(position, rotation, scale);
 }
 
-struct AnimationClip 
-{
-	KeyFrame keyFrames[10];
-	int numKeyFrames = 0;
-	float localTime = 0.0f;
-	float duration;
-
-	glm::mat4 Update(float dt) 
-	{
-		localTime += dt;
-
-		if (localTime > duration)
-			localTime = 0.0f;
-
-		glm::vec3 newPosition = glm::vec3(0);
-		glm::quat newRotation = glm::quat(1, 0, 0, 0);
-		glm::vec3 newScale = glm::vec3(1);
-
-		for (int i = 0; i < numKeyFrames; i++) 
-		{
-			if (keyFrames[i].time > localTime) 
-			{
-				float t = InvLerp(keyFrames[i - 1].time, keyFrames[i].time, localTime);
-				newPosition = Lerp(keyFrames[i - 1].position, keyFrames[i].position, t);
-				newRotation = Slerp(keyFrames[i - 1].rotation, keyFrames[i].rotation, t);
-				newScale = Lerp(keyFrames[i - 1].scale, keyFrames[i].scale, t);
-
-				break;
-			}
-		}
-
-		return CalcTransform(newPosition, newRotation, newScale);
-	}
-};
-
-void AddFrameToAnim(AnimationClip* anim, float time, glm::vec3 position, glm::quat rotation, glm::vec3 scale) 
+// Keys the single channel of a mech part's clip. Its node is set when the part is added.
+void AddFrameToAnim(ew::AnimationClip* anim, float time, glm::vec3 position, glm::quat rotation, glm::vec3 scale) 
 {
-	KeyFrame newFrame;
-	newFrame.time = time;
-	newFrame.position = position;
-	newFrame.rotation = rotation;
-	newFrame.scale = scale;
+	if (anim->channels.empty())
+		anim->addChannel(-1);
 
-	if (anim->duration < time)
-	{
-		anim->duration = time;
-	}
-
-	anim->keyFrames[anim->numKeyFrames] = newFrame;
-	anim->numKeyFrames++;
+	anim->addKey(0, time, position, rotation, scale);
 }
 
+// Pointer tree the mech used before TransformHierarchy, kept as the baseline for the hierarchy benchmark
 struct Node 
 {
 	glm::mat4 localTransform;
@@ -269,14 +347,6 @@ struct Node
 	Node* parent;
 	Node* children[10];
 	unsigned int numChildren;
-
-	AnimationClip animation;
-
-	void Update(float dt) 
-	{
-		if (animation.numKeyFrames != 0)
-			localTransform = animation.Update(dt);
-	}
 };
 
 void SolveFKRecursive(Node* node) 
@@ -290,14 +360,13 @@ void SolveFKRecursive(Node* node)
 	}
 }
 
-Node* AddNode(Node* parent, AnimationClip anim) 
+Node* AddNode(Node* parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale) 
 {
 	Node* newNode = new Node;
 
 	newNode->parent = parent;
+	newNode->localTransform = CalcTransform(position, rotation, scale);
 	newNode->numChildren = 0;
-	newNode->animation = anim;
-	newNode->localTransform = CalcTransform(anim.keyFrames[0].position, anim.keyFrames[0].rotation, anim.keyFrames[0].scale);
 
 	if (parent != NULL) {
 		parent->children[parent->numChildren] = newNode;
@@ -307,70 +376,213 @@ Node* AddNode(Node* parent, AnimationClip anim)
 	return newNode;
 }
 
-Node* AddNode(Node* parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale) 
+void ClearNodesRecursive(Node* node) 
 {
-	Node* newNode = new Node;
+	for (int i = 0; i < node->numChildren; i++)
+		ClearNodesRecursive(node->children[i]);
 
-	newNode->parent = parent;
-	newNode->localTransform = CalcTransform(position, rotation, scale);
-	newNode->numChildren = 0;
+	delete(node);
+}
 
-	if (parent != NULL) {
-		parent->children[parent->numChildren] = newNode;
-		parent->numChildren++;
-	}
+// Each animated mech part has a clip of its own, so each loops at its own length
+int AddMechNode(ew::TransformHierarchy* mech, std::vector<ew::AnimationClip>* clips, int parent, const ew::AnimationClip& anim) 
+{
+	const ew::AnimationChannel& channel = anim.channels[0];
+	int node = mech->addNode(parent, CalcTransform(channel.position.values[0], channel.rotation.values[0], channel.scale.values[0]));
 
-	return newNode;
+	clips->push_back(anim);
+	clips->back().channels[0].node = node;
+
+	return node;
 }
 
-void UpdateAnimsRecursive(Node* node, float dt) 
+int AddMechNode(ew::TransformHierarchy* mech, int parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale) 
 {
-	node->Update(dt);
+	return mech->addNode(parent, CalcTransform(position, rotation, scale));
+}
 
-	for (int i = 0; i < node->numChildren; i++)
-		UpdateAnimsRecursive(node->children[i], dt);
+void UpdateMechAnims(ew::TransformHierarchy* mech, std::vector<ew::AnimationPlayer>& players, float dt) 
+{
+	for (size_t i = 0; i < players.size(); i++) 
+	{
+		players[i].update(dt);
+		mech->setLocalTransform(players[i].getNode(0), players[i].getLocalTransform(0, 0));
+	}
 }
 
-void DrawNodesRecursively(ew::Shader shader, ew::Model model, Node* node) 
+// Shortest time that every clip loops a whole number of times in, with durations rounded to milliseconds.
+// Clips that don't move don't count. 0 if none move.
+float GetCommonPeriod(const std::vector<ew::AnimationClip>& clips) 
 {
-	shader.setInt("_MainTex", 0);
-	shader.setMat4("_Model", node->globalTransform);
-	model.draw();
+	long long period = 0;
+	for (size_t i = 0; i < clips.size(); i++) 
+	{
+		long long ms = (long long)roundf(clips[i].duration * 1000.0f);
+		if (ms <= 0) 
+		{
+			continue;
+		}
+		if (period == 0) 
+		{
+			period = ms;
+			continue;
+		}
+		long long a = period, b = ms;
+		while (b != 0) 
+		{
+			long long r = a % b;
+			a = b;
+			b = r;
+		}
+		period = period / a * ms;
+	}
+	return period / 1000.0f;
+}
 
-	for (int i = 0; i < node->numChildren; i++)
-		DrawNodesRecursively(shader, model, node->children[i]);
+// Appends track's keys every loopDuration up to endTime, the same motion as playing the track on its own loop
+template<typename Track>
+void AppendLoopedKeys(const Track& track, float loopDuration, float endTime, Track* out) 
+{
+	int numLoops = loopDuration > 0.0f ? glm::max((int)roundf(endTime / loopDuration), 1) : 1;
+	for (int loop = 0; loop < numLoops; loop++) 
+	{
+		for (size_t k = 0; k < track.times.size(); k++) 
+		{
+			out->times.push_back(track.times[k] + loop * loopDuration);
+			out->values.push_back(track.values[k]);
+		}
+	}
 }
 
-void ClearNodesRecursive(Node* node) 
+// One clip with a channel per animated part. Parts loop on their own durations, so the clip runs for the common
+// period (4s for parts of 0.4, 0.5 and 0.8s) with each part's keys repeated to fill it.
+ew::AnimationClip MergeMechClips(const std::vector<ew::AnimationClip>& clips) 
 {
-	for (int i = 0; i < node->numChildren; i++)
-		ClearNodesRecursive(node->children[i]);
+	ew::AnimationClip rig;
+	rig.duration = GetCommonPeriod(clips);
+	for (size_t i = 0; i < clips.size(); i++) 
+	{
+		const ew::AnimationChannel& part = clips[i].channels[0];
+		ew::AnimationChannel channel;
+		channel.node = part.node;
+		AppendLoopedKeys(part.position, clips[i].duration, rig.duration, &channel.position);
+		AppendLoopedKeys(part.rotation, clips[i].duration, rig.duration, &channel.rotation);
+		AppendLoopedKeys(part.scale, clips[i].duration, rig.duration, &channel.scale);
+		rig.channels.push_back(channel);
+	}
+	return rig;
+}
 
-	delete(node);
+// A square grid of baked mechs behind the live one, each at a different point in the walk
+void PlaceBakedCrowd(ew::InstancedRig* crowd, int numMechs, float spacing, float duration) 
+{
+	std::vector<ew::RigInstance> instances(numMechs);
+	int columns = (int)ceilf(sqrtf((float)numMechs));
+	for (int i = 0; i < numMechs; i++) 
+	{
+		int row = i / columns;
+		int column = i % columns;
+		instances[i].position = glm::vec3((column - (columns - 1) * 0.5f) * spacing, 0.0f, -(row + 1) * spacing);
+		instances[i].timeOffset = duration * fmodf(i * 0.618034f, 1.0f);
+	}
+	crowd->setInstances(instances.data(), (unsigned int)numMechs);
+}
+
+// Samples and solves a crowd of mechs, each with its own copy of the hierarchy, in ranges spread over the job
+// system's threads. Ranges share nothing, and nothing is allocated.
+void UpdateMechCrowd(ew::JobSystem* jobs, ew::AnimationPlayer* player, std::vector<ew::TransformHierarchy>* rigs, float dt) 
+{
+	jobs->parallelFor((unsigned int)rigs->size(), 32, [&](unsigned int begin, unsigned int end) 
+	{
+		player->update(dt, (int)begin, (int)(end - begin));
+		for (unsigned int i = begin; i < end; i++) 
+		{
+			ew::TransformHierarchy& rig = (*rigs)[i];
+			for (size_t c = 0; c < player->getNumChannels(); c++)
+				rig.setLocalTransform(player->getNode((int)c), player->getLocalTransform((int)i, (int)c));
+			rig.update();
+		}
+	});
+}
+
+void DrawMech(const ew::Shader& shader, ew::UniformHandle modelUniform, const ew::CompactModelHandle& model, const ew::TransformHierarchy& mech) 
+{
+	for (size_t i = 0; i < mech.getNumNodes(); i++) 
+	{
+		const glm::mat4& transform = mech.getGlobalTransform((int)i);
+		shader.setMat4(modelUniform, transform);
+		if (levelOfDetail.enabled)
+			model.draw(mainCamera, transform, levelOfDetail.maxScreenError);
+		else
+			model.draw();
+	}
 }
 
 int main() {
 	GLFWwindow* window = initWindow("Assignment 3", screenWidth, screenHeight);
 
-	// Shader setup
-	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
-	ew::Shader postProcessShader = ew::Shader("assets/postprocess.vert", "assets/postprocess.frag");
-	ew::Shader shadowShader = ew::Shader("assets/depthOnly.vert", "assets/depthOnly.frag");
-	ew::Shader deferredShader = ew::Shader("assets/postprocess.vert", "assets/deferredLit.frag");
-	ew::Shader geometryShader = ew::Shader("assets/lit.vert", "assets/geometryPass.frag");
-	ew::Shader lightOrbShader = ew::Shader("assets/lightOrb.vert", "assets/lightOrb.frag");
-
-	// Model setup
-	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
+	// Shader setup, all compiled in parallel and loaded from program binaries after the first run.
+	// Edits to any of their files, includes too, are reloaded while running. Shaders reading mesh
+	// normals are built for the compact vertex layout every mesh here uses.
+	auto shaderStart = std::chrono::high_resolution_clock::now();
+	ew::ShaderCompiler shaderCompiler(window, true);
+	ew::ShaderHandle litHandle = shaderCompiler.build(SHADER_DIR "lit.vert", SHADER_DIR "lit.frag", { "COMPACT_VERTEX" });
+	ew::ShaderHandle postProcessHandle = shaderCompiler.build(SHADER_DIR "postprocess.vert", SHADER_DIR "postprocess.frag");
+	ew::ShaderHandle shadowHandle = shaderCompiler.build(SHADER_DIR "depthOnly.vert", SHADER_DIR "depthOnly.frag");
+	ew::ShaderHandle deferredHandle = shaderCompiler.build(SHADER_DIR "postprocess.vert", SHADER_DIR "deferredLit.frag");
+	ew::ShaderHandle geometryHandle = shaderCompiler.build(SHADER_DIR "lit.vert", SHADER_DIR "geometryPass.frag", { "COMPACT_VERTEX" });
+	ew::ShaderHandle lightOrbHandle = shaderCompiler.build(SHADER_DIR "lightOrb.vert", SHADER_DIR "lightOrb.frag");
+	ew::ShaderHandle instancedRigHandle = shaderCompiler.build(SHADER_DIR "instancedRig.vert", SHADER_DIR "geometryPass.frag", { "COMPACT_VERTEX" });
+	shaderCompiler.finish();
+	ew::Shader shader = litHandle.get();
+	ew::Shader postProcessShader = postProcessHandle.get();
+	ew::Shader shadowShader = shadowHandle.get();
+	ew::Shader deferredShader = deferredHandle.get();
+	ew::Shader geometryShader = geometryHandle.get();
+	ew::Shader lightOrbShader = lightOrbHandle.get();
+	ew::Shader instancedRigShader = instancedRigHandle.get();
+	ew::ShaderCacheStats shaderStats = ew::getShaderCacheStats();
+	printf("Shader setup took %.1fms (%s), %u of %u programs loaded from binaries, saving %.1fms\n",
+		std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - shaderStart).count(),
+		shaderCompiler.isParallel() ? "driver compiler threads" : "worker context",
+		shaderStats.binariesLoaded, shaderStats.programsCompiled, shaderStats.msSaved);
+
+	// One scheduler for everything: model and texture loads run as background tasks, and clustered light
+	// assignment and the loaders' inner loops as jobs
+	ew::JobSystem jobSystem;
+
+	// Model setup, imported in the background and uploaded a little each frame
+	ew::ModelLoadOptions modelOptions;
+	modelOptions.optimizeMeshes = true;
+	modelOptions.lodRatios = { 0.5f, 0.25f, 0.125f };
+	modelOptions.useMeshCache = true;
+	modelOptions.useObjReader = true;
+	ew::CompactModelLoader modelLoader(&jobSystem);
+	ew::CompactModelHandle monkeyModel = modelLoader.load("assets/Suzanne.obj", modelOptions);
 
 	// Mesh setup
-	ew::Mesh planeMesh = ew::Mesh(ew::createPlane(10, 10, 5));
-	ew::Mesh sphereMesh = ew::Mesh(ew::createSphere(1.0f, 8));
+	ew::CompactMesh planeMesh = ew::CompactMesh(ew::createPlane(10, 10, 5, true));
+	ew::CompactMesh sphereMesh = ew::CompactMesh(ew::createSphere(1.0f, 8, true));
 	planeTransform.position = glm::vec3(0.0f, -1.0f, 0.0f);
 
-	// Texture setup
-	GLuint floorTexture = ew::loadTexture("assets/floor_texture.jpg");
-	GLuint monkeyTexture = ew::loadTexture("assets/brick_texture.jpg");
+	// Texture setup, every material packed into one texture array that stays bound for the whole geometry pass.
+	// _MaterialIndex picks a material's layer and rect from the region buffer.
+	enum MaterialIndex { MATERIAL_BRICK, MATERIAL_FLOOR };
+	ew::PackedTextures packedMaterials;
+	ew::packTextures({ "assets/brick_texture.jpg", "assets/floor_texture.jpg" }, ew::TexturePackOptions(), &packedMaterials, &jobSystem);
+	unsigned int materialArray = ew::createTextureArray(packedMaterials, ew::TextureParams());
+	unsigned int materialRegions = ew::createRegionBuffer(packedMaterials);
+	packedMaterials = ew::PackedTextures();
+
+	// Streamed copies of the same textures, sized by how big the monkey and plane are on screen
+	ew::TextureStreamer textureStreamer(&jobSystem, (size_t)(textureStreaming.budgetMb * 1024 * 1024));
+	ew::TextureParams streamedParams;
+	streamedParams.mipFilter = ew::MipFilter::BOX;
+	textureStreaming.brickTexture = textureStreamer.load("assets/brick_texture.jpg", streamedParams);
+	textureStreaming.floorTexture = textureStreamer.load("assets/floor_texture.jpg", streamedParams);
+
+	// Scratch memory for the main thread, cleared at the start of every frame
+	ew::FrameArena frameArena;
 
 	// Main camera setup
 	mainCamera.position = glm::vec3(0.0f, 0.0f, 5.0f);
@@ -427,69 +639,97 @@ int main() {
 	deferredShader.use();
 
 	// Setup for each pointlight
-	int index = 0;
-	for (int x = 0; x < 8; x++)
-	{
-		for (int y = 0; y < 8; y++)
-		{
-			pointLights[index].position = glm::vec3((x * 5) + 1, -0.5, (y * 5) + 1);
-			pointLights[index].radius = 5.0;
-			pointLights[index].color = glm::vec4(rand() % 4, rand() % 4, rand() % 4, 1);
-			index++;
-		}
-	}
+	createPointLights(numPointLights);
+	ew::LightBuffer lightBuffer(MAX_POINT_LIGHTS);
+
+	// Clustered light assignment, built on worker threads each frame
+	ew::ClusterGrid clusterGrid(16, 9, 24, &jobSystem);
+	ew::ClusterBuffer clusterBuffer;
+	ew::UniformBlock<ClusterParams> clusterParams;
+	deferredShader.checkUniformBlock<ClusterParams>("ClusterParams");
 
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
 
 	// Monkey Mech setup
-	AnimationClip torsoAnim;
+	ew::TransformHierarchy mech;
+	std::vector<ew::AnimationClip> mechClips;
+
+	ew::AnimationClip torsoAnim;
 	AddFrameToAnim(&torsoAnim, 0.0f, glm::vec3(0), glm::quat(1, 0, 0, 0), glm::vec3(1));
-	Node* torso = AddNode(NULL, torsoAnim);
+	int torso = AddMechNode(&mech, &mechClips, -1, torsoAnim);
 
-	AnimationClip armsBaseAnim;
+	ew::AnimationClip armsBaseAnim;
 	AddFrameToAnim(&armsBaseAnim, 0.0f, glm::vec3(0, 1.3, 0), glm::quat(-1, 0, 0, 0), glm::vec3(0.5));
 	AddFrameToAnim(&armsBaseAnim, 0.2f, glm::vec3(0, 1.3, 0), glm::quat(0, 0, 1, 0), glm::vec3(0.5));
 	AddFrameToAnim(&armsBaseAnim, 0.4f, glm::vec3(0, 1.3, 0), glm::quat(1, 0, 0, 0), glm::vec3(0.5));
-	Node* armsBase = AddNode(torso, armsBaseAnim);
+	int armsBase = AddMechNode(&mech, &mechClips, torso, armsBaseAnim);
 
-	Node* armPartL1 = AddNode(armsBase, glm::vec3(2, 1, 0), glm::quat(0, 0, 1, 0), glm::vec3(.5));
-	Node* armPartL2 = AddNode(armsBase, glm::vec3(3, 2, 0), glm::quat(0, 0, 1, 0), glm::vec3(.5));
-	Node* armPartL3 = AddNode(armsBase, glm::vec3(4, 3, 0), glm::quat(0, 0, 1, 0), glm::vec3(.5));
-	Node* armPartmR1 = AddNode(armsBase, glm::vec3(-2, 1, 0), glm::quat(1, 0, 0, 0), glm::vec3(.5));
-	Node* armPartR2 = AddNode(armsBase, glm::vec3(-3, 2, 0), glm::quat(1, 0, 0, 0), glm::vec3(.5));
-	Node* armPartR3 = AddNode(armsBase, glm::vec3(-4, 3, 0), glm::quat(1, 0, 0, 0), glm::vec3(.5));
+	int armPartL1 = AddMechNode(&mech, armsBase, glm::vec3(2, 1, 0), glm::quat(0, 0, 1, 0), glm::vec3(.5));
+	int armPartL2 = AddMechNode(&mech, armsBase, glm::vec3(3, 2, 0), glm::quat(0, 0, 1, 0), glm::vec3(.5));
+	int armPartL3 = AddMechNode(&mech, armsBase, glm::vec3(4, 3, 0), glm::quat(0, 0, 1, 0), glm::vec3(.5));
+	int armPartmR1 = AddMechNode(&mech, armsBase, glm::vec3(-2, 1, 0), glm::quat(1, 0, 0, 0), glm::vec3(.5));
+	int armPartR2 = AddMechNode(&mech, armsBase, glm::vec3(-3, 2, 0), glm::quat(1, 0, 0, 0), glm::vec3(.5));
+	int armPartR3 = AddMechNode(&mech, armsBase, glm::vec3(-4, 3, 0), glm::quat(1, 0, 0, 0), glm::vec3(.5));
 
-	AnimationClip hipAnimL;
+	ew::AnimationClip hipAnimL;
 	AddFrameToAnim(&hipAnimL, 0.0f, glm::vec3(0.8, -0.8, 0.5), glm::quat(1, 0, 0, 0), glm::vec3(0.5));
 	AddFrameToAnim(&hipAnimL, 0.4f, glm::vec3(0.8, -0.8, 0.5), glm::quat(0, 0, 1, 0), glm::vec3(0.5));
 	AddFrameToAnim(&hipAnimL, 0.8f, glm::vec3(0.8, -0.8, 0.5), glm::quat(-1, 0, 0, 0), glm::vec3(0.5));
-	Node* hipL = AddNode(torso, hipAnimL);
+	int hipL = AddMechNode(&mech, &mechClips, torso, hipAnimL);
 
-	AnimationClip hipAnimR;
+	ew::AnimationClip hipAnimR;
 	AddFrameToAnim(&hipAnimR, 0.0f, glm::vec3(-0.8, -0.8, 0.5), glm::quat(-1, 0, 0, 0), glm::vec3(0.5));
 	AddFrameToAnim(&hipAnimR, 0.4f, glm::vec3(-0.8, -0.8, 0.5), glm::quat(0, 0, 1, 0), glm::vec3(0.5));
 	AddFrameToAnim(&hipAnimR, 0.8f, glm::vec3(-0.8, -0.8, 0.5), glm::quat(1, 0, 0, 0), glm::vec3(0.5));
-	Node* hipR = AddNode(torso, hipAnimR);
+	int hipR = AddMechNode(&mech, &mechClips, torso, hipAnimR);
 
-	Node* kneeL = AddNode(hipL, glm::vec3(0, -0.8, 0.5), glm::quat(-1, 0, 0, 0), glm::vec3(0.5));
-	Node* kneeR = AddNode(hipR, glm::vec3(0, -0.8, 0.5), glm::quat(1, 0, 0, 0), glm::vec3(0.5));
+	int kneeL = AddMechNode(&mech, hipL, glm::vec3(0, -0.8, 0.5), glm::quat(-1, 0, 0, 0), glm::vec3(0.5));
+	int kneeR = AddMechNode(&mech, hipR, glm::vec3(0, -0.8, 0.5), glm::quat(1, 0, 0, 0), glm::vec3(0.5));
 
-	AnimationClip ankleAnimL;
+	ew::AnimationClip ankleAnimL;
 	AddFrameToAnim(&ankleAnimL, 0.0f, glm::vec3(0, -1.3, 0.5), glm::quat(1, 0, 0, 0), glm::vec3(1));
 	AddFrameToAnim(&ankleAnimL, 0.5f, glm::vec3(0, -1.3, 0.5), glm::quat(0, 0, 1, 0), glm::vec3(1));
 	AddFrameToAnim(&ankleAnimL, 0.5f, glm::vec3(0, -1.3, 0.5), glm::quat(-1, 0, 0, 0), glm::vec3(1));
 
-	AnimationClip ankleAnimR;
+	ew::AnimationClip ankleAnimR;
 	AddFrameToAnim(&ankleAnimR, 0.0f, glm::vec3(0, -1.3, 0.5), glm::quat(-1, 0, 0, 0), glm::vec3(1));
 	AddFrameToAnim(&ankleAnimR, 0.5f, glm::vec3(0, -1.3, 0.5), glm::quat(0, 0, 1, 0), glm::vec3(1));
 	AddFrameToAnim(&ankleAnimR, 0.5f, glm::vec3(0, -1.3, 0.5), glm::quat(1, 0, 0, 0), glm::vec3(1));
-	Node* ankleL = AddNode(kneeL, ankleAnimL);
-	Node* ankleR = AddNode(kneeR, ankleAnimR);
+	int ankleL = AddMechNode(&mech, &mechClips, kneeL, ankleAnimL);
+	int ankleR = AddMechNode(&mech, &mechClips, kneeR, ankleAnimR);
+
+	std::vector<ew::AnimationPlayer> mechPlayers;
+	for (size_t i = 0; i < mechClips.size(); i++) 
+	{
+		mechPlayers.push_back(ew::AnimationPlayer(&mechClips[i]));
+		mechPlayers.back().addInstance();
+	}
+
+	// Baked mech crowd, every node's global matrix at 30 frames a second, drawn in one instanced draw
+	ew::AnimationClip mechRig = MergeMechClips(mechClips);
+	ew::BakedAnimation mechBake = ew::bakeAnimation(mech, mechRig, 30.0f);
+	ew::InstancedRig mechCrowd(mechBake);
+	bakedCrowd.numFrames = mechBake.numFrames;
+	bakedCrowd.bakedBytes = mechBake.matrices.size() * sizeof(float);
 
 	// Render Loop
 	while (!glfwWindowShouldClose(window)) {
+		frameMemory.allocations.begin();
+		frameArena.reset();
+
 		glfwPollEvents();
+		modelLoader.update();
+
+		// Picks up edited shaders. The handles keep the old program until the new one links.
+		shaderCompiler.update();
+		shader = litHandle.get();
+		postProcessShader = postProcessHandle.get();
+		shadowShader = shadowHandle.get();
+		deferredShader = deferredHandle.get();
+		geometryShader = geometryHandle.get();
+		lightOrbShader = lightOrbHandle.get();
+		instancedRigShader = instancedRigHandle.get();
 
 		float time = (float)glfwGetTime();
 		deltaTime = time - prevFrameTime;
@@ -498,8 +738,13 @@ int main() {
 		cameraController.move(window, &mainCamera, deltaTime);
 		lightCamera.position = lightCamera.target - light.lightDirection * 10.0f;
 
-		UpdateAnimsRecursive(torso, deltaTime);
-		SolveFKRecursive(torso);
+		UpdateMechAnims(&mech, mechPlayers, deltaTime);
+		mech.update();
+
+		textureStreamer.request(textureStreaming.brickTexture, mainCamera, monkeyTransform.position, 1.5f, screenHeight);
+		textureStreamer.request(textureStreaming.floorTexture, mainCamera, planeTransform.position, 7.0f, screenHeight);
+		textureStreamer.setBudgetBytes((size_t)(textureStreaming.budgetMb * 1024 * 1024));
+		textureStreamer.update(&frameArena);
 
 		glm::mat4 lightView = lightCamera.viewMatrix();
 		glm::mat4 lightProj = lightCamera.projectionMatrix();
@@ -525,15 +770,27 @@ int main() {
 
 		glCullFace(GL_BACK);
 
-		glBindTextureUnit(0, shadowMap);
-		glBindTextureUnit(1, monkeyTexture);
-		glBindTextureUnit(2, floorTexture);
+		glBindTextureUnit(0, materialArray);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, materialRegions);
 
 		geometryShader.use();
 		geometryShader.setMat4("_ViewProjection", mainCamera.projectionMatrix() * mainCamera.viewMatrix());
+		geometryShader.setInt("_Materials", 0);
+		geometryShader.setInt("_MaterialIndex", MATERIAL_BRICK);
 
 
-		DrawNodesRecursively(geometryShader, monkeyModel, torso);
+		DrawMech(geometryShader, geometryShader.getUniform("_Model"), monkeyModel, mech);
+
+		if (bakedCrowd.enabled) {
+			if ((int)mechCrowd.getNumInstances() != bakedCrowd.numMechs) {
+				PlaceBakedCrowd(&mechCrowd, bakedCrowd.numMechs, bakedCrowd.spacing, mechBake.duration);
+			}
+			instancedRigShader.use();
+			instancedRigShader.setMat4("_ViewProjection", mainCamera.projectionMatrix() * mainCamera.viewMatrix());
+			instancedRigShader.setInt("_Materials", 0);
+			instancedRigShader.setInt("_MaterialIndex", MATERIAL_BRICK);
+			mechCrowd.draw(monkeyModel, instancedRigShader, time, 1, 4);
+		}
 
 
 		// Second Framebuffer pass
@@ -564,16 +821,35 @@ int main() {
 
 		deferredShader.setVec3("_EyePos", mainCamera.position);
 
-		for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
-			//Creates prefix "_PointLights[0]." etc
-			std::string prefix = "_PointLights[" + std::to_string(i) + "].";
-			deferredShader.setVec3(prefix + "position", pointLights[i].position);
-			deferredShader.setFloat(prefix + "radius", pointLights[i].radius);
-			deferredShader.setVec4(prefix + "color", pointLights[i].color);
+		if (numPointLights != (int)pointLights.size()) {
+			createPointLights(numPointLights);
+		}
+		lightBuffer.upload(pointLights.data(), pointLights.size());
+		lightBuffer.bind(0);
+
+		if (clusteredLighting.enabled) {
+			auto buildStart = std::chrono::high_resolution_clock::now();
+			clusterGrid.build(mainCamera, pointLights.data(), pointLights.size());
+			auto buildEnd = std::chrono::high_resolution_clock::now();
+			clusteredLighting.buildMs = std::chrono::duration<float, std::milli>(buildEnd - buildStart).count();
+			clusteredLighting.numIndices = clusterGrid.getLightIndices().size();
+			clusterBuffer.upload(clusterGrid);
+			clusterBuffer.bind(1, 2);
 		}
+		ClusterParams params = {};
+		params.view = mainCamera.viewMatrix();
+		params.nearPlane = mainCamera.nearPlane;
+		params.farPlane = mainCamera.farPlane;
+		params.tilesX = clusterGrid.getTilesX();
+		params.tilesY = clusterGrid.getTilesY();
+		params.slices = clusterGrid.getDepthSlices();
+		params.useClusters = clusteredLighting.enabled;
+		clusterParams.upload(params);
+		clusterParams.bind(0);
 
 		glBindVertexArray(dummyVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
+		lightBuffer.endFrame();
 
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, GBuffer.fbo); //Read from gBuffer 
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO.fbo); //Write to current fbo
@@ -598,15 +874,19 @@ int main() {
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 
 
-		drawUI(GBuffer, shadowMap);
+		drawUI(GBuffer, shadowMap, deferredShader, modelOptions, &jobSystem, &textureStreamer, monkeyModel, mech, mechClips);
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		frameMemory.arenaBytes = frameArena.getUsedBytes();
+		frameMemory.arenaPeakBytes = frameArena.getPeakBytes();
+		frameMemory.allocations.end();
 	}
 
 	glDeleteFramebuffers(1, &FBO.fbo);
-
-	ClearNodesRecursive(torso);
+	glDeleteTextures(1, &materialArray);
+	glDeleteBuffers(1, &materialRegions);
 
 	printf("Shutting down...");
 }
@@ -617,7 +897,8 @@ void resetCamera(ew::Camera* mainCamera, ew::CameraController* controller) {
 	controller->yaw = controller->pitch = 0;
 }
 
-void drawUI(Framebuffer& gBuffer, unsigned int shadowMap) {
+void drawUI(Framebuffer& gBuffer, unsigned int shadowMap, const ew::Shader& deferredShader, const ew::ModelLoadOptions& modelOptions, ew::JobSystem* jobs,
+	ew::TextureStreamer* textureStreamer, const ew::CompactModelHandle& monkeyModel, const ew::TransformHierarchy& mech, const std::vector<ew::AnimationClip>& mechClips) {
 	ImGui_ImplGlfw_NewFrame();
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui::NewFrame();
@@ -640,6 +921,18 @@ void drawUI(Framebuffer& gBuffer, unsigned int shadowMap) {
 		ImGui::SliderFloat("Light Direction Y", &light.lightDirection.y, -1.0f, 1.0f);
 		ImGui::SliderFloat("Light Direction Z", &light.lightDirection.z, -1.0f, 1.0f);
 		ImGui::ColorEdit3("Light Color", &light.lightColor.r);
+		ImGui::SliderInt("Point Lights", &numPointLights, 0, MAX_POINT_LIGHTS);
+		ImGui::Checkbox("Clustered Lighting", &clusteredLighting.enabled);
+		if (clusteredLighting.enabled)
+		{
+			ImGui::Text("Cluster build: %.3fms, %u light indices", clusteredLighting.buildMs, clusteredLighting.numIndices);
+		}
+
+		ImGui::Checkbox("Level Of Detail", &levelOfDetail.enabled);
+		if (levelOfDetail.enabled)
+		{
+			ImGui::SliderFloat("LOD Screen Error", &levelOfDetail.maxScreenError, 0.0f, 0.02f, "%.4f");
+		}
 
 		if (ImGui::CollapsingHeader("Shadow"))
 		{
@@ -648,6 +941,44 @@ void drawUI(Framebuffer& gBuffer, unsigned int shadowMap) {
 		}
 	}
 
+	if (ImGui::CollapsingHeader("Baked Crowd"))
+	{
+		ImGui::Checkbox("Draw Crowd", &bakedCrowd.enabled);
+		ImGui::SliderInt("Mechs", &bakedCrowd.numMechs, 1, 10000);
+		ImGui::Text("%d frames baked, %.1fKB", bakedCrowd.numFrames, bakedCrowd.bakedBytes / 1024.0f);
+	}
+
+	// What optimizing and simplifying did to the monkey's meshes
+	if (ImGui::CollapsingHeader("Model Reports"))
+	{
+		const ew::CompactModel* model = monkeyModel.get();
+		if (monkeyModel.isFailed())
+		{
+			ImGui::Text("Failed to load");
+		}
+		else if (model == nullptr)
+		{
+			ImGui::Text("Loading");
+		}
+		else
+		{
+			const std::vector<ew::MeshOptimizationReport>& reports = model->getOptimizationReports();
+			for (size_t i = 0; i < model->getNumMeshes(); i++)
+			{
+				if (i < reports.size())
+				{
+					ImGui::Text("Mesh %zu: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", i, reports[i].before.acmr, reports[i].after.acmr,
+						reports[i].before.atvr, reports[i].after.atvr);
+				}
+				const ew::CompactMesh& mesh = model->getMesh(i);
+				for (int lod = 1; lod < mesh.getNumLods(); lod++)
+				{
+					ImGui::Text("Mesh %zu LOD %d: %u triangles, error %f", i, lod, mesh.getLod(lod).indexCount / 3, mesh.getLod(lod).error);
+				}
+			}
+		}
+	}
+
 	// Post processing
 	if (ImGui::CollapsingHeader("Chromatic Aberration")) {
 		ImGui::SliderFloat("R", &chromaticAberration.r, 0.0f, 1.0f);
@@ -656,6 +987,192 @@ void drawUI(Framebuffer& gBuffer, unsigned int shadowMap) {
 		ImGui::SliderInt("Toggle Effect", &chromaticAberration.effectOn, 0, 1);
 	}
 
+	// Uniform cache stats for the deferred lighting pass, per frame
+	if (ImGui::CollapsingHeader("Uniform Stats"))
+	{
+		ew::UniformStats stats = deferredShader.getUniformStats();
+		ImGui::Text("Lookups skipped: %u", stats.lookupsSkipped);
+		ImGui::Text("Uploads skipped: %u", stats.uploadsSkipped);
+		ImGui::Text("Uploads: %u", stats.uploads);
+	}
+	deferredShader.resetUniformStats();
+
+	// Reads 0 in steady state. Cluster building runs on the job system, which doesn't allocate; loads and texture
+	// streaming do while they are in flight. Worker threads count toward the total but not the main thread.
+	if (ImGui::CollapsingHeader("Frame Memory"))
+	{
+		const ew::AllocationStats& total = frameMemory.allocations.getTotal();
+		const ew::AllocationStats& mainThread = frameMemory.allocations.getThread();
+		ImGui::Text("Heap allocations: %llu (%llu bytes)", (unsigned long long)total.numAllocations, (unsigned long long)total.numBytes);
+		ImGui::Text("On the main thread: %llu (%llu bytes)", (unsigned long long)mainThread.numAllocations, (unsigned long long)mainThread.numBytes);
+		ImGui::Text("Frame arena: %.1fKB used, %.1fKB peak", frameMemory.arenaBytes / 1024.0f, frameMemory.arenaPeakBytes / 1024.0f);
+	}
+
+	if (ImGui::CollapsingHeader("Shader Cache"))
+	{
+		ew::ShaderCacheStats stats = ew::getShaderCacheStats();
+		ImGui::Text("Programs compiled: %u", stats.programsCompiled);
+		ImGui::Text("Permutations reused: %u", stats.programsReused);
+		ImGui::Text("Binaries loaded: %u, rejected: %u, %.1fms saved", stats.binariesLoaded, stats.binariesRejected, stats.msSaved);
+	}
+
+	if (ImGui::CollapsingHeader("Index Buffers"))
+	{
+		ew::IndexBufferStats stats = ew::getIndexBufferStats();
+		ImGui::Text("16 bit meshes: %u / %u", stats.num16BitMeshes, stats.numMeshes);
+		ImGui::Text("Index bytes: %zu", stats.bytes);
+		ImGui::Text("Bytes saved: %zu", stats.bytesSaved);
+	}
+
+	if (ImGui::CollapsingHeader("Light Upload Benchmark"))
+	{
+		if (ImGui::Button("Run Benchmark"))
+		{
+			runLightUploadBenchmark();
+		}
+		if (lightUploadBenchmark.hasRun)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				if (lightUploadBenchmark.uniformMs[i] < 0.0f) {
+					ImGui::Text("%d lights: uniforms unsupported (%d max), light buffer %.3fms", lightUploadBenchmark.counts[i],
+						LightUploadBenchmark::LEGACY_MAX_LIGHTS, lightUploadBenchmark.lightBufferMs[i]);
+				}
+				else {
+					ImGui::Text("%d lights: uniforms %.3fms, light buffer %.3fms", lightUploadBenchmark.counts[i],
+						lightUploadBenchmark.uniformMs[i], lightUploadBenchmark.lightBufferMs[i]);
+				}
+			}
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Hierarchy Benchmark"))
+	{
+		if (ImGui::Button("Run Benchmark"))
+		{
+			runHierarchyBenchmark();
+		}
+		if (hierarchyBenchmark.hasRun)
+		{
+			ImGui::Text("%d nodes", hierarchyBenchmark.numNodes);
+			ImGui::Text("Recursive: %.3fms", hierarchyBenchmark.recursiveMs);
+			ImGui::Text("Flat, all dirty: %.3fms", hierarchyBenchmark.flatMs);
+			ImGui::Text("Flat, %u updated: %.3fms", hierarchyBenchmark.partialUpdated, hierarchyBenchmark.flatPartialMs);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Animation Benchmark"))
+	{
+		if (ImGui::Button("Run Benchmark"))
+		{
+			runAnimationBenchmark(mechClips);
+		}
+		if (animationBenchmark.hasRun)
+		{
+			ImGui::Text("%d mechs, %d animated parts each", animationBenchmark.numRigs, animationBenchmark.numChannels);
+			ImGui::Text("Sampling: %.3fms per frame", animationBenchmark.updateMs);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Animation Compression Benchmark"))
+	{
+		if (ImGui::Button("Run Benchmark"))
+		{
+			runAnimationCompressionBenchmark();
+		}
+		if (animationCompressionBenchmark.hasRun)
+		{
+			ImGui::Text("%d channels of %d keys", animationCompressionBenchmark.numChannels, animationCompressionBenchmark.numKeys);
+			ImGui::Text("%.1fKB to %.1fKB, %.1fx smaller", animationCompressionBenchmark.rawBytes / 1024.0f, animationCompressionBenchmark.compressedBytes / 1024.0f,
+				(float)animationCompressionBenchmark.rawBytes / animationCompressionBenchmark.compressedBytes);
+			ImGui::Text("Max error: %.5f", animationCompressionBenchmark.maxError);
+			ImGui::Text("Sampling %d instances: raw %.3fms, compressed %.3fms", animationCompressionBenchmark.numInstances,
+				animationCompressionBenchmark.rawMs, animationCompressionBenchmark.compressedMs);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Job Scaling Benchmark"))
+	{
+		if (ImGui::Button("Run Benchmark"))
+		{
+			runJobScalingBenchmark(mech, mechClips);
+		}
+		if (jobScalingBenchmark.hasRun)
+		{
+			ImGui::Text("%d mechs, sampled and solved", jobScalingBenchmark.numMechs);
+			for (int i = 0; i < jobScalingBenchmark.numThreads; i++)
+			{
+				ImGui::Text("%d threads: %.3fms, %.2fx", i + 1, jobScalingBenchmark.frameMs[i], jobScalingBenchmark.frameMs[0] / jobScalingBenchmark.frameMs[i]);
+			}
+			ImGui::Text("Heap allocations while timing: %llu", (unsigned long long)jobScalingBenchmark.allocations);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Mesh Cache Benchmark"))
+	{
+		if (ImGui::Button("Run Mesh Cache Benchmark"))
+		{
+			runMeshCacheBenchmark("assets/Suzanne.obj", modelOptions);
+		}
+		if (meshCacheBenchmark.hasRun)
+		{
+			ImGui::Text("Cold (import + cook): %.3fms", meshCacheBenchmark.coldMs);
+			ImGui::Text("Warm (mapped cooked file): %.3fms", meshCacheBenchmark.warmMs);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("OBJ Reader Benchmark"))
+	{
+		ImGui::Checkbox("Include 1GB file", &objReaderBenchmark.includeLargest);
+		if (ImGui::Button("Run OBJ Reader Benchmark"))
+		{
+			runObjReaderBenchmark(jobs);
+		}
+		if (objReaderBenchmark.hasRun)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				if (objReaderBenchmark.objReaderMs[i] > 0.0f) {
+					ImGui::Text("%dMB: loadObj %.1fms, Assimp %.1fms", objReaderBenchmark.sizesMb[i],
+						objReaderBenchmark.objReaderMs[i], objReaderBenchmark.assimpMs[i]);
+				}
+			}
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Texture Compression Benchmark"))
+	{
+		if (ImGui::Button("Run Texture Compression Benchmark"))
+		{
+			runTextureCompressionBenchmark("assets/brick_texture.jpg", jobs);
+		}
+		if (textureCompressionBenchmark.hasRun)
+		{
+			ImGui::Text("brick_texture.jpg %dx%d, mips as RGBA8: %.2fMB", textureCompressionBenchmark.width, textureCompressionBenchmark.height,
+				textureCompressionBenchmark.uncompressedBytes / (1024.0f * 1024.0f));
+			for (int i = 0; i < 4; i++)
+			{
+				ImGui::Text("%s: %.1fms, %.2fdB PSNR, %.2fMB (%.0f%%)", textureCompressionBenchmark.names[i], textureCompressionBenchmark.encodeMs[i],
+					textureCompressionBenchmark.psnr[i], textureCompressionBenchmark.compressedBytes[i] / (1024.0f * 1024.0f),
+					100.0f * textureCompressionBenchmark.compressedBytes[i] / textureCompressionBenchmark.uncompressedBytes);
+			}
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Texture Streaming"))
+	{
+		const ew::TextureStreamingStats& stats = textureStreamer->getStats();
+		ImGui::SliderFloat("Budget (MB)", &textureStreaming.budgetMb, 0.5f, 16.0f);
+		ImGui::Text("Resident %.2fMB of %.2fMB", stats.residentBytes / (1024.0f * 1024.0f), stats.budgetBytes / (1024.0f * 1024.0f));
+		ImGui::Text("%u pending, %u loading, %u streamed in, %u evicted", stats.numPending, stats.numLoading, stats.numStreamedIn, stats.numEvicted);
+		int ids[2] = { textureStreaming.brickTexture, textureStreaming.floorTexture };
+		for (int i = 0; i < 2; i++)
+		{
+			ImGui::Text("Level %d of %d", textureStreamer->getResidentLevel(ids[i]), textureStreamer->getNumLevels(ids[i]));
+			ImGui::Image((ImTextureID)(size_t)textureStreamer->getTexture(ids[i]), ImVec2(128, 128), ImVec2(0, 1), ImVec2(1, 0));
+		}
+	}
+
 	// Camera Control ImGUI
 	if (ImGui::Button("Reset Camera")) 
 	{
@@ -686,6 +1203,285 @@ void drawUI(Framebuffer& gBuffer, unsigned int shadowMap) {
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+/// <summary>
+/// Times uploading 64, 1k and 16k lights per frame, averaged over a number of frames.
+/// The uniform path is the old one, run against the LEGACY_UNIFORM_LIGHTS permutation of the deferred shader,
+/// which still declares the 64 light uniform array: build each field name, look it up, then upload it.
+/// Counts past the array's size can't be uploaded that way and are reported as unsupported.
+/// </summary>
+void runLightUploadBenchmark()
+{
+	const int numFrames = 100;
+	ew::LightBuffer benchmarkBuffer(MAX_POINT_LIGHTS);
+	std::vector<ew::PointLight> lights(MAX_POINT_LIGHTS);
+	for (int i = 0; i < MAX_POINT_LIGHTS; i++)
+	{
+		lights[i].position = glm::vec3(i % 128, -0.5f, i / 128);
+		lights[i].radius = 5.0f;
+		lights[i].color = glm::vec4(i % 4, (i / 4) % 4, (i / 16) % 4, 1);
+	}
+	ew::Shader legacyShader(SHADER_DIR "postprocess.vert", SHADER_DIR "deferredLit.frag", { "LEGACY_UNIFORM_LIGHTS" });
+	unsigned int program = legacyShader.getId();
+
+	for (int c = 0; c < 3; c++)
+	{
+		int count = lightUploadBenchmark.counts[c];
+
+		if (count > LightUploadBenchmark::LEGACY_MAX_LIGHTS) {
+			lightUploadBenchmark.uniformMs[c] = -1.0f;
+		}
+		else {
+			glFinish();
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < numFrames; frame++)
+			{
+				glProgramUniform1i(program, glGetUniformLocation(program, "_NumPointLights"), count);
+				for (int i = 0; i < count; i++)
+				{
+					char name[64];
+					snprintf(name, sizeof(name), "_PointLights[%d].position", i);
+					glProgramUniform3fv(program, glGetUniformLocation(program, name), 1, &lights[i].position.x);
+					snprintf(name, sizeof(name), "_PointLights[%d].radius", i);
+					glProgramUniform1f(program, glGetUniformLocation(program, name), lights[i].radius);
+					snprintf(name, sizeof(name), "_PointLights[%d].color", i);
+					glProgramUniform4fv(program, glGetUniformLocation(program, name), 1, &lights[i].color.x);
+				}
+			}
+			glFinish();
+			auto end = std::chrono::high_resolution_clock::now();
+			lightUploadBenchmark.uniformMs[c] = std::chrono::duration<float, std::milli>(end - start).count() / numFrames;
+		}
+
+		glFinish();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			benchmarkBuffer.upload(lights.data(), count);
+			benchmarkBuffer.bind(0);
+			benchmarkBuffer.endFrame();
+		}
+		glFinish();
+		auto end = std::chrono::high_resolution_clock::now();
+		lightUploadBenchmark.lightBufferMs[c] = std::chrono::duration<float, std::milli>(end - start).count() / numFrames;
+	}
+	lightUploadBenchmark.hasRun = true;
+}
+
+/// <summary>
+/// Solves FK for the same 4-ary tree as a pointer tree, recursively, and as a TransformHierarchy,
+/// averaged over a number of runs. The nodes are added breadth first, so both keep parents before children.
+/// </summary>
+void runHierarchyBenchmark()
+{
+	const int numRuns = 20;
+	const int numChildren = 4;
+	int numNodes = hierarchyBenchmark.numNodes;
+
+	std::vector<Node*> nodes(numNodes);
+	ew::TransformHierarchy hierarchy;
+	hierarchy.reserve(numNodes);
+	for (int i = 0; i < numNodes; i++)
+	{
+		int parent = i == 0 ? -1 : (i - 1) / numChildren;
+		glm::vec3 position((float)(i % numChildren), 1.0f, 0.0f);
+		glm::quat rotation = glm::angleAxis(0.1f * (i % 7), glm::vec3(0, 1, 0));
+		nodes[i] = AddNode(parent < 0 ? NULL : nodes[parent], position, rotation, glm::vec3(1.0f));
+		hierarchy.addNode(parent, nodes[i]->localTransform);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < numRuns; run++)
+	{
+		SolveFKRecursive(nodes[0]);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	hierarchyBenchmark.recursiveMs = std::chrono::duration<float, std::milli>(end - start).count() / numRuns;
+
+	// Dirtying the root dirties every node
+	start = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < numRuns; run++)
+	{
+		hierarchy.setLocalTransform(0, hierarchy.getLocalTransform(0));
+		hierarchy.update();
+	}
+	end = std::chrono::high_resolution_clock::now();
+	hierarchyBenchmark.flatMs = std::chrono::duration<float, std::milli>(end - start).count() / numRuns;
+
+	// Every 1000th node, as if a few parts were animated
+	start = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < numRuns; run++)
+	{
+		for (int i = 1; i < numNodes; i += 1000)
+		{
+			hierarchy.setLocalTransform(i, hierarchy.getLocalTransform(i));
+		}
+		hierarchy.update();
+	}
+	end = std::chrono::high_resolution_clock::now();
+	hierarchyBenchmark.flatPartialMs = std::chrono::duration<float, std::milli>(end - start).count() / numRuns;
+	hierarchyBenchmark.partialUpdated = hierarchy.getNumUpdated();
+
+	// Both should agree
+	float maxError = 0.0f;
+	for (int i = 0; i < numNodes; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			glm::vec4 difference = hierarchy.getGlobalTransform(i)[c] - nodes[i]->globalTransform[c];
+			maxError = glm::max(maxError, glm::max(glm::max(fabsf(difference.x), fabsf(difference.y)), glm::max(fabsf(difference.z), fabsf(difference.w))));
+		}
+	}
+	if (maxError > 1e-3f) {
+		printf("Hierarchy benchmark results differ by up to %f\n", maxError);
+	}
+
+	ClearNodesRecursive(nodes[0]);
+	hierarchyBenchmark.hasRun = true;
+}
+
+/// <summary>
+/// Samples the mech's animated parts for a crowd of mechs, each at a different point in the walk,
+/// averaged over a number of frames. The parts' clips are merged into one clip with a channel per part.
+/// </summary>
+void runAnimationBenchmark(const std::vector<ew::AnimationClip>& mechClips)
+{
+	const int numFrames = 100;
+
+	ew::AnimationClip rig = MergeMechClips(mechClips);
+
+	ew::AnimationPlayer player(&rig);
+	player.reserve(animationBenchmark.numRigs);
+	for (int i = 0; i < animationBenchmark.numRigs; i++)
+	{
+		player.addInstance(rig.duration * i / animationBenchmark.numRigs);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		player.update(1.0f / 60.0f);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	animationBenchmark.updateMs = std::chrono::duration<float, std::milli>(end - start).count() / numFrames;
+	animationBenchmark.numChannels = (int)rig.channels.size();
+	animationBenchmark.hasRun = true;
+}
+
+/// <summary>
+/// Compresses a synthetic rig with the default tolerances and compares it with the original: size,
+/// how far apart their sampled local matrices get, and how long sampling each takes.
+/// A third of the channels never move and a quarter never turn, as in most rigs.
+/// </summary>
+void runAnimationCompressionBenchmark()
+{
+	const int numFrames = 50;
+	const float duration = 10.0f;
+	int numChannels = animationCompressionBenchmark.numChannels;
+	int numKeys = animationCompressionBenchmark.numKeys;
+	int numInstances = animationCompressionBenchmark.numInstances;
+
+	ew::AnimationClip clip;
+	for (int c = 0; c < numChannels; c++)
+	{
+		int channel = clip.addChannel(c);
+		for (int k = 0; k < numKeys; k++)
+		{
+			float time = duration * k / (numKeys - 1);
+			glm::vec3 position = c % 3 == 0 ? glm::vec3(0, 1, 0) : glm::vec3(sinf(time * (1.0f + c * 0.1f)), cosf(time * 0.5f) * 0.2f * c, 0.01f * c);
+			glm::quat rotation = c % 4 == 1 ? glm::quat(1, 0, 0, 0) : glm::angleAxis(sinf(time + c), glm::vec3(0, 1, 0));
+			clip.addKey(channel, time, position, rotation, glm::vec3(1.0f));
+		}
+	}
+	ew::CompressedAnimationClip compressed = ew::compressClip(clip);
+	animationCompressionBenchmark.rawBytes = ew::getClipSize(clip);
+	animationCompressionBenchmark.compressedBytes = ew::getClipSize(compressed);
+
+	ew::AnimationPlayer rawPlayer(&clip);
+	ew::AnimationPlayer compressedPlayer(&compressed);
+	for (int i = 0; i < numInstances; i++)
+	{
+		rawPlayer.addInstance(duration * i / numInstances);
+		compressedPlayer.addInstance(duration * i / numInstances);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		rawPlayer.update(1.0f / 60.0f);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	animationCompressionBenchmark.rawMs = std::chrono::duration<float, std::milli>(end - start).count() / numFrames;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		compressedPlayer.update(1.0f / 60.0f);
+	}
+	end = std::chrono::high_resolution_clock::now();
+	animationCompressionBenchmark.compressedMs = std::chrono::duration<float, std::milli>(end - start).count() / numFrames;
+
+	// Both played the same frames, so they are at the same times
+	float maxError = 0.0f;
+	for (int i = 0; i < numInstances; i++)
+	{
+		for (int c = 0; c < numChannels; c++)
+		{
+			const glm::mat4& a = rawPlayer.getLocalTransform(i, c);
+			const glm::mat4& b = compressedPlayer.getLocalTransform(i, c);
+			for (int column = 0; column < 4; column++)
+			{
+				glm::vec4 difference = a[column] - b[column];
+				maxError = glm::max(maxError, glm::max(glm::max(fabsf(difference.x), fabsf(difference.y)), glm::max(fabsf(difference.z), fabsf(difference.w))));
+			}
+		}
+	}
+	animationCompressionBenchmark.maxError = maxError;
+	animationCompressionBenchmark.hasRun = true;
+}
+
+/// <summary>
+/// Updates a crowd of mechs through a job system of 1 thread, then 2, and so on up to one per hardware
+/// thread, averaged over a number of frames. The job systems are started before timing.
+/// </summary>
+void runJobScalingBenchmark(const ew::TransformHierarchy& mech, const std::vector<ew::AnimationClip>& mechClips)
+{
+	const int numFrames = 100;
+	int numMechs = jobScalingBenchmark.numMechs;
+
+	ew::AnimationClip rig = MergeMechClips(mechClips);
+	ew::AnimationPlayer player(&rig);
+	player.reserve(numMechs);
+	std::vector<ew::TransformHierarchy> rigs(numMechs, mech);
+	for (int i = 0; i < numMechs; i++)
+	{
+		player.addInstance(rig.duration * i / numMechs);
+	}
+
+	int maxThreads = (int)std::thread::hardware_concurrency();
+	maxThreads = glm::clamp(maxThreads, 1, (int)JobScalingBenchmark::MAX_THREADS);
+	ew::AllocationCounter allocations;
+	jobScalingBenchmark.allocations = 0;
+	// A system per thread count. The app's own workers sleep while it runs, so they don't compete.
+	for (int t = 0; t < maxThreads; t++)
+	{
+		ew::JobSystem jobs(t + 1);
+		UpdateMechCrowd(&jobs, &player, &rigs, 0.0f);
+
+		allocations.begin();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			UpdateMechCrowd(&jobs, &player, &rigs, 1.0f / 60.0f);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		allocations.end();
+		jobScalingBenchmark.frameMs[t] = std::chrono::duration<float, std::milli>(end - start).count() / numFrames;
+		jobScalingBenchmark.allocations += allocations.getTotal().numAllocations;
+	}
+	jobScalingBenchmark.numThreads = maxThreads;
+	jobScalingBenchmark.hasRun = true;
+}
+
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
@@ -728,3 +1524,150 @@ GLFWwindow* initWindow(const char* title, int width, int height) {
 	return window;
 }
 
+/// <summary>
+/// Times loading a model with its cooked file deleted (Assimp import, optimization, LODs and writing the cooked file)
+/// against loading it again from the cooked file. Both include the GL upload.
+/// </summary>
+void runMeshCacheBenchmark(const std::string& filePath, const ew::ModelLoadOptions& options)
+{
+	ew::MeshCacheKey key;
+	if (!ew::makeModelCacheKey(filePath, options, ew::CompactLayout::attributes(), ew::CompactLayout::NUM_ATTRIBUTES,
+		sizeof(ew::CompactVertex), &key)) {
+		printf("Mesh cache benchmark: can't read %s\n", filePath.c_str());
+		return;
+	}
+	remove(ew::getCookedPath(filePath, key).c_str());
+
+	ew::ModelLoadOptions cachedOptions = options;
+	cachedOptions.useMeshCache = true;
+	glFinish();
+	auto start = std::chrono::high_resolution_clock::now();
+	ew::CompactModel cold = ew::CompactModel(filePath, cachedOptions);
+	glFinish();
+	auto end = std::chrono::high_resolution_clock::now();
+	meshCacheBenchmark.coldMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	ew::CompactModel warm = ew::CompactModel(filePath, cachedOptions);
+	glFinish();
+	end = std::chrono::high_resolution_clock::now();
+	meshCacheBenchmark.warmMs = std::chrono::duration<float, std::milli>(end - start).count();
+	meshCacheBenchmark.hasRun = warm.wasLoadedFromCache();
+	if (!meshCacheBenchmark.hasRun) {
+		printf("Mesh cache benchmark: warm load missed the cache\n");
+	}
+}
+
+//Writes a subdivided plane with positions, UVs and normals, about sizeMb big
+static bool writeObjPlane(const char* filePath, int sizeMb) {
+	FILE* file = fopen(filePath, "w");
+	if (file == NULL) {
+		return false;
+	}
+	//Roughly 150 bytes of text per grid vertex
+	int n = (int)sqrt(sizeMb * 1000000.0 / 150.0);
+	for (int y = 0; y <= n; y++)
+	{
+		for (int x = 0; x <= n; x++)
+		{
+			float u = (float)x / n;
+			float v = (float)y / n;
+			fprintf(file, "v %f %f %f\nvt %f %f\nvn 0.000000 1.000000 0.000000\n", u * 10.0f - 5.0f, 0.0f, v * 10.0f - 5.0f, u, v);
+		}
+	}
+	for (int y = 0; y < n; y++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			int a = y * (n + 1) + x + 1;
+			int b = a + 1;
+			int c = a + n + 2;
+			int d = a + n + 1;
+			fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, b, b, b, a, a, a, d, d, d, c, c, c);
+		}
+	}
+	return fclose(file) == 0;
+}
+
+void runObjReaderBenchmark(ew::JobSystem* jobs)
+{
+	const char* filePath = "objReaderBenchmark.obj";
+	ew::ModelLoadOptions options;
+	options.useMeshCache = false;
+	int numSizes = objReaderBenchmark.includeLargest ? 4 : 3;
+	for (int i = 0; i < 4; i++)
+	{
+		objReaderBenchmark.objReaderMs[i] = 0.0f;
+		objReaderBenchmark.assimpMs[i] = 0.0f;
+	}
+	for (int i = 0; i < numSizes; i++)
+	{
+		if (!writeObjPlane(filePath, objReaderBenchmark.sizesMb[i])) {
+			printf("OBJ reader benchmark: failed to write %s\n", filePath);
+			break;
+		}
+		//Both produce MeshData, so this is the whole import either way
+		options.useObjReader = true;
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<ew::MeshData> objMeshes = ew::loadModelMeshData(filePath, options, nullptr, jobs);
+		auto end = std::chrono::high_resolution_clock::now();
+		objReaderBenchmark.objReaderMs[i] = std::chrono::duration<float, std::milli>(end - start).count();
+		objMeshes.clear();
+
+		options.useObjReader = false;
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<ew::MeshData> assimpMeshes = ew::loadModelMeshData(filePath, options, nullptr, jobs);
+		end = std::chrono::high_resolution_clock::now();
+		objReaderBenchmark.assimpMs[i] = std::chrono::duration<float, std::milli>(end - start).count();
+		printf("OBJ reader benchmark %dMB: loadObj %.1fms, Assimp %.1fms\n", objReaderBenchmark.sizesMb[i],
+			objReaderBenchmark.objReaderMs[i], objReaderBenchmark.assimpMs[i]);
+	}
+	remove(filePath);
+	objReaderBenchmark.hasRun = true;
+}
+
+void runTextureCompressionBenchmark(const char* filePath, ew::JobSystem* jobs)
+{
+	ew::ImageData image;
+	if (!ew::decodeImage(filePath, true, &image)) {
+		return;
+	}
+	ew::MipChain chain;
+	ew::buildMipChain(image, ew::MipFilter::BOX, false, true, &chain, jobs);
+	textureCompressionBenchmark.width = image.width;
+	textureCompressionBenchmark.height = image.height;
+	textureCompressionBenchmark.uncompressedBytes = 0;
+	for (size_t i = 0; i < chain.levels.size(); i++)
+	{
+		textureCompressionBenchmark.uncompressedBytes += (size_t)chain.levels[i].width * chain.levels[i].height * 4;
+	}
+
+	std::vector<unsigned char> decoded((size_t)image.width * image.height * 4);
+	for (int f = 0; f < 4; f++)
+	{
+		ew::TextureCompression format = textureCompressionBenchmark.formats[f];
+		ew::CompressedTexture compressed;
+		auto start = std::chrono::high_resolution_clock::now();
+		ew::compressMipChain(chain, format, false, &compressed, jobs);
+		auto end = std::chrono::high_resolution_clock::now();
+		textureCompressionBenchmark.encodeMs[f] = std::chrono::duration<float, std::milli>(end - start).count();
+		textureCompressionBenchmark.compressedBytes[f] = compressed.data.size();
+
+		ew::decompressImage(compressed.data.data(), image.width, image.height, format, decoded.data());
+		int numChannels = format == ew::TextureCompression::BC5 ? 2 : (image.numComponents < 3 ? image.numComponents : 3);
+		double squaredError = 0.0;
+		for (size_t p = 0; p < (size_t)image.width * image.height; p++)
+		{
+			for (int c = 0; c < numChannels; c++)
+			{
+				double d = (double)image.pixels.get()[p * image.numComponents + c] - decoded[p * 4 + c];
+				squaredError += d * d;
+			}
+		}
+		double meanSquaredError = squaredError / ((double)image.width * image.height * numChannels);
+		textureCompressionBenchmark.psnr[f] = meanSquaredError > 0.0 ? (float)(10.0 * log10(255.0 * 255.0 / meanSquaredError)) : 99.0f;
+		printf("Texture compression benchmark %s: %.1fms, %.2fdB PSNR, %zu bytes\n", textureCompressionBenchmark.names[f],
+			textureCompressionBenchmark.encodeMs[f], textureCompressionBenchmark.psnr[f], compressed.data.size());
+	}
+	textureCompressionBenchmark.hasRun = true;
+}
@@ -0,0 +1,104 @@
+#include "allocationCounter.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+namespace ew {
+	static std::atomic<uint64_t> s_numAllocations(0);
+	static std::atomic<uint64_t> s_numBytes(0);
+	static thread_local uint64_t t_numAllocations = 0;
+	static thread_local uint64_t t_numBytes = 0;
+
+	static void* countedAlloc(size_t size)
+	{
+		s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+		s_numBytes.fetch_add(size, std::memory_order_relaxed);
+		t_numAllocations++;
+		t_numBytes += size;
+		//malloc(0) may return null, but new must return a unique pointer
+		return malloc(size > 0 ? size : 1);
+	}
+
+	AllocationStats getAllocationStats()
+	{
+		AllocationStats stats;
+		stats.numAllocations = s_numAllocations.load(std::memory_order_relaxed);
+		stats.numBytes = s_numBytes.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	AllocationStats getThreadAllocationStats()
+	{
+		AllocationStats stats;
+		stats.numAllocations = t_numAllocations;
+		stats.numBytes = t_numBytes;
+		return stats;
+	}
+
+	void AllocationCounter::begin()
+	{
+		m_totalStart = getAllocationStats();
+		m_threadStart = getThreadAllocationStats();
+	}
+
+	void AllocationCounter::end()
+	{
+		m_total = getAllocationStats() - m_totalStart;
+		m_thread = getThreadAllocationStats() - m_threadStart;
+	}
+}
+
+//Replacements for the global operators. Over-aligned new keeps the standard versions, which pair with their own delete.
+void* operator new(size_t size)
+{
+	void* p = ew::countedAlloc(size);
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return ew::countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return ew::countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+namespace ew {
+	//Heap allocations made through operator new since startup
+	struct AllocationStats {
+		uint64_t numAllocations = 0;
+		uint64_t numBytes = 0;
+	};
+	inline AllocationStats operator-(const AllocationStats& a, const AllocationStats& b) {
+		AllocationStats stats;
+		stats.numAllocations = a.numAllocations - b.numAllocations;
+		stats.numBytes = a.numBytes - b.numBytes;
+		return stats;
+	}
+
+	//allocationCounter.cpp replaces the global operator new and delete with versions that count, in any program it is
+	//linked into. It is not part of core, so link the ewAllocationCounter target to use these. malloc, and libraries
+	//that use it directly, are not counted.
+	//Every thread
+	AllocationStats getAllocationStats();
+	//Only the calling thread
+	AllocationStats getThreadAllocationStats();
+
+	//Counts allocations between begin() and end(), such as over a frame
+	class AllocationCounter {
+	public:
+		void begin();
+		void end();
+		//Between the last begin() and end() pair
+		inline const AllocationStats& getTotal()const { return m_total; }
+		inline const AllocationStats& getThread()const { return m_thread; }
+	private:
+		AllocationStats m_totalStart;
+		AllocationStats m_threadStart;
+		AllocationStats m_total;
+		AllocationStats m_thread;
+	};
+}
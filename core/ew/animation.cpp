@@ -0,0 +1,376 @@
+#include "animation.h"
+#include "animationCompression.h"
+#include <algorithm>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_ANIMATION_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	//Keys around the sample time of one track, for up to 4 instances, one per lane. Each component has its own
+	//row for SSE.
+	template<int N>
+	struct KeyPair {
+		alignas(16) float value0[N][4];
+		alignas(16) float value1[N][4];
+		alignas(16) float time0[4];
+		alignas(16) float time1[4];
+	};
+
+	//Instances sampled together, a multiple of 4
+	static const int BATCH_SIZE = 64;
+
+	//One channel of up to 4 instances
+	struct SampleBlock {
+		alignas(16) float time[4];
+		KeyPair<3> position;
+		KeyPair<4> rotation; //x, y, z, w
+		KeyPair<3> scale;
+	};
+
+	int AnimationClip::addChannel(int node)
+	{
+		AnimationChannel channel;
+		channel.node = node;
+		channels.push_back(channel);
+		return (int)channels.size() - 1;
+	}
+
+	void AnimationClip::addPositionKey(int channel, float time, const glm::vec3& position)
+	{
+		channels[channel].position.times.push_back(time);
+		channels[channel].position.values.push_back(position);
+		duration = std::max(duration, time);
+	}
+
+	void AnimationClip::addRotationKey(int channel, float time, const glm::quat& rotation)
+	{
+		channels[channel].rotation.times.push_back(time);
+		channels[channel].rotation.values.push_back(rotation);
+		duration = std::max(duration, time);
+	}
+
+	void AnimationClip::addScaleKey(int channel, float time, const glm::vec3& scale)
+	{
+		channels[channel].scale.times.push_back(time);
+		channels[channel].scale.values.push_back(scale);
+		duration = std::max(duration, time);
+	}
+
+	void AnimationClip::addKey(int channel, float time, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		addPositionKey(channel, time, position);
+		addRotationKey(channel, time, rotation);
+		addScaleKey(channel, time, scale);
+	}
+
+	glm::mat4 composeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		glm::mat4 m = glm::mat4_cast(rotation);
+		m[0] *= scale.x;
+		m[1] *= scale.y;
+		m[2] *= scale.z;
+		m[3] = glm::vec4(position, 1.0f);
+		return m;
+	}
+
+	//Returns the last key at or before time, moving cursor from the key it found last time. Forward playback
+	//moves at most a key or two per frame, so a search is only needed when time jumps back, such as when the
+	//clip loops.
+	static inline unsigned int findKey(const float* times, unsigned int numKeys, unsigned int* cursor, float time)
+	{
+		unsigned int k = *cursor;
+		if (k >= numKeys || time < times[k]) {
+			k = (unsigned int)(std::upper_bound(times, times + numKeys, time) - times);
+			k = k > 0 ? k - 1 : 0;
+		}
+		while (k + 1 < numKeys && times[k + 1] <= time) {
+			k++;
+		}
+		*cursor = k;
+		return k;
+	}
+
+	static inline void setLane(float rows[][4], int lane, const glm::vec3& v)
+	{
+		rows[0][lane] = v.x; rows[1][lane] = v.y; rows[2][lane] = v.z;
+	}
+
+	static inline void setLane(float rows[][4], int lane, const glm::quat& q)
+	{
+		rows[0][lane] = q.x; rows[1][lane] = q.y; rows[2][lane] = q.z; rows[3][lane] = q.w;
+	}
+
+	static inline void setLane(float rows[][4], int lane, const CompressedVec3Track& track, unsigned int key)
+	{
+		setLane(rows, lane, decodeVec3(track, key));
+	}
+
+	static inline void setLane(float rows[][4], int lane, const CompressedQuatTrack& track, unsigned int key)
+	{
+		float q[4];
+		decodeQuat(track, key, q);
+		rows[0][lane] = q[0]; rows[1][lane] = q[1]; rows[2][lane] = q[2]; rows[3][lane] = q[3];
+	}
+
+	static inline void setLane(float rows[][4], int lane, const Vec3Track& track, unsigned int key)
+	{
+		setLane(rows, lane, track.values[key]);
+	}
+
+	static inline void setLane(float rows[][4], int lane, const QuatTrack& track, unsigned int key)
+	{
+		setLane(rows, lane, track.values[key]);
+	}
+
+	//Fills lane with the keys around time, or with defaultValue twice if the track is empty
+	template<int N, typename Track>
+	static inline void gatherKeys(const Track& track, const float* defaultValue, unsigned int* cursor, float time, int lane, KeyPair<N>* keys)
+	{
+		unsigned int numKeys = (unsigned int)track.times.size();
+		if (numKeys == 0) {
+			for (int i = 0; i < N; i++)
+			{
+				keys->value0[i][lane] = keys->value1[i][lane] = defaultValue[i];
+			}
+			keys->time0[lane] = keys->time1[lane] = 0.0f;
+			return;
+		}
+		unsigned int key0 = findKey(track.times.data(), numKeys, cursor, time);
+		unsigned int key1 = key0 + 1 < numKeys ? key0 + 1 : key0;
+		setLane(keys->value0, lane, track, key0);
+		setLane(keys->value1, lane, track, key1);
+		keys->time0[lane] = track.times[key0];
+		keys->time1[lane] = track.times[key1];
+	}
+
+#ifdef EW_ANIMATION_SSE
+	//How far each lane's time is from its first key to its second, 0 where they are the same key
+	template<int N>
+	static inline __m128 keyFraction(const KeyPair<N>& keys, __m128 time)
+	{
+		__m128 time0 = _mm_load_ps(keys.time0);
+		__m128 span = _mm_sub_ps(_mm_load_ps(keys.time1), time0);
+		__m128 valid = _mm_cmpgt_ps(span, _mm_setzero_ps());
+		__m128 t = _mm_div_ps(_mm_sub_ps(time, time0), _mm_or_ps(_mm_and_ps(valid, span), _mm_andnot_ps(valid, _mm_set1_ps(1.0f))));
+		t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		return _mm_and_ps(valid, t);
+	}
+#else
+	template<int N>
+	static inline float keyFraction(const KeyPair<N>& keys, float time, int lane)
+	{
+		float span = keys.time1[lane] - keys.time0[lane];
+		if (span <= 0.0f) {
+			return 0.0f;
+		}
+		return std::min(std::max((time - keys.time0[lane]) / span, 0.0f), 1.0f);
+	}
+#endif
+
+	AnimationPlayer::AnimationPlayer(const AnimationClip* clip)
+		: m_clip(clip), m_numChannels(clip->channels.size()), m_duration(clip->duration)
+	{
+	}
+
+	AnimationPlayer::AnimationPlayer(const CompressedAnimationClip* clip)
+		: m_compressedClip(clip), m_numChannels(clip->channels.size()), m_duration(clip->duration)
+	{
+	}
+
+	int AnimationPlayer::getNode(int channel)const
+	{
+		return m_clip != nullptr ? m_clip->channels[channel].node : m_compressedClip->channels[channel].node;
+	}
+
+	int AnimationPlayer::addInstance(float time, float speed)
+	{
+		m_times.push_back(time);
+		m_speeds.push_back(speed);
+		m_cursors.resize(m_cursors.size() + m_numChannels * 3, 0);
+		m_localTransforms.resize(m_localTransforms.size() + m_numChannels, glm::mat4(1.0f));
+		return (int)m_times.size() - 1;
+	}
+
+	void AnimationPlayer::reserve(size_t numInstances)
+	{
+		m_times.reserve(numInstances);
+		m_speeds.reserve(numInstances);
+		m_cursors.reserve(numInstances * m_numChannels * 3);
+		m_localTransforms.reserve(numInstances * m_numChannels);
+	}
+
+	void AnimationPlayer::clear()
+	{
+		m_times.clear();
+		m_speeds.clear();
+		m_cursors.clear();
+		m_localTransforms.clear();
+	}
+
+	void AnimationPlayer::update(float dt)
+	{
+		update(dt, 0, (int)m_times.size());
+	}
+
+	void AnimationPlayer::update(float dt, int firstInstance, int numInstances)
+	{
+		float duration = m_duration;
+		int end = firstInstance + numInstances;
+		for (int i = firstInstance; i < end; i++)
+		{
+			float time = m_times[i] + dt * m_speeds[i];
+			if (duration > 0.0f) {
+				time = fmodf(time, duration);
+				if (time < 0.0f) {
+					time += duration;
+				}
+			}
+			else {
+				time = 0.0f;
+			}
+			m_times[i] = time;
+		}
+		for (int first = firstInstance; first < end; first += BATCH_SIZE)
+		{
+			if (m_clip != nullptr) {
+				sampleBatch(*m_clip, first, std::min(BATCH_SIZE, end - first));
+			}
+			else {
+				sampleBatch(*m_compressedClip, first, std::min(BATCH_SIZE, end - first));
+			}
+		}
+	}
+
+	//Lerps, nlerps and composes the local matrices of one block, storing the first count lanes in out
+	static void composeBlock(const SampleBlock* block, int count, glm::mat4* const* out)
+	{
+#ifdef EW_ANIMATION_SSE
+		__m128 time = _mm_load_ps(block->time);
+		__m128 p[3], s[3], q[4];
+		__m128 t = keyFraction(block->position, time);
+		for (int i = 0; i < 3; i++)
+		{
+			__m128 a = _mm_load_ps(block->position.value0[i]);
+			p[i] = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block->position.value1[i]), a), t));
+		}
+		t = keyFraction(block->scale, time);
+		for (int i = 0; i < 3; i++)
+		{
+			__m128 a = _mm_load_ps(block->scale.value0[i]);
+			s[i] = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block->scale.value1[i]), a), t));
+		}
+
+		//nlerp, negating the second key where that is the shorter way round
+		__m128 a[4], b[4];
+		__m128 dot = _mm_setzero_ps();
+		for (int i = 0; i < 4; i++)
+		{
+			a[i] = _mm_load_ps(block->rotation.value0[i]);
+			b[i] = _mm_load_ps(block->rotation.value1[i]);
+			dot = _mm_add_ps(dot, _mm_mul_ps(a[i], b[i]));
+		}
+		__m128 sign = _mm_and_ps(dot, _mm_set1_ps(-0.0f));
+		t = keyFraction(block->rotation, time);
+		__m128 length = _mm_setzero_ps();
+		for (int i = 0; i < 4; i++)
+		{
+			q[i] = _mm_add_ps(a[i], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(b[i], sign), a[i]), t));
+			length = _mm_add_ps(length, _mm_mul_ps(q[i], q[i]));
+		}
+		__m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length));
+		for (int i = 0; i < 4; i++)
+		{
+			q[i] = _mm_mul_ps(q[i], invLength);
+		}
+
+		//Same matrix as glm::mat4_cast, columns scaled, translation last
+		__m128 two = _mm_set1_ps(2.0f);
+		__m128 x2 = _mm_mul_ps(q[0], two), y2 = _mm_mul_ps(q[1], two), z2 = _mm_mul_ps(q[2], two);
+		__m128 xx = _mm_mul_ps(q[0], x2), yy = _mm_mul_ps(q[1], y2), zz = _mm_mul_ps(q[2], z2);
+		__m128 xy = _mm_mul_ps(q[0], y2), xz = _mm_mul_ps(q[0], z2), yz = _mm_mul_ps(q[1], z2);
+		__m128 wx = _mm_mul_ps(q[3], x2), wy = _mm_mul_ps(q[3], y2), wz = _mm_mul_ps(q[3], z2);
+		__m128 oneV = _mm_set1_ps(1.0f);
+		__m128 columns[4][4] = {
+			{ _mm_mul_ps(_mm_sub_ps(oneV, _mm_add_ps(yy, zz)), s[0]), _mm_mul_ps(_mm_add_ps(xy, wz), s[0]), _mm_mul_ps(_mm_sub_ps(xz, wy), s[0]), _mm_setzero_ps() },
+			{ _mm_mul_ps(_mm_sub_ps(xy, wz), s[1]), _mm_mul_ps(_mm_sub_ps(oneV, _mm_add_ps(xx, zz)), s[1]), _mm_mul_ps(_mm_add_ps(yz, wx), s[1]), _mm_setzero_ps() },
+			{ _mm_mul_ps(_mm_add_ps(xz, wy), s[2]), _mm_mul_ps(_mm_sub_ps(yz, wx), s[2]), _mm_mul_ps(_mm_sub_ps(oneV, _mm_add_ps(xx, yy)), s[2]), _mm_setzero_ps() },
+			{ p[0], p[1], p[2], oneV }
+		};
+		//Each column is one row per component, so transposing gives one row per lane
+		for (int column = 0; column < 4; column++)
+		{
+			_MM_TRANSPOSE4_PS(columns[column][0], columns[column][1], columns[column][2], columns[column][3]);
+			for (int lane = 0; lane < count; lane++)
+			{
+				_mm_storeu_ps(&(*out[lane])[column][0], columns[column][lane]);
+			}
+		}
+#else
+		for (int lane = 0; lane < count; lane++)
+		{
+			glm::vec3 position, scale;
+			float tp = keyFraction(block->position, block->time[lane], lane);
+			float ts = keyFraction(block->scale, block->time[lane], lane);
+			for (int i = 0; i < 3; i++)
+			{
+				position[i] = block->position.value0[i][lane] + (block->position.value1[i][lane] - block->position.value0[i][lane]) * tp;
+				scale[i] = block->scale.value0[i][lane] + (block->scale.value1[i][lane] - block->scale.value0[i][lane]) * ts;
+			}
+			const float (*r0)[4] = block->rotation.value0;
+			const float (*r1)[4] = block->rotation.value1;
+			glm::quat q0(r0[3][lane], r0[0][lane], r0[1][lane], r0[2][lane]);
+			glm::quat q1(r1[3][lane], r1[0][lane], r1[1][lane], r1[2][lane]);
+			if (glm::dot(q0, q1) < 0.0f) {
+				q1 = -q1;
+			}
+			float tr = keyFraction(block->rotation, block->time[lane], lane);
+			glm::quat rotation = glm::normalize(q0 * (1.0f - tr) + q1 * tr);
+			*out[lane] = composeTransform(position, rotation, scale);
+		}
+#endif
+	}
+
+	template<typename Clip>
+	void AnimationPlayer::sampleBatch(const Clip& clip, int firstInstance, int count)
+	{
+		const float zero[3] = { 0.0f, 0.0f, 0.0f };
+		const float one[3] = { 1.0f, 1.0f, 1.0f };
+		const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		//Gathering the whole batch before any math lets the scalar stores land in the cache before SSE loads
+		//read them back. Loading each block right after filling it stalls on every load.
+		SampleBlock blocks[BATCH_SIZE / 4];
+		int numBlocks = (count + 3) / 4;
+		for (size_t c = 0; c < m_numChannels; c++)
+		{
+			const auto& channel = clip.channels[c];
+			for (int i = 0; i < numBlocks; i++)
+			{
+				SampleBlock& block = blocks[i];
+				//Lanes past count repeat the last instance and aren't stored
+				for (int lane = 0; lane < 4; lane++)
+				{
+					size_t instance = firstInstance + std::min(i * 4 + lane, count - 1);
+					float time = m_times[instance];
+					unsigned int* cursors = &m_cursors[(instance * m_numChannels + c) * 3];
+					block.time[lane] = time;
+					gatherKeys(channel.position, zero, &cursors[0], time, lane, &block.position);
+					gatherKeys(channel.rotation, identity, &cursors[1], time, lane, &block.rotation);
+					gatherKeys(channel.scale, one, &cursors[2], time, lane, &block.scale);
+				}
+			}
+			for (int i = 0; i < numBlocks; i++)
+			{
+				int blockCount = std::min(4, count - i * 4);
+				glm::mat4* out[4];
+				for (int lane = 0; lane < 4; lane++)
+				{
+					out[lane] = &m_localTransforms[(firstInstance + i * 4 + std::min(lane, blockCount - 1)) * m_numChannels + c];
+				}
+				composeBlock(&blocks[i], blockCount, out);
+			}
+		}
+	}
+}
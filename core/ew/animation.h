@@ -0,0 +1,91 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+namespace ew {
+	//Keys of one property of one node, in ascending time. Times before the first key hold the first value and
+	//times after the last hold the last. An empty track holds the property's default.
+	struct Vec3Track {
+		std::vector<float> times;
+		std::vector<glm::vec3> values;
+	};
+	struct QuatTrack {
+		std::vector<float> times;
+		std::vector<glm::quat> values;
+	};
+
+	//Position, rotation and scale of one node, each keyed on its own
+	struct AnimationChannel {
+		int node = -1; //In the hierarchy the clip animates
+		Vec3Track position;
+		QuatTrack rotation;
+		Vec3Track scale;
+	};
+
+	struct AnimationClip {
+		float duration = 0.0f;
+		std::vector<AnimationChannel> channels;
+
+		//Returns the channel's index
+		int addChannel(int node);
+		//Keys must be added in ascending time per track. Each extends duration if it is later.
+		void addPositionKey(int channel, float time, const glm::vec3& position);
+		void addRotationKey(int channel, float time, const glm::quat& rotation);
+		void addScaleKey(int channel, float time, const glm::vec3& scale);
+		//All three at once
+		void addKey(int channel, float time, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	};
+
+	struct CompressedAnimationClip;
+
+	//translate * rotate * scale
+	glm::mat4 composeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+	//Plays one clip on many instances, each with its own time and speed, looping. Every instance keeps a cursor
+	//per track at the key it last sampled, so moving forward costs a comparison or two rather than a search.
+	//Instances are sampled 4 at a time with SSE: positions and scales are lerped, rotations nlerped along the
+	//shorter arc, and the results composed into local matrices. Compressed clips are decoded key by key as they
+	//are sampled.
+	class AnimationPlayer {
+	public:
+		//clip must outlive the player and not gain channels or keys while it is used
+		AnimationPlayer(const AnimationClip* clip);
+		AnimationPlayer(const CompressedAnimationClip* clip);
+
+		//Returns the instance's index
+		int addInstance(float time = 0.0f, float speed = 1.0f);
+		void reserve(size_t numInstances);
+		void clear();
+		inline size_t getNumInstances()const { return m_times.size(); }
+		inline size_t getNumChannels()const { return m_numChannels; }
+
+		inline float getTime(int instance)const { return m_times[instance]; }
+		inline void setTime(int instance, float time) { m_times[instance] = time; }
+		inline void setSpeed(int instance, float speed) { m_speeds[instance] = speed; }
+
+		//Advances every instance by dt times its speed and samples every channel
+		void update(float dt);
+		//Only instances [firstInstance, firstInstance + numInstances). Disjoint ranges may be updated on different
+		//threads at once.
+		void update(float dt, int firstInstance, int numInstances);
+		//As of the last update(). Channel c of instance i animates node getNode(c).
+		inline const glm::mat4& getLocalTransform(int instance, int channel)const { return m_localTransforms[instance * m_numChannels + channel]; }
+		//Every instance's channels in a row
+		inline const glm::mat4* getLocalTransforms()const { return m_localTransforms.data(); }
+		int getNode(int channel)const;
+		inline float getDuration()const { return m_duration; }
+	private:
+		template<typename Clip>
+		void sampleBatch(const Clip& clip, int firstInstance, int count);
+
+		const AnimationClip* m_clip = nullptr;
+		const CompressedAnimationClip* m_compressedClip = nullptr;
+		size_t m_numChannels;
+		float m_duration;
+		std::vector<float> m_times;
+		std::vector<float> m_speeds;
+		std::vector<unsigned int> m_cursors; //Position, rotation and scale per channel per instance
+		std::vector<glm::mat4> m_localTransforms;
+	};
+}
@@ -0,0 +1,69 @@
+#include "animationBaker.h"
+#include <math.h>
+#include <string.h>
+
+namespace ew {
+	BakedAnimation bakeAnimation(const TransformHierarchy& hierarchy, const AnimationClip& clip, float frameRate)
+	{
+		BakedAnimation baked;
+		baked.numNodes = (int)hierarchy.getNumNodes();
+		baked.duration = clip.duration;
+		baked.numFrames = clip.duration > 0.0f && frameRate > 0.0f ? (int)ceilf(clip.duration * frameRate) : 1;
+		if (baked.numFrames < 1) {
+			baked.numFrames = 1;
+		}
+		baked.frameRate = clip.duration > 0.0f ? baked.numFrames / clip.duration : 0.0f;
+		baked.matrices.resize((size_t)baked.numFrames * baked.numNodes * 16);
+
+		TransformHierarchy pose = hierarchy;
+		AnimationPlayer player(&clip);
+		player.addInstance();
+		for (int frame = 0; frame < baked.numFrames; frame++)
+		{
+			player.setTime(0, baked.numFrames > 1 ? frame / baked.frameRate : 0.0f);
+			player.update(0.0f);
+			for (size_t c = 0; c < player.getNumChannels(); c++)
+			{
+				int node = player.getNode((int)c);
+				if (node >= 0 && node < baked.numNodes) {
+					pose.setLocalTransform(node, player.getLocalTransform(0, (int)c));
+				}
+			}
+			pose.update();
+			if (baked.numNodes > 0) {
+				memcpy(&baked.matrices[(size_t)frame * baked.numNodes * 16], pose.getGlobalTransforms(), sizeof(glm::mat4) * baked.numNodes);
+			}
+		}
+		return baked;
+	}
+
+	void getBakedFrames(const BakedAnimation& baked, float time, int* frame0, int* frame1, float* t)
+	{
+		float frame = time * baked.frameRate;
+		frame -= floorf(frame / baked.numFrames) * baked.numFrames;
+		int first = (int)frame;
+		//Rounding can land exactly on numFrames
+		if (first >= baked.numFrames) {
+			first = 0;
+			frame = 0.0f;
+		}
+		*frame0 = first;
+		*frame1 = first + 1 < baked.numFrames ? first + 1 : 0;
+		*t = frame - first;
+	}
+
+	glm::mat4 sampleBakedAnimation(const BakedAnimation& baked, int node, float time)
+	{
+		int frame0, frame1;
+		float t;
+		getBakedFrames(baked, time, &frame0, &frame1, &t);
+		const float* a = baked.getMatrix(frame0, node);
+		const float* b = baked.getMatrix(frame1, node);
+		glm::mat4 m;
+		for (int i = 0; i < 16; i++)
+		{
+			(&m[0][0])[i] = a[i] + (b[i] - a[i]) * t;
+		}
+		return m;
+	}
+}
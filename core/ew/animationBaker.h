@@ -0,0 +1,30 @@
+#pragma once
+#include "animation.h"
+#include "transformHierarchy.h"
+
+namespace ew {
+	//Global matrices of every node of a hierarchy at evenly spaced times through one loop of a clip. The layout is
+	//an RGBA32F texture numNodes * 4 texels wide and numFrames tall: row f is frame f, and node n's columns are
+	//texels 4n to 4n + 3. Frame f is at time f / frameRate, and the frame after the last is frame 0 again, so a clip
+	//that doesn't end where it starts blends back over its last frame rather than jumping.
+	struct BakedAnimation {
+		int numNodes = 0;
+		int numFrames = 0;
+		float frameRate = 0.0f; //Frames per second, adjusted so numFrames fit the clip's duration exactly
+		float duration = 0.0f;
+		std::vector<float> matrices;
+
+		inline int getWidth()const { return numNodes * 4; }
+		inline int getHeight()const { return numFrames; }
+		inline const float* getMatrix(int frame, int node)const { return &matrices[((size_t)frame * numNodes + node) * 16]; }
+	};
+
+	//Plays clip on hierarchy at about frameRate frames a second. Nodes the clip doesn't animate keep their local
+	//transforms from hierarchy. No GL, so it can run offline.
+	BakedAnimation bakeAnimation(const TransformHierarchy& hierarchy, const AnimationClip& clip, float frameRate = 30.0f);
+
+	//The two frames around time, looping, and how far it is between them
+	void getBakedFrames(const BakedAnimation& baked, float time, int* frame0, int* frame1, float* t);
+	//A node's global matrix at time, lerped between frames the same way the instanced rig shader does it
+	glm::mat4 sampleBakedAnimation(const BakedAnimation& baked, int node, float time);
+}
@@ -0,0 +1,224 @@
+#include "animationCompression.h"
+#include <algorithm>
+
+namespace ew {
+	static uint16_t quantize(float value, float min, float extent)
+	{
+		if (extent <= 0.0f) {
+			return 0;
+		}
+		float normalized = std::min(std::max((value - min) / extent, 0.0f), 1.0f);
+		return (uint16_t)(normalized * 65535.0f + 0.5f);
+	}
+
+	static void encodeQuat(const glm::quat& rotation, uint16_t* out)
+	{
+		glm::quat normalized = glm::normalize(rotation);
+		float q[4] = { normalized.x, normalized.y, normalized.z, normalized.w };
+		int largest = 0;
+		for (int i = 1; i < 4; i++)
+		{
+			if (fabsf(q[i]) > fabsf(q[largest])) {
+				largest = i;
+			}
+		}
+		//q and -q are the same rotation, so make the dropped component positive
+		float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+		uint64_t bits = (uint64_t)largest << 45;
+		for (int i = 0, j = 0; i < 4; i++)
+		{
+			if (i == largest) {
+				continue;
+			}
+			float normalizedComponent = std::min(std::max(q[i] * sign / QUAT_COMPONENT_RANGE, -1.0f), 1.0f);
+			uint64_t quantized = (uint64_t)((normalizedComponent * 0.5f + 0.5f) * 32767.0f + 0.5f);
+			bits |= quantized << (30 - 15 * j);
+			j++;
+		}
+		out[0] = (uint16_t)(bits >> 32);
+		out[1] = (uint16_t)(bits >> 16);
+		out[2] = (uint16_t)bits;
+	}
+
+	static glm::vec3 lerpKeys(const glm::vec3& a, const glm::vec3& b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	//The same nlerp AnimationPlayer samples with
+	static glm::quat lerpKeys(const glm::quat& a, const glm::quat& b, float t)
+	{
+		glm::quat end = glm::dot(a, b) < 0.0f ? -b : b;
+		return glm::normalize(a * (1.0f - t) + end * t);
+	}
+
+	static float keyError(const glm::vec3& a, const glm::vec3& b)
+	{
+		return glm::length(a - b);
+	}
+
+	//Angle between the rotations. From the chord rather than acos of the dot product, which loses most of its
+	//precision at the small angles tolerances are set in.
+	static float keyError(const glm::quat& a, const glm::quat& b)
+	{
+		glm::quat na = glm::normalize(a);
+		glm::quat nb = glm::normalize(b);
+		glm::quat difference = glm::dot(na, nb) < 0.0f ? na + nb : na - nb;
+		float chord = std::min(sqrtf(glm::dot(difference, difference)), 2.0f);
+		return 4.0f * asinf(chord * 0.5f);
+	}
+
+	//Indices of the keys to keep. Moving forward from the last kept key, each key is dropped while the line from
+	//the last kept key to the next one passes within tolerance of every key dropped since.
+	template<typename T>
+	static std::vector<unsigned int> reduceKeys(const std::vector<float>& times, const std::vector<T>& values, float tolerance)
+	{
+		std::vector<unsigned int> kept;
+		unsigned int numKeys = (unsigned int)times.size();
+		if (numKeys == 0) {
+			return kept;
+		}
+		//A track that stays within tolerance of its first key needs only that key
+		bool constant = true;
+		for (unsigned int i = 1; i < numKeys && constant; i++)
+		{
+			constant = keyError(values[0], values[i]) <= tolerance;
+		}
+		kept.push_back(0);
+		if (constant) {
+			return kept;
+		}
+
+		unsigned int anchor = 0;
+		for (unsigned int end = anchor + 2; end < numKeys; end++)
+		{
+			float span = times[end] - times[anchor];
+			bool removable = span > 0.0f;
+			for (unsigned int i = anchor + 1; i < end && removable; i++)
+			{
+				float t = (times[i] - times[anchor]) / span;
+				removable = keyError(lerpKeys(values[anchor], values[end], t), values[i]) <= tolerance;
+			}
+			if (!removable) {
+				anchor = end - 1;
+				kept.push_back(anchor);
+			}
+		}
+		kept.push_back(numKeys - 1);
+		return kept;
+	}
+
+	static void compressTrack(const Vec3Track& track, float tolerance, CompressedVec3Track* compressed)
+	{
+		std::vector<unsigned int> kept = reduceKeys(track.times, track.values, tolerance);
+		if (kept.empty()) {
+			return;
+		}
+		glm::vec3 min = track.values[kept[0]];
+		glm::vec3 max = min;
+		for (size_t i = 1; i < kept.size(); i++)
+		{
+			min = glm::min(min, track.values[kept[i]]);
+			max = glm::max(max, track.values[kept[i]]);
+		}
+		compressed->min = min;
+		compressed->extent = max - min;
+		compressed->times.reserve(kept.size());
+		compressed->values.reserve(kept.size() * 3);
+		for (size_t i = 0; i < kept.size(); i++)
+		{
+			const glm::vec3& value = track.values[kept[i]];
+			compressed->times.push_back(track.times[kept[i]]);
+			for (int c = 0; c < 3; c++)
+			{
+				compressed->values.push_back(quantize(value[c], min[c], compressed->extent[c]));
+			}
+		}
+	}
+
+	static void compressTrack(const QuatTrack& track, float tolerance, CompressedQuatTrack* compressed)
+	{
+		std::vector<unsigned int> kept = reduceKeys(track.times, track.values, tolerance);
+		compressed->times.reserve(kept.size());
+		compressed->values.resize(kept.size() * 3);
+		for (size_t i = 0; i < kept.size(); i++)
+		{
+			compressed->times.push_back(track.times[kept[i]]);
+			encodeQuat(track.values[kept[i]], &compressed->values[i * 3]);
+		}
+	}
+
+	CompressedAnimationClip compressClip(const AnimationClip& clip, const AnimationCompressionOptions& options)
+	{
+		CompressedAnimationClip compressed;
+		compressed.duration = clip.duration;
+		compressed.channels.resize(clip.channels.size());
+		for (size_t i = 0; i < clip.channels.size(); i++)
+		{
+			const AnimationChannel& channel = clip.channels[i];
+			CompressedAnimationChannel& out = compressed.channels[i];
+			out.node = channel.node;
+			compressTrack(channel.position, options.positionTolerance, &out.position);
+			compressTrack(channel.rotation, options.rotationTolerance, &out.rotation);
+			compressTrack(channel.scale, options.scaleTolerance, &out.scale);
+		}
+		return compressed;
+	}
+
+	AnimationClip decompressClip(const CompressedAnimationClip& clip)
+	{
+		AnimationClip decompressed;
+		decompressed.channels.resize(clip.channels.size());
+		for (size_t i = 0; i < clip.channels.size(); i++)
+		{
+			const CompressedAnimationChannel& channel = clip.channels[i];
+			AnimationChannel& out = decompressed.channels[i];
+			out.node = channel.node;
+			for (unsigned int k = 0; k < channel.position.times.size(); k++)
+			{
+				out.position.times.push_back(channel.position.times[k]);
+				out.position.values.push_back(decodeVec3(channel.position, k));
+			}
+			for (unsigned int k = 0; k < channel.rotation.times.size(); k++)
+			{
+				float q[4];
+				decodeQuat(channel.rotation, k, q);
+				out.rotation.times.push_back(channel.rotation.times[k]);
+				out.rotation.values.push_back(glm::quat(q[3], q[0], q[1], q[2]));
+			}
+			for (unsigned int k = 0; k < channel.scale.times.size(); k++)
+			{
+				out.scale.times.push_back(channel.scale.times[k]);
+				out.scale.values.push_back(decodeVec3(channel.scale, k));
+			}
+		}
+		decompressed.duration = clip.duration;
+		return decompressed;
+	}
+
+	size_t getClipSize(const AnimationClip& clip)
+	{
+		size_t size = 0;
+		for (size_t i = 0; i < clip.channels.size(); i++)
+		{
+			const AnimationChannel& channel = clip.channels[i];
+			size += channel.position.times.size() * (sizeof(float) + sizeof(glm::vec3));
+			size += channel.rotation.times.size() * (sizeof(float) + sizeof(glm::quat));
+			size += channel.scale.times.size() * (sizeof(float) + sizeof(glm::vec3));
+		}
+		return size;
+	}
+
+	size_t getClipSize(const CompressedAnimationClip& clip)
+	{
+		size_t size = 0;
+		for (size_t i = 0; i < clip.channels.size(); i++)
+		{
+			const CompressedAnimationChannel& channel = clip.channels[i];
+			size += channel.position.times.size() * sizeof(float) + channel.position.values.size() * sizeof(uint16_t) + 2 * sizeof(glm::vec3);
+			size += channel.rotation.times.size() * sizeof(float) + channel.rotation.values.size() * sizeof(uint16_t);
+			size += channel.scale.times.size() * sizeof(float) + channel.scale.values.size() * sizeof(uint16_t) + 2 * sizeof(glm::vec3);
+		}
+		return size;
+	}
+}
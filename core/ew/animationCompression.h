@@ -0,0 +1,76 @@
+#pragma once
+#include "animation.h"
+#include <stdint.h>
+#include <math.h>
+
+namespace ew {
+	//Keys as 16 bits per component of the track's range, 6 bytes a key
+	struct CompressedVec3Track {
+		std::vector<float> times;
+		std::vector<uint16_t> values; //3 per key
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 extent = glm::vec3(0.0f); //Max minus min
+	};
+	//Keys in smallest three form: the index of the largest component in 2 bits, and the other three in 15 bits
+	//each, in 48 bits. The largest is rebuilt from the unit length.
+	struct CompressedQuatTrack {
+		std::vector<float> times;
+		std::vector<uint16_t> values; //3 per key
+	};
+
+	struct CompressedAnimationChannel {
+		int node = -1;
+		CompressedVec3Track position;
+		CompressedQuatTrack rotation;
+		CompressedVec3Track scale;
+	};
+
+	//Sampled by AnimationPlayer like an AnimationClip, decoding the keys it needs as it goes
+	struct CompressedAnimationClip {
+		float duration = 0.0f;
+		std::vector<CompressedAnimationChannel> channels;
+	};
+
+	//How far a key may be from where the keys around it put it and still be removed. Quantizing adds up to half a
+	//step, 1/65535 of the track's range or about 0.0001 radians, on top.
+	struct AnimationCompressionOptions {
+		float positionTolerance = 0.001f; //Distance
+		float rotationTolerance = 0.001f; //Radians
+		float scaleTolerance = 0.001f;
+	};
+
+	CompressedAnimationClip compressClip(const AnimationClip& clip, const AnimationCompressionOptions& options = AnimationCompressionOptions());
+	AnimationClip decompressClip(const CompressedAnimationClip& clip);
+	//Bytes of key times and values
+	size_t getClipSize(const AnimationClip& clip);
+	size_t getClipSize(const CompressedAnimationClip& clip);
+
+	//smallest three uses 15 bits for components within +-1/sqrt(2)
+	static const float QUAT_COMPONENT_RANGE = 0.70710678f;
+
+	inline glm::vec3 decodeVec3(const CompressedVec3Track& track, unsigned int key) {
+		const uint16_t* v = &track.values[key * 3];
+		return glm::vec3(track.min.x + v[0] * (track.extent.x / 65535.0f),
+			track.min.y + v[1] * (track.extent.y / 65535.0f),
+			track.min.z + v[2] * (track.extent.z / 65535.0f));
+	}
+	//Writes x, y, z, w
+	inline void decodeQuat(const CompressedQuatTrack& track, unsigned int key, float* q) {
+		const uint16_t* v = &track.values[key * 3];
+		uint64_t bits = ((uint64_t)v[0] << 32) | ((uint64_t)v[1] << 16) | v[2];
+		int largest = (int)(bits >> 45) & 3;
+		float sum = 0.0f;
+		for (int i = 0, j = 0; i < 4; i++)
+		{
+			if (i == largest) {
+				continue;
+			}
+			unsigned int quantized = (unsigned int)(bits >> (30 - 15 * j)) & 0x7FFF;
+			q[i] = (quantized / 32767.0f * 2.0f - 1.0f) * QUAT_COMPONENT_RANGE;
+			sum += q[i] * q[i];
+			j++;
+		}
+		//Encoding flips the sign so the largest is positive
+		q[largest] = sqrtf(fmaxf(1.0f - sum, 0.0f));
+	}
+}
@@ -0,0 +1,332 @@
+#include "clusterGrid.h"
+#include "jobSystem.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_CLUSTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	//Lights are prepared in batches of this size, so each task is big enough to be worth scheduling
+	static const unsigned int LIGHT_BATCH_SIZE = 256;
+
+	ClusterGrid::ClusterGrid(unsigned int tilesX, unsigned int tilesY, unsigned int depthSlices, JobSystem* jobs)
+		: m_tilesX(tilesX), m_tilesY(tilesY), m_depthSlices(depthSlices), m_jobs(jobs)
+	{
+		m_sliceBounds.resize(depthSlices);
+		m_sliceLights.resize(depthSlices);
+		m_slicePairs.resize(depthSlices);
+		m_sliceIndices.resize(depthSlices);
+		m_clusters.resize(getNumClusters());
+	}
+
+	float ClusterGrid::getSliceDepth(unsigned int slice) const
+	{
+		float t = (float)slice / m_depthSlices;
+		if (m_orthographic) {
+			return m_nearPlane + (m_farPlane - m_nearPlane) * t;
+		}
+		//Exponential slices keep clusters roughly cube shaped in perspective
+		return m_nearPlane * powf(m_farPlane / m_nearPlane, t);
+	}
+
+	unsigned int ClusterGrid::getDepthSlice(float viewDepth) const
+	{
+		float t;
+		if (m_orthographic) {
+			t = (viewDepth - m_nearPlane) / (m_farPlane - m_nearPlane);
+		}
+		else {
+			t = viewDepth <= m_nearPlane ? 0.0f : logf(viewDepth / m_nearPlane) / logf(m_farPlane / m_nearPlane);
+		}
+		int slice = (int)floorf(t * m_depthSlices);
+		return (unsigned int)glm::clamp(slice, 0, (int)m_depthSlices - 1);
+	}
+
+	/// <summary>
+	/// Recomputes the view space AABB of every cluster. Only runs when the projection changes.
+	/// </summary>
+	void ClusterGrid::updateClusterBounds(const Camera& camera)
+	{
+		glm::mat4 projection = camera.projectionMatrix();
+		if (projection == m_projection) {
+			return;
+		}
+		m_projection = projection;
+		m_nearPlane = camera.nearPlane;
+		m_farPlane = camera.farPlane;
+		m_orthographic = camera.orthographic;
+
+		glm::mat4 invProjection = glm::inverse(projection);
+		unsigned int tilesPerSlice = m_tilesX * m_tilesY;
+		for (unsigned int slice = 0; slice < m_depthSlices; slice++)
+		{
+			//Padded by 4 so SIMD loads at the end of the last row stay in bounds
+			SliceBounds& bounds = m_sliceBounds[slice];
+			bounds.minX.assign(tilesPerSlice + 4, 1e30f);
+			bounds.minY.assign(tilesPerSlice + 4, 1e30f);
+			bounds.minZ.assign(tilesPerSlice + 4, 1e30f);
+			bounds.maxX.assign(tilesPerSlice + 4, -1e30f);
+			bounds.maxY.assign(tilesPerSlice + 4, -1e30f);
+			bounds.maxZ.assign(tilesPerSlice + 4, -1e30f);
+		}
+
+		for (unsigned int y = 0; y < m_tilesY; y++)
+		{
+			for (unsigned int x = 0; x < m_tilesX; x++)
+			{
+				//Tile corners on the near and far planes. Points in between are found by interpolating on depth.
+				glm::vec3 nearCorners[4];
+				glm::vec3 farCorners[4];
+				for (int c = 0; c < 4; c++)
+				{
+					float ndcX = -1.0f + 2.0f * (float)(x + (c % 2)) / m_tilesX;
+					float ndcY = -1.0f + 2.0f * (float)(y + (c / 2)) / m_tilesY;
+					glm::vec4 n = invProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+					glm::vec4 f = invProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+					nearCorners[c] = glm::vec3(n) / n.w;
+					farCorners[c] = glm::vec3(f) / f.w;
+				}
+				unsigned int tile = y * m_tilesX + x;
+				for (unsigned int slice = 0; slice < m_depthSlices; slice++)
+				{
+					SliceBounds& bounds = m_sliceBounds[slice];
+					float depths[2] = { getSliceDepth(slice), getSliceDepth(slice + 1) };
+					for (int c = 0; c < 4; c++)
+					{
+						float nearDepth = -nearCorners[c].z;
+						float farDepth = -farCorners[c].z;
+						for (int d = 0; d < 2; d++)
+						{
+							float t = (depths[d] - nearDepth) / (farDepth - nearDepth);
+							glm::vec3 p = nearCorners[c] + (farCorners[c] - nearCorners[c]) * t;
+							bounds.minX[tile] = glm::min(bounds.minX[tile], p.x);
+							bounds.minY[tile] = glm::min(bounds.minY[tile], p.y);
+							bounds.minZ[tile] = glm::min(bounds.minZ[tile], p.z);
+							bounds.maxX[tile] = glm::max(bounds.maxX[tile], p.x);
+							bounds.maxY[tile] = glm::max(bounds.maxY[tile], p.y);
+							bounds.maxZ[tile] = glm::max(bounds.maxZ[tile], p.z);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Finds the range of tiles and slices a light's sphere can touch.
+	/// The tile range comes from projecting the corners of the sphere's view space box, clamped to the frustum depth.
+	/// </summary>
+	void ClusterGrid::computeLightBounds(const glm::mat4& view, const glm::mat4& projection, const PointLight& light, LightBounds* bounds) const
+	{
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		float radius = light.radius;
+		bounds->center = center;
+		bounds->radius = radius;
+		//Empty ranges unless the light is found to be visible
+		bounds->minX = bounds->minY = bounds->minSlice = 1;
+		bounds->maxX = bounds->maxY = bounds->maxSlice = 0;
+
+		float minDepth = -center.z - radius;
+		float maxDepth = -center.z + radius;
+		if (maxDepth < m_nearPlane || minDepth > m_farPlane) {
+			return;
+		}
+
+		float zs[2] = { -glm::clamp(minDepth, m_nearPlane, m_farPlane), -glm::clamp(maxDepth, m_nearPlane, m_farPlane) };
+		glm::vec2 ndcMin = glm::vec2(1e30f);
+		glm::vec2 ndcMax = glm::vec2(-1e30f);
+		for (int c = 0; c < 8; c++)
+		{
+			glm::vec4 corner = glm::vec4(
+				center.x + ((c & 1) ? radius : -radius),
+				center.y + ((c & 2) ? radius : -radius),
+				zs[c >> 2], 1.0f);
+			glm::vec4 clip = projection * corner;
+			glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f) {
+			return;
+		}
+		bounds->minX = glm::clamp((int)floorf((ndcMin.x * 0.5f + 0.5f) * m_tilesX), 0, (int)m_tilesX - 1);
+		bounds->maxX = glm::clamp((int)floorf((ndcMax.x * 0.5f + 0.5f) * m_tilesX), 0, (int)m_tilesX - 1);
+		bounds->minY = glm::clamp((int)floorf((ndcMin.y * 0.5f + 0.5f) * m_tilesY), 0, (int)m_tilesY - 1);
+		bounds->maxY = glm::clamp((int)floorf((ndcMax.y * 0.5f + 0.5f) * m_tilesY), 0, (int)m_tilesY - 1);
+		bounds->minSlice = (int)getDepthSlice(glm::max(minDepth, m_nearPlane));
+		bounds->maxSlice = (int)getDepthSlice(glm::min(maxDepth, m_farPlane));
+	}
+
+	/// <summary>
+	/// Tests 4 consecutive cluster AABBs against a sphere
+	/// </summary>
+	/// <returns>Bit i is set if tile + i overlaps the sphere</returns>
+	static int testSphereAABB4(const float* minX, const float* minY, const float* minZ,
+		const float* maxX, const float* maxY, const float* maxZ, const glm::vec3& center, float radius)
+	{
+#ifdef EW_CLUSTER_SSE
+		const __m128 zero = _mm_setzero_ps();
+		__m128 cx = _mm_set1_ps(center.x);
+		__m128 cy = _mm_set1_ps(center.y);
+		__m128 cz = _mm_set1_ps(center.z);
+		//Distance from the center to each box along each axis, 0 if inside
+		__m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX), cx), _mm_sub_ps(cx, _mm_loadu_ps(maxX))));
+		__m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minY), cy), _mm_sub_ps(cy, _mm_loadu_ps(maxY))));
+		__m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minZ), cz), _mm_sub_ps(cz, _mm_loadu_ps(maxZ))));
+		__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		return _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_set1_ps(radius * radius)));
+#else
+		int mask = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			float dx = glm::max(0.0f, glm::max(minX[i] - center.x, center.x - maxX[i]));
+			float dy = glm::max(0.0f, glm::max(minY[i] - center.y, center.y - maxY[i]));
+			float dz = glm::max(0.0f, glm::max(minZ[i] - center.z, center.z - maxZ[i]));
+			if (dx * dx + dy * dy + dz * dz <= radius * radius) {
+				mask |= 1 << i;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	/// <summary>
+	/// Builds the light lists of every cluster in one depth slice.
+	/// Slices share no output, so they can run on different threads.
+	/// </summary>
+	void ClusterGrid::assignSlice(unsigned int slice)
+	{
+		const SliceBounds& bounds = m_sliceBounds[slice];
+		std::vector<ClusterLight>& pairs = m_slicePairs[slice];
+		pairs.clear();
+		const std::vector<unsigned int>& sliceLights = m_sliceLights[slice];
+		for (size_t l = 0; l < sliceLights.size(); l++)
+		{
+			unsigned int i = sliceLights[l];
+			const LightBounds& light = m_lightBounds[i];
+			for (int y = light.minY; y <= light.maxY; y++)
+			{
+				unsigned int rowStart = y * m_tilesX;
+				for (int x = light.minX; x <= light.maxX; x += 4)
+				{
+					unsigned int tile = rowStart + x;
+					int hits = testSphereAABB4(&bounds.minX[tile], &bounds.minY[tile], &bounds.minZ[tile],
+						&bounds.maxX[tile], &bounds.maxY[tile], &bounds.maxZ[tile], light.center, light.radius);
+					//Ignore lanes past the end of the light's tile range
+					int numLanes = glm::min(4, light.maxX - x + 1);
+					hits &= (1 << numLanes) - 1;
+					for (int lane = 0; lane < numLanes; lane++)
+					{
+						if (hits & (1 << lane)) {
+							ClusterLight pair;
+							pair.cluster = tile + lane;
+							pair.light = i;
+							pairs.push_back(pair);
+						}
+					}
+				}
+			}
+		}
+
+		//Counting sort by cluster. Offsets are relative to this slice until build() compacts them.
+		unsigned int tilesPerSlice = m_tilesX * m_tilesY;
+		ClusterRange* ranges = &m_clusters[slice * tilesPerSlice];
+		memset(ranges, 0, sizeof(ClusterRange) * tilesPerSlice);
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			ranges[pairs[i].cluster].count++;
+		}
+		unsigned int offset = 0;
+		for (unsigned int i = 0; i < tilesPerSlice; i++)
+		{
+			ranges[i].offset = offset;
+			offset += ranges[i].count;
+			ranges[i].count = 0;
+		}
+		std::vector<unsigned int>& indices = m_sliceIndices[slice];
+		indices.resize(pairs.size());
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			ClusterRange& range = ranges[pairs[i].cluster];
+			indices[range.offset + range.count++] = pairs[i].light;
+		}
+	}
+
+	//fn(i) for every i in [0, count), one job each. fn is passed by reference all the way down, so nothing is allocated.
+	template<typename Fn>
+	static void runParallel(JobSystem* jobs, unsigned int count, const Fn& fn)
+	{
+		if (jobs != nullptr) {
+			jobs->parallelForEach(count, fn);
+			return;
+		}
+		for (unsigned int i = 0; i < count; i++)
+		{
+			fn(i);
+		}
+	}
+
+	/// <summary>
+	/// Assigns lights to clusters for this camera.
+	/// Light indices in each cluster stay in the same order as the lights array.
+	/// </summary>
+	void ClusterGrid::build(const Camera& camera, const PointLight* lights, unsigned int numLights)
+	{
+		updateClusterBounds(camera);
+		glm::mat4 view = camera.viewMatrix();
+
+		m_lightBounds.resize(numLights);
+		unsigned int numBatches = (numLights + LIGHT_BATCH_SIZE - 1) / LIGHT_BATCH_SIZE;
+		runParallel(m_jobs, numBatches, [&](unsigned int batch) {
+			unsigned int end = glm::min((batch + 1) * LIGHT_BATCH_SIZE, numLights);
+			for (unsigned int i = batch * LIGHT_BATCH_SIZE; i < end; i++)
+			{
+				computeLightBounds(view, m_projection, lights[i], &m_lightBounds[i]);
+			}
+		});
+
+		//Bin lights by depth slice so each slice only visits lights that can touch it
+		for (unsigned int slice = 0; slice < m_depthSlices; slice++)
+		{
+			m_sliceLights[slice].clear();
+		}
+		for (unsigned int i = 0; i < numLights; i++)
+		{
+			const LightBounds& bounds = m_lightBounds[i];
+			for (int slice = bounds.minSlice; slice <= bounds.maxSlice; slice++)
+			{
+				m_sliceLights[slice].push_back(i);
+			}
+		}
+
+		runParallel(m_jobs, m_depthSlices, [&](unsigned int slice) {
+			assignSlice(slice);
+		});
+
+		//Concatenate the slices into one index list
+		size_t total = 0;
+		for (unsigned int slice = 0; slice < m_depthSlices; slice++)
+		{
+			total += m_sliceIndices[slice].size();
+		}
+		m_lightIndices.resize(total);
+		unsigned int tilesPerSlice = m_tilesX * m_tilesY;
+		unsigned int base = 0;
+		for (unsigned int slice = 0; slice < m_depthSlices; slice++)
+		{
+			const std::vector<unsigned int>& indices = m_sliceIndices[slice];
+			if (!indices.empty()) {
+				memcpy(&m_lightIndices[base], indices.data(), sizeof(unsigned int) * indices.size());
+			}
+			ClusterRange* ranges = &m_clusters[slice * tilesPerSlice];
+			for (unsigned int i = 0; i < tilesPerSlice; i++)
+			{
+				ranges[i].offset += base;
+			}
+			base += (unsigned int)indices.size();
+		}
+	}
+}
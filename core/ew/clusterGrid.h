@@ -0,0 +1,69 @@
+#pragma once
+#include "camera.h"
+#include "lightBuffer.h"
+#include <vector>
+
+namespace ew {
+	class JobSystem;
+
+	//Range of ClusterGrid::getLightIndices() that affects one cluster
+	struct ClusterRange {
+		unsigned int offset;
+		unsigned int count;
+	};
+
+	//Splits a camera frustum into tilesX * tilesY screen tiles and depthSlices view depth slices,
+	//and lists the point lights whose bounding sphere touches each cluster.
+	//CPU only, so it can be built and timed without a GL context.
+	class ClusterGrid {
+	public:
+		//jobs is optional. Without it the grid is built on the calling thread. Building with it doesn't allocate.
+		ClusterGrid(unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int depthSlices = 24, JobSystem* jobs = nullptr);
+		void build(const Camera& camera, const PointLight* lights, unsigned int numLights);
+
+		//Cluster index = (slice * tilesY + y) * tilesX + x
+		inline unsigned int getClusterIndex(unsigned int x, unsigned int y, unsigned int slice)const { return (slice * m_tilesY + y) * m_tilesX + x; }
+		//Slice containing a positive view space depth
+		unsigned int getDepthSlice(float viewDepth)const;
+		inline const std::vector<ClusterRange>& getClusters()const { return m_clusters; }
+		inline const std::vector<unsigned int>& getLightIndices()const { return m_lightIndices; }
+		inline unsigned int getTilesX()const { return m_tilesX; }
+		inline unsigned int getTilesY()const { return m_tilesY; }
+		inline unsigned int getDepthSlices()const { return m_depthSlices; }
+		inline unsigned int getNumClusters()const { return m_tilesX * m_tilesY * m_depthSlices; }
+	private:
+		//View space bounds of a light, and the clusters it may touch
+		struct LightBounds {
+			glm::vec3 center;
+			float radius;
+			int minX, maxX, minY, maxY, minSlice, maxSlice;
+		};
+		struct ClusterLight {
+			unsigned int cluster; //Index within the slice
+			unsigned int light;
+		};
+		//Cluster AABBs for one depth slice, SoA so 4 tiles can be tested at once
+		struct SliceBounds {
+			std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+		};
+
+		void updateClusterBounds(const Camera& camera);
+		float getSliceDepth(unsigned int slice)const;
+		void computeLightBounds(const glm::mat4& view, const glm::mat4& projection, const PointLight& light, LightBounds* bounds)const;
+		void assignSlice(unsigned int slice);
+
+		unsigned int m_tilesX, m_tilesY, m_depthSlices;
+		JobSystem* m_jobs;
+		float m_nearPlane = 0, m_farPlane = 0;
+		bool m_orthographic = false;
+		glm::mat4 m_projection = glm::mat4(0.0f);
+
+		std::vector<SliceBounds> m_sliceBounds;
+		std::vector<LightBounds> m_lightBounds;
+		std::vector<std::vector<unsigned int>> m_sliceLights; //Lights whose depth range touches each slice
+		std::vector<std::vector<ClusterLight>> m_slicePairs;
+		std::vector<std::vector<unsigned int>> m_sliceIndices;
+		std::vector<ClusterRange> m_clusters;
+		std::vector<unsigned int> m_lightIndices;
+	};
+}
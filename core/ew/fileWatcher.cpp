@@ -0,0 +1,127 @@
+#include "fileWatcher.h"
+#include <stdio.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include "meshCache.h"
+#endif
+
+namespace ew {
+#ifdef __linux__
+	FileWatcher::FileWatcher()
+	{
+		m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_fd < 0) {
+			printf("Failed to start watching files\n");
+		}
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+		if (m_fd >= 0) {
+			close(m_fd);
+		}
+	}
+
+	void FileWatcher::watch(const std::string& filePath)
+	{
+		if (m_fd < 0 || isWatching(filePath)) {
+			return;
+		}
+		size_t slash = filePath.find_last_of('/');
+		std::string prefix = slash == std::string::npos ? "" : filePath.substr(0, slash + 1);
+		std::string directory = prefix.empty() ? "." : prefix;
+		//Adding a directory again returns the descriptor it already has
+		int wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd < 0) {
+			printf("Failed to watch %s\n", filePath.c_str());
+			return;
+		}
+		m_directories[wd] = prefix;
+		m_files.push_back(filePath);
+	}
+
+	std::vector<std::string> FileWatcher::poll()
+	{
+		std::vector<std::string> changed;
+		if (m_fd < 0) {
+			return changed;
+		}
+		alignas(inotify_event) char buffer[4096];
+		while (true) {
+			ssize_t size = read(m_fd, buffer, sizeof(buffer));
+			if (size <= 0) {
+				//EAGAIN once every pending event has been read
+				break;
+			}
+			for (ssize_t offset = 0; offset < size; )
+			{
+				const inotify_event* event = (const inotify_event*)(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+				auto it = m_directories.find(event->wd);
+				if (event->len == 0 || it == m_directories.end()) {
+					continue;
+				}
+				std::string filePath = it->second + event->name;
+				if (isWatching(filePath)) {
+					bool seen = false;
+					for (size_t i = 0; i < changed.size() && !seen; i++)
+					{
+						seen = changed[i] == filePath;
+					}
+					if (!seen) {
+						changed.push_back(filePath);
+					}
+				}
+			}
+		}
+		return changed;
+	}
+#else
+	FileWatcher::FileWatcher()
+	{
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+	}
+
+	void FileWatcher::watch(const std::string& filePath)
+	{
+		if (isWatching(filePath)) {
+			return;
+		}
+		MeshCacheKey info;
+		getSourceFileInfo(filePath, &info);
+		m_files.push_back(filePath);
+		m_mtimes.push_back(info.sourceMtime);
+	}
+
+	std::vector<std::string> FileWatcher::poll()
+	{
+		std::vector<std::string> changed;
+		for (size_t i = 0; i < m_files.size(); i++)
+		{
+			MeshCacheKey info;
+			//A file being replaced may be missing for a moment, so wait until it is back
+			if (getSourceFileInfo(m_files[i], &info) && info.sourceMtime != m_mtimes[i]) {
+				m_mtimes[i] = info.sourceMtime;
+				changed.push_back(m_files[i]);
+			}
+		}
+		return changed;
+	}
+#endif
+
+	int FileWatcher::indexOf(const std::string& filePath)const
+	{
+		for (size_t i = 0; i < m_files.size(); i++)
+		{
+			if (m_files[i] == filePath) {
+				return (int)i;
+			}
+		}
+		return -1;
+	}
+}
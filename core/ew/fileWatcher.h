@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#ifdef __linux__
+#include <unordered_map>
+#endif
+
+namespace ew {
+	//Reports files that changed on disk. On Linux an inotify watch on each file's directory also catches editors
+	//that save by writing a new file and renaming it over the old one. Elsewhere modification times are compared
+	//on every poll, which is fine for the few dozen files shaders use.
+	class FileWatcher {
+	public:
+		FileWatcher();
+		~FileWatcher();
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		//Watching a file twice does nothing
+		void watch(const std::string& filePath);
+		inline bool isWatching(const std::string& filePath)const { return indexOf(filePath) >= 0; }
+		//Every watched file that changed since the last call, each once, as it was passed to watch()
+		std::vector<std::string> poll();
+	private:
+		int indexOf(const std::string& filePath)const;
+
+		std::vector<std::string> m_files;
+#ifdef __linux__
+		int m_fd = -1;
+		std::unordered_map<int, std::string> m_directories; //Watch descriptor to directory prefix, "" or ending in /
+#else
+		std::vector<uint64_t> m_mtimes;
+#endif
+	};
+}
@@ -0,0 +1,74 @@
+#include "frameArena.h"
+#include <algorithm>
+#include <stdint.h>
+
+namespace ew {
+	FrameArena::FrameArena(size_t blockSize)
+	{
+		addBlock(blockSize);
+	}
+
+	FrameArena::~FrameArena()
+	{
+		for (size_t i = 0; i < m_blocks.size(); i++)
+		{
+			delete[] m_blocks[i].data;
+		}
+	}
+
+	void FrameArena::addBlock(size_t minSize)
+	{
+		Block block;
+		block.size = std::max(minSize, m_blocks.empty() ? (size_t)0 : m_blocks.back().size * 2);
+		block.data = new unsigned char[block.size];
+		m_blocks.push_back(block);
+	}
+
+	void* FrameArena::allocate(size_t size, size_t alignment)
+	{
+		while (true) {
+			Block& block = m_blocks[m_current];
+			uintptr_t start = (uintptr_t)block.data + m_offset;
+			size_t padding = (alignment - (start & (alignment - 1))) & (alignment - 1);
+			if (m_offset + padding + size <= block.size) {
+				m_offset += padding + size;
+				return (void*)(start + padding);
+			}
+			//Leave the rest of this block unused and move on, adding a block big enough if there isn't one
+			m_usedBytes += block.size;
+			m_offset = 0;
+			m_current++;
+			if (m_current == m_blocks.size()) {
+				addBlock(size + alignment);
+			}
+		}
+	}
+
+	void FrameArena::reset()
+	{
+		m_peakBytes = std::max(m_peakBytes, getUsedBytes());
+		//Frames that needed several blocks will likely need them again, so merge them into one
+		if (m_blocks.size() > 1) {
+			size_t capacity = getCapacity();
+			for (size_t i = 0; i < m_blocks.size(); i++)
+			{
+				delete[] m_blocks[i].data;
+			}
+			m_blocks.clear();
+			addBlock(capacity);
+		}
+		m_current = 0;
+		m_offset = 0;
+		m_usedBytes = 0;
+	}
+
+	size_t FrameArena::getCapacity()const
+	{
+		size_t capacity = 0;
+		for (size_t i = 0; i < m_blocks.size(); i++)
+		{
+			capacity += m_blocks[i].size;
+		}
+		return capacity;
+	}
+}
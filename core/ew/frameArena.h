@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+#include <new>
+#include <cstddef>
+
+//std::pmr needs C++17 and a standard library that ships <memory_resource>
+#if defined(__has_include)
+#if __has_include(<memory_resource>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#define EW_FRAME_ARENA_PMR
+#include <memory_resource>
+#endif
+#endif
+
+namespace ew {
+	//Bump allocator for data that only lives until the end of the frame. Allocating moves a pointer and freeing
+	//does nothing. reset() releases everything at once. If a frame outgrows the block, more blocks are added and
+	//the next reset() merges them into one, so after the first few frames it never touches the heap.
+	//Not thread safe. Give each thread its own arena.
+	class FrameArena {
+	public:
+		FrameArena(size_t blockSize = 1024 * 1024);
+		~FrameArena();
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		template<typename T>
+		T* allocateArray(size_t count) { return (T*)allocate(sizeof(T) * count, alignof(T)); }
+		//Invalidates everything allocated since the last reset
+		void reset();
+
+		inline size_t getUsedBytes()const { return m_usedBytes + m_offset; }
+		//Most bytes used in one frame since construction
+		inline size_t getPeakBytes()const { return m_peakBytes; }
+		size_t getCapacity()const;
+	private:
+		struct Block {
+			unsigned char* data;
+			size_t size;
+		};
+		void addBlock(size_t minSize);
+
+		std::vector<Block> m_blocks;
+		size_t m_current = 0; //Block being allocated from
+		size_t m_offset = 0; //Into the current block
+		size_t m_usedBytes = 0; //In blocks before the current one
+		size_t m_peakBytes = 0;
+	};
+
+	//Standard allocator over a FrameArena, so containers can live in it. Deallocating does nothing.
+	//A null arena falls back to the heap, for code that is also called outside the frame.
+	template<typename T>
+	class FrameAllocator {
+	public:
+		typedef T value_type;
+
+		FrameAllocator(FrameArena* arena = nullptr) : m_arena(arena) {}
+		template<typename U>
+		FrameAllocator(const FrameAllocator<U>& other) : m_arena(other.getArena()) {}
+
+		T* allocate(size_t count) {
+			if (m_arena != nullptr) {
+				return m_arena->allocateArray<T>(count);
+			}
+			return (T*)::operator new(sizeof(T) * count);
+		}
+		void deallocate(T* p, size_t) {
+			if (m_arena == nullptr) {
+				::operator delete(p);
+			}
+		}
+		inline FrameArena* getArena()const { return m_arena; }
+	private:
+		FrameArena* m_arena;
+	};
+	template<typename T, typename U>
+	bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.getArena() == b.getArena(); }
+	template<typename T, typename U>
+	bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.getArena() != b.getArena(); }
+
+	template<typename T>
+	using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#ifdef EW_FRAME_ARENA_PMR
+	//std::pmr view of a FrameArena, for std::pmr containers and strings
+	class FrameArenaResource : public std::pmr::memory_resource {
+	public:
+		FrameArenaResource(FrameArena* arena) : m_arena(arena) {}
+		inline FrameArena* getArena()const { return m_arena; }
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override { return m_arena->allocate(bytes, alignment); }
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override { return this == &other; }
+
+		FrameArena* m_arena;
+	};
+#endif
+}
@@ -0,0 +1,74 @@
+#include "indexData.h"
+
+namespace ew {
+	void IndexData::set(size_t i, unsigned int index)
+	{
+		if (m_type == IndexType::UINT16) {
+			if (index <= 0xffff) {
+				m_indices16[i] = (uint16_t)index;
+				return;
+			}
+			widen();
+		}
+		m_indices32[i] = index;
+	}
+
+	void IndexData::assign(const std::vector<unsigned int>& indices)
+	{
+		clear();
+		append(indices);
+	}
+
+	void IndexData::append(const std::vector<unsigned int>& indices)
+	{
+		if (m_type == IndexType::UINT16) {
+			unsigned int maxIndex = 0;
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+			}
+			if (maxIndex > 0xffff) {
+				widen();
+			}
+			else {
+				m_indices16.insert(m_indices16.end(), indices.begin(), indices.end());
+				return;
+			}
+		}
+		m_indices32.insert(m_indices32.end(), indices.begin(), indices.end());
+	}
+
+	void IndexData::reserve(size_t count)
+	{
+		if (m_type == IndexType::UINT16) {
+			m_indices16.reserve(count);
+		}
+		else {
+			m_indices32.reserve(count);
+		}
+	}
+
+	void IndexData::clear()
+	{
+		m_type = IndexType::UINT16;
+		m_indices16.clear();
+		m_indices32.clear();
+	}
+
+	std::vector<unsigned int> IndexData::toVector() const
+	{
+		if (m_type == IndexType::UINT16) {
+			return std::vector<unsigned int>(m_indices16.begin(), m_indices16.end());
+		}
+		return m_indices32;
+	}
+
+	void IndexData::widen()
+	{
+		m_indices32.assign(m_indices16.begin(), m_indices16.end());
+		m_indices32.reserve(m_indices16.capacity());
+		m_indices16.clear();
+		m_indices16.shrink_to_fit();
+		m_type = IndexType::UINT32;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace ew {
+	enum class IndexType {
+		UINT16 = 0,
+		UINT32 = 1
+	};
+
+	//Index list that stores uint16 until an index above 65535 is added, then widens itself to uint32.
+	//Meshes with up to 65536 vertices therefore get half size index buffers without callers choosing a width.
+	class IndexData {
+	public:
+		IndexData() {};
+		IndexData(const std::vector<unsigned int>& indices) { assign(indices); }
+		inline IndexData& operator=(const std::vector<unsigned int>& indices) { assign(indices); return *this; }
+
+		inline unsigned int operator[](size_t i)const { return m_type == IndexType::UINT16 ? m_indices16[i] : m_indices32[i]; }
+		inline size_t size()const { return m_type == IndexType::UINT16 ? m_indices16.size() : m_indices32.size(); }
+		inline bool empty()const { return size() == 0; }
+		inline IndexType getType()const { return m_type; }
+		inline size_t getIndexSize()const { return m_type == IndexType::UINT16 ? sizeof(uint16_t) : sizeof(unsigned int); }
+		inline const void* data()const { return m_type == IndexType::UINT16 ? (const void*)m_indices16.data() : (const void*)m_indices32.data(); }
+
+		inline void push_back(unsigned int index) {
+			if (m_type == IndexType::UINT16) {
+				if (index <= 0xffff) {
+					m_indices16.push_back((uint16_t)index);
+					return;
+				}
+				widen();
+			}
+			m_indices32.push_back(index);
+		}
+		void set(size_t i, unsigned int index);
+		void assign(const std::vector<unsigned int>& indices);
+		void append(const std::vector<unsigned int>& indices);
+		void reserve(size_t count);
+		void clear();
+		std::vector<unsigned int> toVector()const;
+	private:
+		void widen();
+		IndexType m_type = IndexType::UINT16;
+		std::vector<uint16_t> m_indices16;
+		std::vector<unsigned int> m_indices32;
+	};
+}
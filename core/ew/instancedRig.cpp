@@ -0,0 +1,57 @@
+#include "instancedRig.h"
+#include "external/glad.h"
+#include <stdio.h>
+
+namespace ew {
+	InstancedRig::InstancedRig(const BakedAnimation& baked)
+	{
+		m_numNodes = (unsigned int)baked.numNodes;
+		m_numFrames = (unsigned int)baked.numFrames;
+		m_frameRate = baked.frameRate;
+
+		int maxSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		if (baked.getWidth() > maxSize || baked.getHeight() > maxSize) {
+			printf("Baked animation of %dx%d texels is larger than the %d texel limit\n", baked.getWidth(), baked.getHeight(), maxSize);
+		}
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+		if (m_numNodes > 0) {
+			glTextureStorage2D(m_texture, 1, GL_RGBA32F, baked.getWidth(), baked.getHeight());
+			glTextureSubImage2D(m_texture, 0, 0, 0, baked.getWidth(), baked.getHeight(), GL_RGBA, GL_FLOAT, baked.matrices.data());
+		}
+		//Read with texelFetch, so filtering only has to be valid for the texture to be complete
+		glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glCreateBuffers(1, &m_ssbo);
+		//Never allocate an empty buffer, binding it would fail
+		RigInstance dummyInstance = {};
+		glNamedBufferData(m_ssbo, sizeof(RigInstance), &dummyInstance, GL_STATIC_DRAW);
+	}
+	InstancedRig::~InstancedRig()
+	{
+		glDeleteTextures(1, &m_texture);
+		glDeleteBuffers(1, &m_ssbo);
+	}
+	void InstancedRig::setInstances(const RigInstance* instances, unsigned int count)
+	{
+		RigInstance dummyInstance = {};
+		if (count == 0) {
+			glNamedBufferData(m_ssbo, sizeof(RigInstance), &dummyInstance, GL_STATIC_DRAW);
+		}
+		else {
+			glNamedBufferData(m_ssbo, sizeof(RigInstance) * count, instances, GL_STATIC_DRAW);
+		}
+		m_numInstances = count;
+	}
+	void InstancedRig::bind(const Shader& shader, float time, unsigned int textureUnit, unsigned int instanceBindingIndex) const
+	{
+		glBindTextureUnit(textureUnit, m_texture);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instanceBindingIndex, m_ssbo);
+		shader.setInt("_BakedAnimation", (int)textureUnit);
+		shader.setInt("_NumNodes", (int)m_numNodes);
+		shader.setInt("_NumFrames", (int)m_numFrames);
+		shader.setFloat("_FrameRate", m_frameRate);
+		shader.setFloat("_Time", time);
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "animationBaker.h"
+#include "shader.h"
+
+namespace ew {
+	//Matches the std430 layout of RigInstance in the shader (16 bytes)
+	struct RigInstance {
+		glm::vec3 position;
+		float timeOffset; //Added to the time passed to draw
+	};
+
+	//A BakedAnimation in an RGBA32F texture, and a shader storage buffer of instances playing it. Every node of every
+	//instance is one instance of a single instanced draw: rig gl_InstanceID / numNodes, node gl_InstanceID % numNodes.
+	//The vertex shader reads the node's matrices from the texture and lerps between frames like sampleBakedAnimation.
+	class InstancedRig {
+	public:
+		InstancedRig(const BakedAnimation& baked);
+		~InstancedRig();
+		InstancedRig(const InstancedRig&) = delete;
+		InstancedRig& operator=(const InstancedRig&) = delete;
+
+		void setInstances(const RigInstance* instances, unsigned int count);
+		//Binds the texture and instances and sets _BakedAnimation, _NumNodes, _NumFrames, _FrameRate and _Time.
+		//shader must be in use.
+		void bind(const Shader& shader, float time, unsigned int textureUnit, unsigned int instanceBindingIndex)const;
+		//Draws model at every node of every instance, in one instanced draw per mesh
+		template<class Model>
+		void draw(const Model& model, const Shader& shader, float time, unsigned int textureUnit, unsigned int instanceBindingIndex)const {
+			bind(shader, time, textureUnit, instanceBindingIndex);
+			model.drawInstanced(getNumDrawInstances());
+		}
+		inline unsigned int getNumInstances()const { return m_numInstances; }
+		inline unsigned int getNumNodes()const { return m_numNodes; }
+		inline unsigned int getNumDrawInstances()const { return m_numInstances * m_numNodes; }
+	private:
+		unsigned int m_texture = 0;
+		unsigned int m_ssbo = 0;
+		unsigned int m_numNodes = 0;
+		unsigned int m_numFrames = 0;
+		float m_frameRate = 0.0f;
+		unsigned int m_numInstances = 0;
+	};
+}
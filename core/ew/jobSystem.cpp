@@ -0,0 +1,247 @@
+#include "jobSystem.h"
+
+namespace ew {
+	//Which system and deque the current thread belongs to. Threads that aren't workers use deque 0.
+	static thread_local const JobSystem* t_jobSystem = nullptr;
+	static thread_local unsigned int t_threadIndex = 0;
+
+	JobSystem::JobSystem(unsigned int numThreads, unsigned int queueCapacity)
+	{
+		if (numThreads == 0) {
+			numThreads = std::thread::hardware_concurrency();
+			if (numThreads < 2) {
+				numThreads = 2;
+			}
+		}
+		if (queueCapacity == 0) {
+			queueCapacity = 1;
+		}
+		for (unsigned int i = 0; i < numThreads; i++)
+		{
+			m_queues.emplace_back(new Queue());
+			m_queues.back()->jobs.resize(queueCapacity);
+		}
+		for (unsigned int i = 1; i < numThreads; i++)
+		{
+			m_threads.emplace_back(&JobSystem::workerLoop, this, i);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		for (size_t i = 0; i < m_threads.size(); i++)
+		{
+			m_threads[i].join();
+		}
+	}
+
+	unsigned int JobSystem::getThreadIndex()const
+	{
+		return t_jobSystem == this ? t_threadIndex : 0;
+	}
+
+	bool JobSystem::push(unsigned int thread, const Job& job, bool atFront)
+	{
+		Queue& queue = *m_queues[thread];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			size_t capacity = queue.jobs.size();
+			if (queue.count == capacity) {
+				return false;
+			}
+			if (atFront) {
+				queue.head = (queue.head + capacity - 1) % capacity;
+				queue.jobs[queue.head] = job;
+			}
+			else {
+				queue.jobs[(queue.head + queue.count) % capacity] = job;
+			}
+			queue.count++;
+		}
+		m_numQueued.fetch_add(1);
+		//Either this sees the worker going to sleep or the worker sees the job
+		if (m_numSleeping.load() > 0) {
+			{
+				std::lock_guard<std::mutex> lock(m_sleepMutex);
+			}
+			m_wake.notify_one();
+		}
+		return true;
+	}
+
+	bool JobSystem::pop(unsigned int thread, Job* job)
+	{
+		Queue& queue = *m_queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.count == 0) {
+			return false;
+		}
+		queue.count--;
+		*job = queue.jobs[(queue.head + queue.count) % queue.jobs.size()];
+		m_numQueued.fetch_sub(1);
+		return true;
+	}
+
+	bool JobSystem::steal(unsigned int thread, Job* job)
+	{
+		unsigned int numQueues = (unsigned int)m_queues.size();
+		for (unsigned int i = 1; i < numQueues; i++)
+		{
+			Queue& queue = *m_queues[(thread + i) % numQueues];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.count == 0) {
+				continue;
+			}
+			*job = queue.jobs[queue.head];
+			queue.head = (queue.head + 1) % queue.jobs.size();
+			queue.count--;
+			m_numQueued.fetch_sub(1);
+			return true;
+		}
+		return false;
+	}
+
+	bool JobSystem::runOne(unsigned int thread)
+	{
+		Job job;
+		if (!pop(thread, &job) && !steal(thread, &job)) {
+			return false;
+		}
+		//Not ready yet. Put it behind everything else so the jobs it waits on get a turn.
+		if (job.dependency != nullptr && !job.dependency->isDone()) {
+			if (!push(thread, job, true)) {
+				wait(*job.dependency);
+				execute(job);
+				return true;
+			}
+			return false;
+		}
+		execute(job);
+		return true;
+	}
+
+	void JobSystem::execute(Job& job)
+	{
+		job.function(job.data, job.begin, job.end);
+		if (job.counter != nullptr) {
+			job.counter->m_count.fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+	void JobSystem::submit(const Job& job)
+	{
+		if (job.counter != nullptr) {
+			job.counter->m_count.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (!push(getThreadIndex(), job, false)) {
+			Job inlineJob = job;
+			if (inlineJob.dependency != nullptr) {
+				wait(*inlineJob.dependency);
+			}
+			execute(inlineJob);
+		}
+	}
+
+	void JobSystem::submitBackground(std::function<void()> task)
+	{
+		//Nothing else would ever run it
+		if (m_threads.empty()) {
+			task();
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_backgroundMutex);
+			m_background.push_back(std::move(task));
+			m_numBackground.fetch_add(1);
+		}
+		if (m_numSleeping.load() > 0) {
+			{
+				std::lock_guard<std::mutex> lock(m_sleepMutex);
+			}
+			m_wake.notify_one();
+		}
+	}
+
+	bool JobSystem::runBackground()
+	{
+		std::function<void()> task;
+		{
+			std::lock_guard<std::mutex> lock(m_backgroundMutex);
+			if (m_background.empty()) {
+				return false;
+			}
+			task = std::move(m_background.front());
+			m_background.pop_front();
+			m_numBackground.fetch_sub(1);
+		}
+		task();
+		return true;
+	}
+
+	void JobSystem::wait(const JobCounter& counter)
+	{
+		unsigned int thread = getThreadIndex();
+		while (!counter.isDone()) {
+			if (!runOne(thread)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::parallelFor(unsigned int count, unsigned int grainSize, void(*function)(void* data, unsigned int begin, unsigned int end), void* data)
+	{
+		if (count == 0) {
+			return;
+		}
+		if (grainSize == 0) {
+			grainSize = 1;
+		}
+		//One range needs no other thread
+		if (count <= grainSize || m_queues.size() == 1) {
+			function(data, 0, count);
+			return;
+		}
+		JobCounter counter;
+		Job job;
+		job.function = function;
+		job.data = data;
+		job.counter = &counter;
+		//The first range is kept for this thread. The rest go on its deque for the others to steal.
+		for (unsigned int begin = grainSize; begin < count; begin += grainSize)
+		{
+			job.begin = begin;
+			job.end = count - begin < grainSize ? count : begin + grainSize;
+			submit(job);
+		}
+		function(data, 0, grainSize);
+		wait(counter);
+	}
+
+	void JobSystem::workerLoop(unsigned int thread)
+	{
+		t_jobSystem = this;
+		t_threadIndex = thread;
+		while (true) {
+			if (runOne(thread) || runBackground()) {
+				continue;
+			}
+			//Jobs held back by a dependency stay queued, so workers keep checking them rather than sleeping
+			if (m_numQueued.load() > 0) {
+				std::this_thread::yield();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_numSleeping.fetch_add(1);
+			m_wake.wait(lock, [this] { return m_stopping || m_numQueued.load() > 0 || m_numBackground.load() > 0; });
+			m_numSleeping.fetch_sub(1);
+			if (m_stopping && m_numQueued.load() == 0 && m_numBackground.load() == 0) {
+				return;
+			}
+		}
+	}
+}
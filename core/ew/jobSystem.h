@@ -0,0 +1,113 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <deque>
+
+namespace ew {
+	//Counts jobs that haven't finished. Jobs submitted with a counter add one to it and take it away when they
+	//finish, so a job can wait on a counter for the jobs it depends on. A counter at zero is done, so submit the
+	//jobs it counts before the jobs that depend on it.
+	class JobCounter {
+	public:
+		inline bool isDone()const { return m_count.load(std::memory_order_acquire) == 0; }
+	private:
+		friend class JobSystem;
+		std::atomic<int> m_count{ 0 };
+	};
+
+	//A function and its data rather than a std::function, so submitting never allocates
+	struct Job {
+		void (*function)(void* data, unsigned int begin, unsigned int end) = nullptr;
+		void* data = nullptr;
+		unsigned int begin = 0;
+		unsigned int end = 0;
+		JobCounter* counter = nullptr; //Signalled when the job finishes
+		const JobCounter* dependency = nullptr; //Must be done before the job starts
+	};
+
+	//Work stealing job system. Every thread, the one that created the system included, owns a deque of jobs. Owners
+	//push and pop at the back, so the jobs they split off last run first while their data is still in cache, and
+	//idle threads steal from the front of others' deques, taking the oldest and usually largest pieces of work.
+	//Deques are fixed size rings allocated up front. When one is full the job runs on the spot.
+	//submit(), wait() and parallelFor() may be called from the creating thread and from inside jobs.
+	//Long running work such as loading files goes through submitBackground() instead, so it never lands in a wait().
+	class JobSystem {
+	public:
+		//numThreads counts the creating thread. 0 uses one thread per hardware thread, and at least one worker so
+		//background tasks stay off the creating thread.
+		JobSystem(unsigned int numThreads = 0, unsigned int queueCapacity = 4096);
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		void submit(const Job& job);
+		//Runs other jobs until counter is done
+		void wait(const JobCounter& counter);
+		//Runs function over [0, count) in ranges of up to grainSize and returns once all have finished
+		void parallelFor(unsigned int count, unsigned int grainSize, void (*function)(void* data, unsigned int begin, unsigned int end), void* data);
+		//fn(begin, end). fn is called in place, not copied.
+		template<typename Fn>
+		void parallelFor(unsigned int count, unsigned int grainSize, const Fn& fn);
+		//fn(i) for every i in [0, count), an index per job, for loops whose iterations are already coarse
+		template<typename Fn>
+		void parallelForEach(unsigned int count, const Fn& fn);
+		//Runs task on a worker once it has no jobs to run. The task may use parallelFor. wait() never picks
+		//background tasks up, so a frame waiting on its jobs can't get stuck behind a load. Tasks are FIFO and all
+		//run before the system is destroyed. Allocates, so keep it out of per-frame code.
+		void submitBackground(std::function<void()> task);
+		inline unsigned int getNumThreads()const { return (unsigned int)m_queues.size(); }
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::vector<Job> jobs;
+			size_t head = 0; //Front of the deque in the ring
+			size_t count = 0;
+		};
+		template<typename Fn>
+		static void invokeRange(void* data, unsigned int begin, unsigned int end) { (*(const Fn*)data)(begin, end); }
+
+		unsigned int getThreadIndex()const;
+		//Returns false if the deque is full
+		bool push(unsigned int thread, const Job& job, bool atFront);
+		bool pop(unsigned int thread, Job* job);
+		bool steal(unsigned int thread, Job* job);
+		//Runs one job from this thread's deque or another's. Returns false if there were none ready.
+		bool runOne(unsigned int thread);
+		bool runBackground();
+		void execute(Job& job);
+		void workerLoop(unsigned int thread);
+
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_threads;
+		std::atomic<int> m_numQueued{ 0 };
+		std::atomic<int> m_numSleeping{ 0 };
+		std::mutex m_backgroundMutex;
+		std::deque<std::function<void()>> m_background;
+		std::atomic<int> m_numBackground{ 0 };
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wake;
+		bool m_stopping = false;
+	};
+
+	template<typename Fn>
+	void JobSystem::parallelFor(unsigned int count, unsigned int grainSize, const Fn& fn)
+	{
+		parallelFor(count, grainSize, &JobSystem::invokeRange<Fn>, (void*)&fn);
+	}
+
+	template<typename Fn>
+	void JobSystem::parallelForEach(unsigned int count, const Fn& fn)
+	{
+		parallelFor(count, 1, [&fn](unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; i++)
+			{
+				fn(i);
+			}
+		});
+	}
+}
@@ -0,0 +1,120 @@
+#include "lightBuffer.h"
+#include "clusterGrid.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	//std430 header in front of the light array. The array is 16 byte aligned because PointLight contains a vec4.
+	struct LightBufferHeader {
+		int count;
+		int padding[3];
+	};
+
+	/// <summary>
+	/// Allocates and persistently maps storage for NUM_REGIONS frames of lights
+	/// </summary>
+	/// <param name="capacity">Max number of lights per frame</param>
+	LightBuffer::LightBuffer(unsigned int capacity)
+	{
+		m_capacity = capacity;
+		int alignment = 1;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		unsigned int size = sizeof(LightBufferHeader) + sizeof(PointLight) * capacity;
+		m_regionSize = ((size + alignment - 1) / alignment) * alignment;
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &m_ssbo);
+		glNamedBufferStorage(m_ssbo, (GLsizeiptr)m_regionSize * NUM_REGIONS, NULL, flags);
+		m_mapped = (unsigned char*)glMapNamedBufferRange(m_ssbo, 0, (GLsizeiptr)m_regionSize * NUM_REGIONS, flags);
+		if (m_mapped == NULL) {
+			printf("Failed to map light buffer");
+		}
+	}
+	LightBuffer::~LightBuffer()
+	{
+		for (unsigned int i = 0; i < NUM_REGIONS; i++)
+		{
+			if (m_fences[i] != nullptr) {
+				glDeleteSync((GLsync)m_fences[i]);
+			}
+		}
+		if (m_mapped != nullptr) {
+			glUnmapNamedBuffer(m_ssbo);
+		}
+		glDeleteBuffers(1, &m_ssbo);
+	}
+	/// <summary>
+	/// Blocks until the GPU has finished the draws that read a region
+	/// </summary>
+	void LightBuffer::waitForRegion(unsigned int region)
+	{
+		GLsync fence = (GLsync)m_fences[region];
+		if (fence == nullptr) {
+			return;
+		}
+		while (true) {
+			GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+				break;
+			}
+		}
+		glDeleteSync(fence);
+		m_fences[region] = nullptr;
+	}
+	void LightBuffer::upload(const PointLight* lights, unsigned int count)
+	{
+		if (m_mapped == nullptr) {
+			return;
+		}
+		waitForRegion(m_region);
+		m_count = count < m_capacity ? count : m_capacity;
+		unsigned char* dst = m_mapped + (size_t)m_region * m_regionSize;
+		LightBufferHeader header = {};
+		header.count = (int)m_count;
+		memcpy(dst, &header, sizeof(header));
+		memcpy(dst + sizeof(header), lights, sizeof(PointLight) * m_count);
+	}
+	void LightBuffer::bind(unsigned int bindingIndex) const
+	{
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingIndex, m_ssbo, (GLintptr)m_region * m_regionSize, m_regionSize);
+	}
+	void LightBuffer::endFrame()
+	{
+		if (m_fences[m_region] != nullptr) {
+			glDeleteSync((GLsync)m_fences[m_region]);
+		}
+		m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_region = (m_region + 1) % NUM_REGIONS;
+	}
+
+	ClusterBuffer::ClusterBuffer()
+	{
+		glCreateBuffers(1, &m_clusterSSBO);
+		glCreateBuffers(1, &m_indexSSBO);
+	}
+	ClusterBuffer::~ClusterBuffer()
+	{
+		glDeleteBuffers(1, &m_clusterSSBO);
+		glDeleteBuffers(1, &m_indexSSBO);
+	}
+	void ClusterBuffer::upload(const ClusterGrid& grid)
+	{
+		const std::vector<ClusterRange>& clusters = grid.getClusters();
+		const std::vector<unsigned int>& indices = grid.getLightIndices();
+		glNamedBufferData(m_clusterSSBO, sizeof(ClusterRange) * clusters.size(), clusters.data(), GL_STREAM_DRAW);
+		//Never allocate an empty buffer, binding it would fail
+		unsigned int dummyIndex = 0;
+		if (indices.empty()) {
+			glNamedBufferData(m_indexSSBO, sizeof(unsigned int), &dummyIndex, GL_STREAM_DRAW);
+		}
+		else {
+			glNamedBufferData(m_indexSSBO, sizeof(unsigned int) * indices.size(), indices.data(), GL_STREAM_DRAW);
+		}
+	}
+	void ClusterBuffer::bind(unsigned int clusterBindingIndex, unsigned int indexBindingIndex) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, clusterBindingIndex, m_clusterSSBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, indexBindingIndex, m_indexSSBO);
+	}
+}
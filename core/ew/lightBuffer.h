@@ -0,0 +1,60 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace ew {
+	class ClusterGrid;
+
+	//Matches the std430 layout of PointLight in the shader (32 bytes)
+	struct PointLight {
+		glm::vec3 position;
+		float radius;
+		glm::vec4 color;
+	};
+
+	//Shader storage buffer of point lights.
+	//Persistently mapped and split into 3 regions so the CPU can write one frame while the GPU reads the others.
+	class LightBuffer {
+	public:
+		static const unsigned int NUM_REGIONS = 3;
+
+		LightBuffer(unsigned int capacity);
+		~LightBuffer();
+		LightBuffer(const LightBuffer&) = delete;
+		LightBuffer& operator=(const LightBuffer&) = delete;
+
+		//Writes lights into this frame's region. Lights past capacity are dropped.
+		void upload(const PointLight* lights, unsigned int count);
+		//Binds this frame's region to a shader storage binding point
+		void bind(unsigned int bindingIndex)const;
+		//Call once the draws that read this frame's region have been submitted
+		void endFrame();
+		inline unsigned int getCapacity()const { return m_capacity; }
+		inline unsigned int getCount()const { return m_count; }
+	private:
+		void waitForRegion(unsigned int region);
+
+		unsigned int m_ssbo = 0;
+		unsigned int m_capacity = 0;
+		unsigned int m_count = 0;
+		unsigned int m_regionSize = 0;
+		unsigned int m_region = 0;
+		unsigned char* m_mapped = nullptr;
+		void* m_fences[NUM_REGIONS] = {}; //GLsync per region
+	};
+
+	//Shader storage buffers holding a ClusterGrid's cluster ranges and light index list.
+	//Reallocated on every upload, since the index list changes size each frame.
+	class ClusterBuffer {
+	public:
+		ClusterBuffer();
+		~ClusterBuffer();
+		ClusterBuffer(const ClusterBuffer&) = delete;
+		ClusterBuffer& operator=(const ClusterBuffer&) = delete;
+
+		void upload(const ClusterGrid& grid);
+		void bind(unsigned int clusterBindingIndex, unsigned int indexBindingIndex)const;
+	private:
+		unsigned int m_clusterSSBO = 0;
+		unsigned int m_indexSSBO = 0;
+	};
+}
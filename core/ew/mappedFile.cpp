@@ -0,0 +1,96 @@
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ew {
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::open(const char* filePath)
+	{
+		close();
+		HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			CloseHandle(file);
+			return false;
+		}
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == NULL) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		m_file = file;
+		m_mapping = mapping;
+		m_data = (const unsigned char*)data;
+		m_size = (size_t)size.QuadPart;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data != nullptr) {
+			UnmapViewOfFile(m_data);
+			CloseHandle((HANDLE)m_mapping);
+			CloseHandle((HANDLE)m_file);
+		}
+		m_data = nullptr;
+		m_size = 0;
+		m_mapping = nullptr;
+		m_file = nullptr;
+	}
+#else
+	bool MappedFile::open(const char* filePath)
+	{
+		close();
+		int fd = ::open(filePath, O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		//The mapping keeps its own reference to the file
+		::close(fd);
+		if (data == MAP_FAILED) {
+			return false;
+		}
+		m_data = (const unsigned char*)data;
+		m_size = (size_t)st.st_size;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data != nullptr) {
+			munmap((void*)m_data, m_size);
+		}
+		m_data = nullptr;
+		m_size = 0;
+	}
+#endif
+}
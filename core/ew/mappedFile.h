@@ -0,0 +1,26 @@
+#pragma once
+#include <stddef.h>
+
+namespace ew {
+	//Read only memory mapping of a whole file. Unmapped on close or destruction.
+	class MappedFile {
+	public:
+		MappedFile() {};
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		//Returns false if the file does not exist or is empty
+		bool open(const char* filePath);
+		void close();
+		inline const unsigned char* getData()const { return m_data; }
+		inline size_t getSize()const { return m_size; }
+	private:
+		const unsigned char* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+}
@@ -9,62 +9,157 @@
 #include "external/glad.h"
 
 namespace ew {
-	Mesh::Mesh(const MeshData& meshData)
+	static IndexBufferStats s_indexBufferStats;
+
+	IndexBufferStats getIndexBufferStats()
 	{
-		load(meshData);
+		return s_indexBufferStats;
 	}
-	void Mesh::load(const MeshData& meshData)
-	{
-		if (!m_initialized) {
-			glGenVertexArrays(1, &m_vao);
-			glBindVertexArray(m_vao);
 
-			glGenBuffers(1, &m_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	static constexpr GLenum toGLType(AttributeType type)
+	{
+		return type == AttributeType::HALF_FLOAT ? GL_HALF_FLOAT
+			: type == AttributeType::SHORT ? GL_SHORT
+			: type == AttributeType::UNSIGNED_SHORT ? GL_UNSIGNED_SHORT
+			: GL_FLOAT;
+	}
 
-			glGenBuffers(1, &m_ebo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-			//Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
-			glEnableVertexAttribArray(0);
+	//One attribute per instantiation, so every argument is a compile time constant
+	template<class Layout, int I, bool Done = (I >= Layout::NUM_ATTRIBUTES)>
+	struct AttributeSetup {
+		static void run(unsigned int vao) {
+			constexpr VertexAttribute attribute = Layout::ATTRIBUTES[I];
+			constexpr GLenum type = toGLType(attribute.type);
+			glEnableVertexArrayAttrib(vao, attribute.location);
+			glVertexArrayAttribFormat(vao, attribute.location, attribute.components, type,
+				attribute.normalized ? GL_TRUE : GL_FALSE, attribute.offset);
+			glVertexArrayAttribBinding(vao, attribute.location, 0);
+			AttributeSetup<Layout, I + 1>::run(vao);
+		}
+	};
+	template<class Layout, int I>
+	struct AttributeSetup<Layout, I, true> {
+		static void run(unsigned int) {}
+	};
 
-			//Normal attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
-			glEnableVertexAttribArray(1);
+	template<class Layout>
+	void setupVertexArray(unsigned int vao)
+	{
+		AttributeSetup<Layout, 0>::run(vao);
+	}
+	template void setupVertexArray<StandardLayout>(unsigned int vao);
+	template void setupVertexArray<CompactLayout>(unsigned int vao);
 
-			//UV attribute
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-			glEnableVertexAttribArray(2);
+	void MeshBase::upload(const void* vertices, unsigned int numVertices, unsigned int vertexSize,
+		VertexArraySetup setupAttributes,
+		const void* indices, unsigned int numIndices, IndexType indexType, const LodLevel* lods, unsigned int numLods)
+	{
+		if (m_initialized) {
+			//Reloading, take the old buffer out of the totals
+			s_indexBufferStats.numMeshes--;
+			s_indexBufferStats.num16BitMeshes -= m_indexType == IndexType::UINT16 ? 1 : 0;
+			s_indexBufferStats.bytes -= getIndexBytes();
+			s_indexBufferStats.bytesSaved -= getIndexBytesSaved();
+		}
+		else {
+			glCreateVertexArrays(1, &m_vao);
+			glCreateBuffers(1, &m_vbo);
+			glCreateBuffers(1, &m_ebo);
+			setupAttributes(m_vao);
+			glVertexArrayVertexBuffer(m_vao, 0, m_vbo, 0, vertexSize);
+			glVertexArrayElementBuffer(m_vao, m_ebo);
 
 			m_initialized = true;
 		}
 
-		glBindVertexArray(m_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-
-		if (meshData.vertices.size() > 0) {
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+		if (numVertices > 0) {
+			glNamedBufferData(m_vbo, (GLsizeiptr)vertexSize * numVertices, vertices, GL_STATIC_DRAW);
 		}
-		if (meshData.indices.size() > 0) {
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+		if (numIndices > 0) {
+			size_t indexSize = indexType == IndexType::UINT16 ? sizeof(uint16_t) : sizeof(unsigned int);
+			glNamedBufferData(m_ebo, indexSize * numIndices, indices, GL_STATIC_DRAW);
 		}
-		m_numVertices = meshData.vertices.size();
-		m_numIndices = meshData.indices.size();
+		m_numVertices = numVertices;
+		m_numIndices = numIndices;
+		m_indexType = indexType;
 
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		s_indexBufferStats.numMeshes++;
+		s_indexBufferStats.num16BitMeshes += m_indexType == IndexType::UINT16 ? 1 : 0;
+		s_indexBufferStats.bytes += getIndexBytes();
+		s_indexBufferStats.bytesSaved += getIndexBytesSaved();
+
+		m_lods.assign(lods, lods + numLods);
+		if (m_lods.empty()) {
+			LodLevel lod;
+			lod.indexCount = m_numIndices;
+			m_lods.push_back(lod);
+		}
+	}
+	void MeshBase::draw(ew::DrawMode drawMode) const
+	{
+		drawLod(0, drawMode);
 	}
-	void Mesh::draw(ew::DrawMode drawMode) const
+	void MeshBase::draw(const Camera& camera, const glm::mat4& modelMatrix, float maxScreenError, DrawMode drawMode) const
+	{
+		drawLod(selectLod(camera, modelMatrix, maxScreenError), drawMode);
+	}
+	void MeshBase::drawLod(int lod, DrawMode drawMode) const
 	{
 		glBindVertexArray(m_vao);
 		if (drawMode == DrawMode::TRIANGLES) {
-			glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
+			const LodLevel& level = m_lods[lod];
+			if (m_indexType == IndexType::UINT16) {
+				glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_SHORT, (const void*)(sizeof(uint16_t) * level.indexOffset));
+			}
+			else {
+				glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (const void*)(sizeof(unsigned int) * level.indexOffset));
+			}
 		}
 		else {
 			glDrawArrays(GL_POINTS, 0, m_numVertices);
 		}
 		
 	}
+	void MeshBase::drawInstanced(unsigned int instanceCount, int lod) const
+	{
+		if (instanceCount == 0) {
+			return;
+		}
+		glBindVertexArray(m_vao);
+		const LodLevel& level = m_lods[lod];
+		if (m_indexType == IndexType::UINT16) {
+			glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_SHORT, (const void*)(sizeof(uint16_t) * level.indexOffset), instanceCount);
+		}
+		else {
+			glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (const void*)(sizeof(unsigned int) * level.indexOffset), instanceCount);
+		}
+	}
+	int MeshBase::selectLod(const Camera& camera, const glm::mat4& modelMatrix, float maxScreenError) const
+	{
+		if (m_lods.size() < 2) {
+			return 0;
+		}
+		//Largest axis scale, so the error and radius stay conservative under non uniform scale
+		float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+			glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+		//Height of the view at the closest point of the bounding sphere
+		float viewHeight = camera.orthoHeight;
+		if (!camera.orthographic) {
+			glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(m_boundsCenter, 1.0f));
+			float distance = glm::length(center - camera.position) - m_boundsRadius * scale;
+			distance = glm::max(distance, camera.nearPlane);
+			viewHeight = 2.0f * distance * glm::tan(glm::radians(camera.fov) * 0.5f);
+		}
+
+		int lod = 0;
+		for (int i = 1; i < (int)m_lods.size(); i++)
+		{
+			if (m_lods[i].error * scale > maxScreenError * viewHeight) {
+				break;
+			}
+			lod = i;
+		}
+		return lod;
+	}
 }
\ No newline at end of file
@@ -5,38 +5,142 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <vector>
+#include "camera.h"
+#include "vertexLayout.h"
+#include "indexData.h"
 
 namespace ew {
-	struct Vertex {
-		glm::vec3 pos;
-		glm::vec3 normal;
-		glm::vec2 uv;
+	//A range of the index buffer drawing the mesh at one level of detail
+	struct LodLevel {
+		unsigned int indexOffset = 0;
+		unsigned int indexCount = 0;
+		float error = 0.0f; //Largest distance from the full detail surface, in mesh units
 	};
 
-	struct MeshData {
-		std::vector<Vertex> vertices;
-		std::vector<unsigned int> indices;
+	template<class VertexType>
+	struct BasicMeshData {
+		std::vector<VertexType> vertices;
+		IndexData indices; //uint16 whenever the vertex count allows it
+		std::vector<LodLevel> lods; //Empty if indices is a single level
 	};
+	typedef BasicMeshData<Vertex> MeshData;
+
+	//Converts full precision mesh data to the vertex format of a layout
+	template<class Layout>
+	BasicMeshData<typename Layout::VertexType> encodeMeshData(const MeshData& meshData) {
+		BasicMeshData<typename Layout::VertexType> encoded;
+		encoded.vertices.reserve(meshData.vertices.size());
+		for (size_t i = 0; i < meshData.vertices.size(); i++)
+		{
+			encoded.vertices.push_back(Layout::encode(meshData.vertices[i]));
+		}
+		encoded.indices = meshData.indices;
+		encoded.lods = meshData.lods;
+		return encoded;
+	}
+
+	//Formats vao's attributes from Layout::ATTRIBUTES, all reading vertex buffer binding 0. Unrolled at compile time,
+	//and instantiated in mesh.cpp for each layout.
+	template<class Layout>
+	void setupVertexArray(unsigned int vao);
+	typedef void (*VertexArraySetup)(unsigned int vao);
+
+	//Totals over every mesh uploaded so far
+	struct IndexBufferStats {
+		unsigned int numMeshes = 0;
+		unsigned int num16BitMeshes = 0;
+		size_t bytes = 0;
+		size_t bytesSaved = 0; //Compared to uploading every index as uint32
+	};
+	IndexBufferStats getIndexBufferStats();
 
 	enum class DrawMode {
 		TRIANGLES = 0,
 		POINTS = 1
 	};
 
-	class Mesh {
+	//GL buffers and drawing, shared by every vertex layout
+	class MeshBase {
 	public:
-		Mesh() {};
-		Mesh(const MeshData& meshData);
-		void load(const MeshData& meshData);
 		void draw(DrawMode drawMode = DrawMode::TRIANGLES)const;
+		//Draws the level picked by selectLod
+		void draw(const Camera& camera, const glm::mat4& modelMatrix, float maxScreenError = 0.001f, DrawMode drawMode = DrawMode::TRIANGLES)const;
+		void drawLod(int lod, DrawMode drawMode = DrawMode::TRIANGLES)const;
+		//One draw of instanceCount copies of a level, told apart in the shader by gl_InstanceID
+		void drawInstanced(unsigned int instanceCount, int lod = 0)const;
+		//Coarsest level whose error, projected to the screen, is at most maxScreenError (a fraction of the screen height)
+		int selectLod(const Camera& camera, const glm::mat4& modelMatrix, float maxScreenError = 0.001f)const;
 		inline int getNumVertices()const { return m_numVertices; }
 		inline int getNumIndices()const { return m_numIndices; }
-	private:
+		inline int getNumLods()const { return (int)m_lods.size(); }
+		inline IndexType getIndexType()const { return m_indexType; }
+		inline size_t getIndexBytes()const { return (size_t)m_numIndices * (m_indexType == IndexType::UINT16 ? 2 : 4); }
+		inline size_t getIndexBytesSaved()const { return m_indexType == IndexType::UINT16 ? (size_t)m_numIndices * 2 : 0; }
+		inline const LodLevel& getLod(int lod)const { return m_lods[lod]; }
+	protected:
+		//Creates the VAO on first use, then replaces the buffer contents
+		void upload(const void* vertices, unsigned int numVertices, unsigned int vertexSize,
+			VertexArraySetup setupAttributes,
+			const void* indices, unsigned int numIndices, IndexType indexType, const LodLevel* lods, unsigned int numLods);
 		bool m_initialized = false;
 		unsigned int m_vao = 0;
 		unsigned int m_vbo = 0;
 		unsigned int m_ebo = 0;
 		unsigned int m_numVertices = 0;
 		unsigned int m_numIndices = 0;
+		IndexType m_indexType = IndexType::UINT32;
+		std::vector<LodLevel> m_lods;
+		glm::vec3 m_boundsCenter = glm::vec3(0);
+		float m_boundsRadius = 0.0f;
 	};
+
+	//A mesh whose vertex buffer is stored in Layout::VertexType. Attribute setup is unrolled from Layout::ATTRIBUTES.
+	template<class Layout>
+	class BasicMesh : public MeshBase {
+	public:
+		typedef typename Layout::VertexType VertexType;
+		BasicMesh() {};
+		BasicMesh(const BasicMeshData<VertexType>& meshData) { load(meshData); }
+		//Full precision data, encoded to the layout first
+		template<class OtherVertex>
+		BasicMesh(const BasicMeshData<OtherVertex>& meshData) { load(meshData); }
+
+		void load(const BasicMeshData<VertexType>& meshData) {
+			load(meshData.vertices.data(), (unsigned int)meshData.vertices.size(),
+				meshData.indices.data(), (unsigned int)meshData.indices.size(), meshData.indices.getType(),
+				meshData.lods.data(), (unsigned int)meshData.lods.size());
+		}
+		//Uploads straight from memory already in the layout's format, such as a mapped cooked model
+		void load(const VertexType* vertices, unsigned int numVertices, const void* indices, unsigned int numIndices,
+			IndexType indexType, const LodLevel* lods, unsigned int numLods) {
+			upload(vertices, numVertices, sizeof(VertexType), &setupVertexArray<Layout>,
+				indices, numIndices, indexType, lods, numLods);
+			computeBounds(vertices, numVertices);
+		}
+		template<class OtherVertex>
+		void load(const BasicMeshData<OtherVertex>& meshData) {
+			load(encodeMeshData<Layout>(meshData));
+		}
+	private:
+		//Bounding sphere around the center of the AABB
+		void computeBounds(const VertexType* vertices, unsigned int numVertices) {
+			glm::vec3 minPos = glm::vec3(0);
+			glm::vec3 maxPos = glm::vec3(0);
+			for (unsigned int i = 0; i < numVertices; i++)
+			{
+				glm::vec3 pos = Layout::decodePosition(vertices[i]);
+				minPos = i == 0 ? pos : glm::min(minPos, pos);
+				maxPos = i == 0 ? pos : glm::max(maxPos, pos);
+			}
+			m_boundsCenter = (minPos + maxPos) * 0.5f;
+			m_boundsRadius = 0.0f;
+			for (unsigned int i = 0; i < numVertices; i++)
+			{
+				m_boundsRadius = glm::max(m_boundsRadius, glm::length(Layout::decodePosition(vertices[i]) - m_boundsCenter));
+			}
+		}
+	};
+
+	typedef BasicMesh<StandardLayout> Mesh;
+	typedef BasicMesh<CompactLayout> CompactMesh;
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "meshCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace ew {
+	static const char COOKED_MAGIC[4] = { 'E', 'W', 'M', 'C' };
+	static const uint32_t COOKED_VERSION = 1;
+
+	struct CookedFileHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceMtime;
+		uint64_t sourceSize;
+		uint64_t hash;
+		uint32_t numMeshes;
+		uint32_t tableOffset;
+	};
+
+	struct CookedMeshEntry {
+		uint32_t numVertices;
+		uint32_t vertexSize;
+		uint32_t numIndices;
+		uint32_t indexType;
+		uint32_t numLods;
+		uint32_t hasReport;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t lodOffset;
+		MeshOptimizationReport report;
+	};
+
+	static inline uint64_t alignBlob(uint64_t offset) {
+		return (offset + 15) & ~(uint64_t)15;
+	}
+
+	static inline size_t getIndexSize(IndexType type) {
+		return type == IndexType::UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+
+	uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	bool getSourceFileInfo(const std::string& sourcePath, MeshCacheKey* key)
+	{
+		struct stat st;
+		if (stat(sourcePath.c_str(), &st) != 0) {
+			return false;
+		}
+		key->sourceMtime = (uint64_t)st.st_mtime;
+		key->sourceSize = (uint64_t)st.st_size;
+		return true;
+	}
+
+	std::string getCookedPath(const std::string& sourcePath, const MeshCacheKey& key)
+	{
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%016llx.ewmesh", (unsigned long long)key.hash);
+		return sourcePath + suffix;
+	}
+
+	bool CookedModelFile::open(const std::string& cookedPath, const MeshCacheKey& key)
+	{
+		m_meshes.clear();
+		if (!m_file.open(cookedPath.c_str())) {
+			return false;
+		}
+		const unsigned char* data = m_file.getData();
+		uint64_t size = m_file.getSize();
+
+		CookedFileHeader header;
+		if (size < sizeof(header)) {
+			m_file.close();
+			return false;
+		}
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC)) != 0 || header.version != COOKED_VERSION
+			|| header.sourceMtime != key.sourceMtime || header.sourceSize != key.sourceSize || header.hash != key.hash
+			|| header.tableOffset + (uint64_t)header.numMeshes * sizeof(CookedMeshEntry) > size) {
+			m_file.close();
+			return false;
+		}
+
+		for (uint32_t i = 0; i < header.numMeshes; i++)
+		{
+			CookedMeshEntry entry;
+			memcpy(&entry, data + header.tableOffset + i * sizeof(CookedMeshEntry), sizeof(entry));
+			IndexType indexType = entry.indexType == (uint32_t)IndexType::UINT16 ? IndexType::UINT16 : IndexType::UINT32;
+			if (entry.vertexOffset + (uint64_t)entry.numVertices * entry.vertexSize > size
+				|| entry.indexOffset + (uint64_t)entry.numIndices * getIndexSize(indexType) > size
+				|| entry.lodOffset + (uint64_t)entry.numLods * sizeof(LodLevel) > size) {
+				printf("Cooked model %s is truncated\n", cookedPath.c_str());
+				m_meshes.clear();
+				m_file.close();
+				return false;
+			}
+			CookedMesh mesh;
+			mesh.vertices = data + entry.vertexOffset;
+			mesh.numVertices = entry.numVertices;
+			mesh.vertexSize = entry.vertexSize;
+			mesh.indices = data + entry.indexOffset;
+			mesh.numIndices = entry.numIndices;
+			mesh.indexType = indexType;
+			mesh.lods = (const LodLevel*)(data + entry.lodOffset);
+			mesh.numLods = entry.numLods;
+			mesh.hasReport = entry.hasReport != 0;
+			mesh.report = entry.report;
+			m_meshes.push_back(mesh);
+		}
+		return true;
+	}
+
+	bool writeCookedModel(const std::string& cookedPath, const MeshCacheKey& key, const std::vector<CookedMesh>& meshes)
+	{
+		CookedFileHeader header;
+		memcpy(header.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC));
+		header.version = COOKED_VERSION;
+		header.sourceMtime = key.sourceMtime;
+		header.sourceSize = key.sourceSize;
+		header.hash = key.hash;
+		header.numMeshes = (uint32_t)meshes.size();
+		header.tableOffset = (uint32_t)alignBlob(sizeof(header));
+
+		//Lay out the blobs after the table
+		std::vector<CookedMeshEntry> entries(meshes.size());
+		uint64_t offset = alignBlob(header.tableOffset + meshes.size() * sizeof(CookedMeshEntry));
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			const CookedMesh& mesh = meshes[i];
+			CookedMeshEntry& entry = entries[i];
+			entry.numVertices = mesh.numVertices;
+			entry.vertexSize = mesh.vertexSize;
+			entry.numIndices = mesh.numIndices;
+			entry.indexType = (uint32_t)mesh.indexType;
+			entry.numLods = mesh.numLods;
+			entry.hasReport = mesh.hasReport ? 1 : 0;
+			entry.report = mesh.report;
+			entry.vertexOffset = offset;
+			offset = alignBlob(offset + (uint64_t)mesh.numVertices * mesh.vertexSize);
+			entry.indexOffset = offset;
+			offset = alignBlob(offset + (uint64_t)mesh.numIndices * getIndexSize(mesh.indexType));
+			entry.lodOffset = offset;
+			offset = alignBlob(offset + (uint64_t)mesh.numLods * sizeof(LodLevel));
+		}
+
+		//Write to a temporary file first so a crash never leaves a half written cache entry behind
+		std::string tempPath = cookedPath + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write cooked model %s\n", cookedPath.c_str());
+			return false;
+		}
+		static const unsigned char padding[16] = {};
+		uint64_t written = 0;
+		bool ok = true;
+		auto writeAt = [&](uint64_t at, const void* data, size_t size) {
+			if (at > written) {
+				ok = ok && fwrite(padding, 1, (size_t)(at - written), file) == at - written;
+				written = at;
+			}
+			if (size > 0) {
+				ok = ok && fwrite(data, 1, size, file) == size;
+				written += size;
+			}
+		};
+		writeAt(0, &header, sizeof(header));
+		writeAt(header.tableOffset, entries.data(), entries.size() * sizeof(CookedMeshEntry));
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			const CookedMesh& mesh = meshes[i];
+			writeAt(entries[i].vertexOffset, mesh.vertices, (size_t)mesh.numVertices * mesh.vertexSize);
+			writeAt(entries[i].indexOffset, mesh.indices, mesh.numIndices * getIndexSize(mesh.indexType));
+			writeAt(entries[i].lodOffset, mesh.lods, mesh.numLods * sizeof(LodLevel));
+		}
+		writeAt(offset, NULL, 0);
+		ok = fclose(file) == 0 && ok;
+
+		remove(cookedPath.c_str());
+		if (!ok || rename(tempPath.c_str(), cookedPath.c_str()) != 0) {
+			printf("Failed to write cooked model %s\n", cookedPath.c_str());
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "mesh.h"
+#include "meshOptimizer.h"
+#include "mappedFile.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace ew {
+	//Everything that changes the cooked output. A cooked file is only used if all of it matches.
+	struct MeshCacheKey {
+		uint64_t sourceMtime = 0;
+		uint64_t sourceSize = 0;
+		uint64_t hash = 0; //Source path, import options and vertex layout
+	};
+
+	//One mesh as stored in a cooked file. Pointers point into the mapping, or into caller memory when writing.
+	struct CookedMesh {
+		const void* vertices = nullptr;
+		unsigned int numVertices = 0;
+		unsigned int vertexSize = 0;
+		const void* indices = nullptr;
+		unsigned int numIndices = 0;
+		IndexType indexType = IndexType::UINT32;
+		const LodLevel* lods = nullptr;
+		unsigned int numLods = 0;
+		bool hasReport = false;
+		MeshOptimizationReport report;
+	};
+
+	//File layout: header, mesh table, then 16 byte aligned vertex, index and LOD blobs
+	class CookedModelFile {
+	public:
+		//Maps the file and checks it against key. Returns false on a missing, stale or corrupt file.
+		bool open(const std::string& cookedPath, const MeshCacheKey& key);
+		inline size_t getNumMeshes()const { return m_meshes.size(); }
+		inline const CookedMesh& getMesh(size_t i)const { return m_meshes[i]; }
+	private:
+		MappedFile m_file;
+		std::vector<CookedMesh> m_meshes;
+	};
+
+	//Fills in the source file's mtime and size. Returns false if it cannot be read.
+	bool getSourceFileInfo(const std::string& sourcePath, MeshCacheKey* key);
+	//Where the cooked file for a key lives, next to the source
+	std::string getCookedPath(const std::string& sourcePath, const MeshCacheKey& key);
+	bool writeCookedModel(const std::string& cookedPath, const MeshCacheKey& key, const std::vector<CookedMesh>& meshes);
+
+	//FNV-1a, chain calls by passing the previous result as hash
+	uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+}
@@ -0,0 +1,294 @@
+#include "meshOptimizer.h"
+#include <algorithm>
+
+namespace ew {
+	/// <summary>
+	/// FIFO post-transform cache. A vertex is cached if fewer than cacheSize vertices were inserted after it.
+	/// </summary>
+	struct FifoCache {
+		std::vector<unsigned int> insertTime;
+		unsigned int time;
+		unsigned int size;
+
+		FifoCache(size_t numVertices, unsigned int cacheSize)
+			: insertTime(numVertices, 0), time(cacheSize + 1), size(cacheSize) {}
+		//Returns true on a miss
+		bool access(unsigned int v) {
+			if (time - insertTime[v] > size) {
+				insertTime[v] = time++;
+				return true;
+			}
+			return false;
+		}
+		void flush() {
+			time += size + 1;
+		}
+	};
+
+	VertexCacheStats analyzeVertexCache(const MeshData& mesh, unsigned int cacheSize)
+	{
+		VertexCacheStats stats;
+		size_t numTriangles = mesh.indices.size() / 3;
+		if (numTriangles == 0) {
+			return stats;
+		}
+		FifoCache cache(mesh.vertices.size(), cacheSize);
+		std::vector<bool> used(mesh.vertices.size(), false);
+		unsigned int misses = 0;
+		unsigned int uniqueVertices = 0;
+		for (size_t i = 0; i < numTriangles * 3; i++)
+		{
+			unsigned int v = mesh.indices[i];
+			if (cache.access(v)) {
+				misses++;
+			}
+			if (!used[v]) {
+				used[v] = true;
+				uniqueVertices++;
+			}
+		}
+		stats.acmr = (float)misses / numTriangles;
+		stats.atvr = (float)misses / uniqueVertices;
+		return stats;
+	}
+
+	/// <summary>
+	/// Tipsify, from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander et al. 2007).
+	/// Fans out around one vertex at a time, then moves to the neighbor most likely to still be in the cache.
+	/// </summary>
+	void optimizeVertexCache(MeshData* mesh, unsigned int cacheSize, std::vector<unsigned int>* clusterStarts)
+	{
+		std::vector<unsigned int> indices = mesh->indices.toVector();
+		unsigned int numVertices = (unsigned int)mesh->vertices.size();
+		unsigned int numTriangles = (unsigned int)(indices.size() / 3);
+		if (clusterStarts != nullptr) {
+			clusterStarts->clear();
+		}
+		if (numTriangles == 0) {
+			return;
+		}
+
+		//Triangles using each vertex, in compressed rows
+		std::vector<unsigned int> live(numVertices, 0);
+		for (unsigned int i = 0; i < numTriangles * 3; i++)
+		{
+			live[indices[i]]++;
+		}
+		std::vector<unsigned int> adjacencyOffsets(numVertices + 1, 0);
+		for (unsigned int v = 0; v < numVertices; v++)
+		{
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + live[v];
+		}
+		std::vector<unsigned int> adjacency(numTriangles * 3);
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned int t = 0; t < numTriangles; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				adjacency[fill[v]++] = t;
+			}
+		}
+
+		std::vector<unsigned int> cachingTime(numVertices, 0);
+		std::vector<bool> emitted(numTriangles, false);
+		std::vector<unsigned int> deadEnd;
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> output;
+		output.reserve(numTriangles * 3);
+		unsigned int time = cacheSize + 1;
+		unsigned int cursor = 0;
+		int fanning = indices[0];
+
+		if (clusterStarts != nullptr) {
+			clusterStarts->push_back(0);
+		}
+		while (fanning >= 0) {
+			candidates.clear();
+			for (unsigned int a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+			{
+				unsigned int t = adjacency[a];
+				if (emitted[t]) {
+					continue;
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					unsigned int v = indices[t * 3 + c];
+					output.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (time - cachingTime[v] > cacheSize) {
+						cachingTime[v] = time++;
+					}
+				}
+				emitted[t] = true;
+			}
+
+			//Prefer the candidate that has been in the cache longest and will stay there after its fan is emitted
+			int next = -1;
+			int bestPriority = -1;
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				unsigned int v = candidates[i];
+				if (live[v] == 0) {
+					continue;
+				}
+				int priority = 0;
+				if (time - cachingTime[v] + 2 * live[v] <= cacheSize) {
+					priority = time - cachingTime[v];
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = v;
+				}
+			}
+			if (next < 0) {
+				//Dead end, fall back to recently used vertices and then to input order. The cache is cold from here.
+				while (!deadEnd.empty() && next < 0) {
+					unsigned int v = deadEnd.back();
+					deadEnd.pop_back();
+					if (live[v] > 0) {
+						next = v;
+					}
+				}
+				while (cursor < numVertices && next < 0) {
+					if (live[cursor] > 0) {
+						next = cursor;
+					}
+					cursor++;
+				}
+				if (next >= 0 && clusterStarts != nullptr && output.size() / 3 < numTriangles) {
+					clusterStarts->push_back((unsigned int)(output.size() / 3));
+				}
+			}
+			fanning = next;
+		}
+		mesh->indices = output;
+	}
+
+	void optimizeOverdraw(MeshData* mesh, const std::vector<unsigned int>& clusterStarts, unsigned int cacheSize, float threshold)
+	{
+		std::vector<unsigned int> indices = mesh->indices.toVector();
+		unsigned int numTriangles = (unsigned int)(indices.size() / 3);
+		if (numTriangles == 0 || clusterStarts.empty()) {
+			return;
+		}
+
+		//Split each cluster wherever the part so far is already nearly as cache efficient as the whole cluster
+		std::vector<unsigned int> starts;
+		FifoCache cache(mesh->vertices.size(), cacheSize);
+		for (size_t c = 0; c < clusterStarts.size(); c++)
+		{
+			unsigned int start = clusterStarts[c];
+			unsigned int end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : numTriangles;
+			cache.flush();
+			unsigned int clusterMisses = 0;
+			for (unsigned int i = start * 3; i < end * 3; i++)
+			{
+				clusterMisses += cache.access(indices[i]);
+			}
+			float clusterAcmr = (float)clusterMisses / (end - start);
+
+			cache.flush();
+			unsigned int subStart = start;
+			unsigned int misses = 0;
+			starts.push_back(start);
+			for (unsigned int t = start; t < end; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					misses += cache.access(indices[t * 3 + k]);
+				}
+				if (t + 1 < end && (float)misses / (t + 1 - subStart) <= clusterAcmr * threshold) {
+					starts.push_back(t + 1);
+					subStart = t + 1;
+					misses = 0;
+					cache.flush();
+				}
+			}
+		}
+
+		//Sort key: how far the cluster faces away from the mesh center
+		glm::vec3 meshCentroid = glm::vec3(0);
+		float meshArea = 0.0f;
+		std::vector<glm::vec3> clusterCentroids(starts.size(), glm::vec3(0));
+		std::vector<glm::vec3> clusterNormals(starts.size(), glm::vec3(0));
+		std::vector<float> clusterAreas(starts.size(), 0.0f);
+		for (size_t c = 0; c < starts.size(); c++)
+		{
+			unsigned int end = c + 1 < starts.size() ? starts[c + 1] : numTriangles;
+			for (unsigned int t = starts[c]; t < end; t++)
+			{
+				const glm::vec3& a = mesh->vertices[indices[t * 3]].pos;
+				const glm::vec3& b = mesh->vertices[indices[t * 3 + 1]].pos;
+				const glm::vec3& d = mesh->vertices[indices[t * 3 + 2]].pos;
+				glm::vec3 normal = glm::cross(b - a, d - a);
+				float area = glm::length(normal);
+				glm::vec3 centroid = (a + b + d) / 3.0f;
+				clusterCentroids[c] += centroid * area;
+				clusterNormals[c] += normal;
+				clusterAreas[c] += area;
+				meshCentroid += centroid * area;
+				meshArea += area;
+			}
+		}
+		if (meshArea > 0.0f) {
+			meshCentroid /= meshArea;
+		}
+		std::vector<float> keys(starts.size(), 0.0f);
+		std::vector<unsigned int> order(starts.size());
+		for (size_t c = 0; c < starts.size(); c++)
+		{
+			order[c] = (unsigned int)c;
+			float normalLength = glm::length(clusterNormals[c]);
+			if (clusterAreas[c] > 0.0f && normalLength > 0.0f) {
+				glm::vec3 centroid = clusterCentroids[c] / clusterAreas[c];
+				keys[c] = glm::dot(centroid - meshCentroid, clusterNormals[c] / normalLength);
+			}
+		}
+		std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+			return keys[a] > keys[b];
+		});
+
+		std::vector<unsigned int> output;
+		output.reserve(indices.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			unsigned int c = order[i];
+			unsigned int end = c + 1 < starts.size() ? starts[c + 1] : numTriangles;
+			output.insert(output.end(), indices.begin() + starts[c] * 3, indices.begin() + end * 3);
+		}
+		mesh->indices = output;
+	}
+
+	void optimizeVertexFetch(MeshData* mesh)
+	{
+		const unsigned int unused = ~0u;
+		std::vector<unsigned int> remap(mesh->vertices.size(), unused);
+		std::vector<Vertex> vertices;
+		vertices.reserve(mesh->vertices.size());
+		for (size_t i = 0; i < mesh->indices.size(); i++)
+		{
+			unsigned int v = mesh->indices[i];
+			if (remap[v] == unused) {
+				remap[v] = (unsigned int)vertices.size();
+				vertices.push_back(mesh->vertices[v]);
+			}
+			mesh->indices.set(i, remap[v]);
+		}
+		mesh->vertices = vertices;
+	}
+
+	MeshOptimizationReport optimizeMesh(MeshData* mesh, unsigned int cacheSize)
+	{
+		MeshOptimizationReport report;
+		report.before = analyzeVertexCache(*mesh, cacheSize);
+		std::vector<unsigned int> clusterStarts;
+		optimizeVertexCache(mesh, cacheSize, &clusterStarts);
+		optimizeOverdraw(mesh, clusterStarts, cacheSize);
+		optimizeVertexFetch(mesh);
+		report.after = analyzeVertexCache(*mesh, cacheSize);
+		return report;
+	}
+}
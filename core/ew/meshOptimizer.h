@@ -0,0 +1,31 @@
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	//Post-transform vertex cache efficiency of an index buffer, simulated with a FIFO cache
+	struct VertexCacheStats {
+		float acmr = 0.0f; //Average cache miss ratio: vertex shader runs per triangle. 0.5 is ideal for regular grids, 3 is worst
+		float atvr = 0.0f; //Average transformed vertex ratio: vertex shader runs per unique vertex. 1 is ideal
+	};
+
+	struct MeshOptimizationReport {
+		VertexCacheStats before;
+		VertexCacheStats after;
+	};
+
+	VertexCacheStats analyzeVertexCache(const MeshData& mesh, unsigned int cacheSize = 16);
+
+	//Reorders triangles for the post-transform vertex cache (Tipsify).
+	//Triangle indices where the cache had to be refilled are written to clusterStarts if not null.
+	void optimizeVertexCache(MeshData* mesh, unsigned int cacheSize = 16, std::vector<unsigned int>* clusterStarts = nullptr);
+
+	//Reorders clusters of triangles so outward facing ones draw first, to reduce overdraw.
+	//Clusters are split further as long as their ACMR stays within threshold times the original.
+	void optimizeOverdraw(MeshData* mesh, const std::vector<unsigned int>& clusterStarts, unsigned int cacheSize = 16, float threshold = 1.05f);
+
+	//Reorders vertices into the order indices first use them, and drops unused vertices
+	void optimizeVertexFetch(MeshData* mesh);
+
+	//Runs all of the above in order
+	MeshOptimizationReport optimizeMesh(MeshData* mesh, unsigned int cacheSize = 16);
+}
@@ -0,0 +1,328 @@
+#include "meshSimplifier.h"
+#include <algorithm>
+#include <unordered_map>
+#include <string.h>
+#include <math.h>
+
+namespace ew {
+	//Symmetric 4x4 matrix summing squared distances to planes, plus the total weight of those planes
+	struct Quadric {
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+		double a11 = 0, a12 = 0, a13 = 0;
+		double a22 = 0, a23 = 0;
+		double a33 = 0;
+		double weight = 0;
+
+		//Plane dot(n, p) + d = 0
+		void addPlane(const glm::vec3& n, float d, float w) {
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+			a22 += w * n.z * n.z; a23 += w * n.z * d;
+			a33 += w * d * d;
+			weight += w;
+		}
+		void add(const Quadric& q) {
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			weight += q.weight;
+		}
+		//Weighted sum of squared distances from p to the planes
+		double evaluate(const glm::vec3& p) const {
+			double x = p.x, y = p.y, z = p.z;
+			return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+				+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+				+ a22 * z * z + 2 * a23 * z
+				+ a33;
+		}
+	};
+
+	enum class VertexKind {
+		MANIFOLD = 0,
+		BORDER = 1, //On an open edge, may only slide along it
+		LOCKED = 2 //Shares its position with other vertices (a UV or normal seam), never removed
+	};
+
+	struct Collapse {
+		float cost;
+		unsigned int from;
+		unsigned int to;
+	};
+
+	//Border edges are counted on welded positions, so seams do not look like holes
+	static inline unsigned long long edgeKey(unsigned int a, unsigned int b) {
+		if (a > b) {
+			std::swap(a, b);
+		}
+		return ((unsigned long long)a << 32) | b;
+	}
+
+	struct PositionHash {
+		size_t operator()(const glm::vec3& p) const {
+			unsigned int bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+	struct PositionEqual {
+		bool operator()(const glm::vec3& a, const glm::vec3& b) const {
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+
+	std::vector<unsigned int> simplifyIndices(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		unsigned int targetIndexCount, float* resultError)
+	{
+		unsigned int numVertices = (unsigned int)vertices.size();
+		std::vector<unsigned int> result = indices;
+		float maxError = 0.0f;
+
+		//Weld vertices by position. Any vertex sharing its position is on a seam and gets locked.
+		std::vector<unsigned int> welded(numVertices);
+		std::vector<VertexKind> kinds(numVertices, VertexKind::MANIFOLD);
+		{
+			std::unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> firstWithPosition;
+			for (unsigned int v = 0; v < numVertices; v++)
+			{
+				auto inserted = firstWithPosition.insert(std::make_pair(vertices[v].pos, v));
+				welded[v] = inserted.first->second;
+				if (!inserted.second) {
+					kinds[v] = VertexKind::LOCKED;
+					kinds[inserted.first->second] = VertexKind::LOCKED;
+				}
+			}
+		}
+
+		//Plane quadrics of every triangle, area weighted
+		std::vector<Quadric> quadrics(numVertices);
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			const glm::vec3& p0 = vertices[result[i]].pos;
+			const glm::vec3& p1 = vertices[result[i + 1]].pos;
+			const glm::vec3& p2 = vertices[result[i + 2]].pos;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			if (area <= 0.0f) {
+				continue;
+			}
+			normal /= area;
+			Quadric q;
+			q.addPlane(normal, -glm::dot(normal, p0), area);
+			for (int c = 0; c < 3; c++)
+			{
+				quadrics[welded[result[i + c]]].add(q);
+			}
+		}
+
+		std::unordered_map<unsigned long long, unsigned int> edgeUses;
+		std::vector<bool> onBorder(numVertices);
+		std::vector<unsigned int> adjacencyOffsets(numVertices + 1);
+		std::vector<unsigned int> adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<bool> locked(numVertices);
+		std::vector<unsigned int> remap(numVertices);
+		bool addedBorderPlanes = false;
+
+		while (result.size() > targetIndexCount) {
+			//Find border edges for the current triangles
+			edgeUses.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					edgeUses[edgeKey(welded[result[i + c]], welded[result[i + (c + 1) % 3]])]++;
+				}
+			}
+			std::fill(onBorder.begin(), onBorder.end(), false);
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					unsigned int a = result[i + c];
+					unsigned int b = result[i + (c + 1) % 3];
+					if (edgeUses[edgeKey(welded[a], welded[b])] != 1) {
+						continue;
+					}
+					onBorder[a] = onBorder[b] = true;
+					//Planes perpendicular to the border keep it from shrinking. Only added once, from the input.
+					if (!addedBorderPlanes) {
+						const glm::vec3& pa = vertices[a].pos;
+						const glm::vec3& pb = vertices[b].pos;
+						const glm::vec3& pc = vertices[result[i + (c + 2) % 3]].pos;
+						glm::vec3 edge = pb - pa;
+						glm::vec3 normal = glm::cross(edge, glm::cross(pc - pa, edge));
+						float length = glm::length(normal);
+						if (length > 0.0f) {
+							normal /= length;
+							Quadric q;
+							q.addPlane(normal, -glm::dot(normal, pa), glm::dot(edge, edge) * 10.0f);
+							quadrics[welded[a]].add(q);
+							quadrics[welded[b]].add(q);
+						}
+					}
+				}
+			}
+			addedBorderPlanes = true;
+
+			//Triangles around each vertex
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (size_t i = 0; i < result.size(); i++)
+			{
+				adjacencyOffsets[result[i] + 1]++;
+			}
+			for (unsigned int v = 0; v < numVertices; v++)
+			{
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			adjacency.resize(result.size());
+			{
+				std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < result.size(); i++)
+				{
+					adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+				}
+			}
+
+			//Candidate collapses, both directions of every edge
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					unsigned int a = result[i + c];
+					unsigned int b = result[i + (c + 1) % 3];
+					for (int d = 0; d < 2; d++)
+					{
+						unsigned int from = d == 0 ? a : b;
+						unsigned int to = d == 0 ? b : a;
+						if (kinds[from] == VertexKind::LOCKED || welded[from] == welded[to]) {
+							continue;
+						}
+						if (onBorder[from] && (!onBorder[to] || edgeUses[edgeKey(welded[from], welded[to])] != 1)) {
+							continue;
+						}
+						Quadric q = quadrics[welded[from]];
+						q.add(quadrics[welded[to]]);
+						double error = q.weight > 0 ? q.evaluate(vertices[to].pos) / q.weight : 0.0;
+						Collapse collapse;
+						collapse.cost = (float)sqrt(error > 0 ? error : 0);
+						collapse.from = from;
+						collapse.to = to;
+						collapses.push_back(collapse);
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.cost < b.cost;
+			});
+
+			//Apply the cheapest collapses that do not touch each other
+			std::fill(locked.begin(), locked.end(), false);
+			for (unsigned int v = 0; v < numVertices; v++)
+			{
+				remap[v] = v;
+			}
+			size_t remainingIndices = result.size();
+			unsigned int numCollapsed = 0;
+			for (size_t i = 0; i < collapses.size() && remainingIndices > targetIndexCount; i++)
+			{
+				const Collapse& collapse = collapses[i];
+				unsigned int from = collapse.from;
+				unsigned int to = collapse.to;
+				if (locked[from] || locked[to]) {
+					continue;
+				}
+				//Reject collapses that would flip a triangle
+				bool flips = false;
+				unsigned int removedTriangles = 0;
+				for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && !flips; a++)
+				{
+					const unsigned int* triangle = &result[adjacency[a] * 3];
+					if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+						removedTriangles++;
+						continue;
+					}
+					glm::vec3 p[3];
+					glm::vec3 moved[3];
+					for (int c = 0; c < 3; c++)
+					{
+						p[c] = vertices[triangle[c]].pos;
+						moved[c] = triangle[c] == from ? vertices[to].pos : p[c];
+					}
+					glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+					flips = glm::dot(before, after) <= 0.0f;
+				}
+				if (flips) {
+					continue;
+				}
+				remap[from] = to;
+				quadrics[welded[to]].add(quadrics[welded[from]]);
+				maxError = glm::max(maxError, collapse.cost);
+				remainingIndices -= removedTriangles * 3;
+				numCollapsed++;
+				//Lock the neighborhood so later collapses in this pass see up to date triangles
+				for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+				{
+					const unsigned int* triangle = &result[adjacency[a] * 3];
+					locked[triangle[0]] = locked[triangle[1]] = locked[triangle[2]] = true;
+				}
+				locked[to] = true;
+			}
+			if (numCollapsed == 0) {
+				break;
+			}
+
+			//Remove triangles that collapsed to a line
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				unsigned int a = remap[result[i]];
+				unsigned int b = remap[result[i + 1]];
+				unsigned int c = remap[result[i + 2]];
+				if (welded[a] == welded[b] || welded[b] == welded[c] || welded[c] == welded[a]) {
+					continue;
+				}
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+		}
+
+		if (resultError != nullptr) {
+			*resultError = maxError;
+		}
+		return result;
+	}
+
+	void generateLods(MeshData* mesh, const std::vector<float>& ratios)
+	{
+		mesh->lods.clear();
+		LodLevel base;
+		base.indexOffset = 0;
+		base.indexCount = (unsigned int)mesh->indices.size();
+		base.error = 0.0f;
+		mesh->lods.push_back(base);
+
+		std::vector<unsigned int> previous = mesh->indices.toVector();
+		float previousError = 0.0f;
+		for (size_t i = 0; i < ratios.size(); i++)
+		{
+			unsigned int target = (unsigned int)(base.indexCount * ratios[i]) / 3 * 3;
+			float error = 0.0f;
+			std::vector<unsigned int> simplified = simplifyIndices(mesh->vertices, previous, target, &error);
+
+			LodLevel lod;
+			lod.indexOffset = (unsigned int)mesh->indices.size();
+			lod.indexCount = (unsigned int)simplified.size();
+			lod.error = glm::max(previousError, error);
+			mesh->indices.append(simplified);
+			mesh->lods.push_back(lod);
+
+			previous = simplified;
+			previousError = lod.error;
+		}
+	}
+}
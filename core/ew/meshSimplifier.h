@@ -0,0 +1,15 @@
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	//Reduces indices to about targetIndexCount using quadric error edge collapses. Vertices are not moved or added,
+	//so the result indexes the same vertex array.
+	//Vertices on UV/normal seams stay in place, and open borders only collapse along themselves.
+	//resultError receives the largest collapse error, as a distance in mesh units.
+	std::vector<unsigned int> simplifyIndices(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		unsigned int targetIndexCount, float* resultError = nullptr);
+
+	//Appends one simplified level per ratio (fraction of the original triangle count) to mesh->indices,
+	//and fills mesh->lods. Each level is simplified from the one before it.
+	void generateLods(MeshData* mesh, const std::vector<float>& ratios);
+}
@@ -0,0 +1,490 @@
+#include "mipmap.h"
+#include "mappedFile.h"
+#include "external/glad.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_MIPMAP_SSE 1
+#include <emmintrin.h>
+#endif
+//Only when the compiler targets AVX2 (-mavx2, /arch:AVX2)
+#if defined(__AVX2__)
+#define EW_MIPMAP_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace ew {
+	static const char MIP_MAGIC[4] = { 'E', 'W', 'M', 'P' };
+	static const uint32_t MIP_VERSION = 1;
+
+	//Kaiser window half width in destination pixels, and its shape
+	static const float KAISER_WIDTH = 3.0f;
+	static const float KAISER_ALPHA = 4.0f;
+
+	//Images with fewer pixels than this are filtered on the calling thread
+	static const int MIN_PARALLEL_PIXELS = 256 * 256;
+	static const int ROWS_PER_BAND = 32;
+
+	//Entries in the linear to sRGB table. Fine enough that the steepest part, near black, stays within a fraction of a level.
+	static const int SRGB_ENCODE_SIZE = 16384;
+
+	struct MipFileHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceMtime;
+		uint64_t sourceSize;
+		uint64_t hash;
+		uint32_t numComponents;
+		uint32_t numLevels;
+	};
+
+	struct MipFileLevel {
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;
+	};
+
+	static float srgbToLinear(float c) {
+		return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static float linearToSrgb(float c) {
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	struct ColorTables {
+		float srgbToLinear[256];
+		float unormToFloat[256];
+		unsigned char linearToSrgb[SRGB_ENCODE_SIZE + 1];
+
+		ColorTables() {
+			for (int i = 0; i < 256; i++)
+			{
+				unormToFloat[i] = i / 255.0f;
+				srgbToLinear[i] = ew::srgbToLinear(i / 255.0f);
+			}
+			for (int i = 0; i <= SRGB_ENCODE_SIZE; i++)
+			{
+				linearToSrgb[i] = (unsigned char)(ew::linearToSrgb((float)i / SRGB_ENCODE_SIZE) * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	static const ColorTables& getColorTables() {
+		static const ColorTables tables;
+		return tables;
+	}
+
+	static inline unsigned char encodeUnorm(float v) {
+		v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+		return (unsigned char)(v * 255.0f + 0.5f);
+	}
+
+	static inline unsigned char encodeSrgb(const ColorTables& tables, float v) {
+		v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+		return tables.linearToSrgb[(int)(v * SRGB_ENCODE_SIZE + 0.5f)];
+	}
+
+	static float besselI0(float x) {
+		//Power series, converges quickly for the small arguments a Kaiser window uses
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 32; k++)
+		{
+			term *= (x * 0.5f / k) * (x * 0.5f / k);
+			sum += term;
+			if (term < sum * 1e-7f) {
+				break;
+			}
+		}
+		return sum;
+	}
+
+	static float kaiser(float t) {
+		if (fabsf(t) >= KAISER_WIDTH) {
+			return 0.0f;
+		}
+		float sinc = t == 0.0f ? 1.0f : sinf(3.14159265f * t) / (3.14159265f * t);
+		float r = t / KAISER_WIDTH;
+		return sinc * besselI0(KAISER_ALPHA * sqrtf(1.0f - r * r)) / besselI0(KAISER_ALPHA);
+	}
+
+	//Which source pixels, and how much of each, make up every destination pixel along one axis.
+	//Every destination pixel has numTaps taps, padded with zero weights.
+	struct FilterAxis {
+		int numTaps = 0;
+		std::vector<int> indices;
+		std::vector<float> weights;
+	};
+
+	static void buildFilterAxis(int srcSize, int dstSize, MipFilter filter, bool wrap, FilterAxis* axis) {
+		float scale = (float)srcSize / dstSize;
+		float radius = filter == MipFilter::KAISER ? KAISER_WIDTH * scale : scale * 0.5f;
+		axis->numTaps = (int)ceilf(radius * 2.0f) + 1;
+		axis->indices.assign((size_t)dstSize * axis->numTaps, 0);
+		axis->weights.assign((size_t)dstSize * axis->numTaps, 0.0f);
+		for (int x = 0; x < dstSize; x++)
+		{
+			float center = (x + 0.5f) * scale;
+			int first = (int)floorf(center - radius);
+			int* indices = &axis->indices[(size_t)x * axis->numTaps];
+			float* weights = &axis->weights[(size_t)x * axis->numTaps];
+			float total = 0.0f;
+			for (int k = 0; k < axis->numTaps; k++)
+			{
+				int i = first + k;
+				float weight;
+				if (filter == MipFilter::KAISER) {
+					weight = kaiser((i + 0.5f - center) / scale);
+				}
+				else {
+					//Exact overlap of the source pixel with the destination footprint, so odd sizes stay correct
+					float overlap = fminf((float)(i + 1), center + radius) - fmaxf((float)i, center - radius);
+					weight = overlap > 0.0f ? overlap : 0.0f;
+				}
+				if (wrap) {
+					i = ((i % srcSize) + srcSize) % srcSize;
+				}
+				else {
+					i = i < 0 ? 0 : (i >= srcSize ? srcSize - 1 : i);
+				}
+				indices[k] = i;
+				weights[k] = weight;
+				total += weight;
+			}
+			for (int k = 0; k < axis->numTaps; k++)
+			{
+				weights[k] /= total;
+			}
+		}
+	}
+
+	//Calls fn(firstRow, endRow) over bands of rows, as jobs if it is worth it
+	static void forEachBand(JobSystem* jobs, int numRows, bool parallel, const std::function<void(int, int)>& fn) {
+		unsigned int numBands = (unsigned int)((numRows + ROWS_PER_BAND - 1) / ROWS_PER_BAND);
+		auto band = [&](unsigned int i) {
+			int first = (int)i * ROWS_PER_BAND;
+			fn(first, first + ROWS_PER_BAND < numRows ? first + ROWS_PER_BAND : numRows);
+		};
+		if (jobs != nullptr && parallel && numBands > 1) {
+			jobs->parallelForEach(numBands, band);
+		}
+		else {
+			for (unsigned int i = 0; i < numBands; i++)
+			{
+				band(i);
+			}
+		}
+	}
+
+	//Filters rows [firstRow, endRow) of src (srcWidth RGBA floats wide) horizontally into dst (axis size wide)
+	static void filterRows(const float* src, int srcWidth, float* dst, int dstWidth, const FilterAxis& axis, int firstRow, int endRow) {
+		const int numTaps = axis.numTaps;
+		for (int y = firstRow; y < endRow; y++)
+		{
+			const float* srcRow = src + (size_t)y * srcWidth * 4;
+			float* dstRow = dst + (size_t)y * dstWidth * 4;
+			for (int x = 0; x < dstWidth; x++)
+			{
+				const int* indices = &axis.indices[(size_t)x * numTaps];
+				const float* weights = &axis.weights[(size_t)x * numTaps];
+#ifdef EW_MIPMAP_SSE
+				//One RGBA pixel per register
+				__m128 sum = _mm_setzero_ps();
+				for (int k = 0; k < numTaps; k++)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(srcRow + indices[k] * 4)));
+				}
+				_mm_storeu_ps(dstRow + x * 4, sum);
+#else
+				float sum[4] = {};
+				for (int k = 0; k < numTaps; k++)
+				{
+					const float* p = srcRow + indices[k] * 4;
+					sum[0] += weights[k] * p[0];
+					sum[1] += weights[k] * p[1];
+					sum[2] += weights[k] * p[2];
+					sum[3] += weights[k] * p[3];
+				}
+				memcpy(dstRow + x * 4, sum, sizeof(sum));
+#endif
+			}
+		}
+	}
+
+	//Filters columns: each destination row is a weighted sum of whole source rows, so it vectorizes across the row
+	static void filterColumns(const float* src, float* dst, int width, const FilterAxis& axis, int firstRow, int endRow) {
+		const int numTaps = axis.numTaps;
+		const int numFloats = width * 4;
+		for (int y = firstRow; y < endRow; y++)
+		{
+			const int* indices = &axis.indices[(size_t)y * numTaps];
+			const float* weights = &axis.weights[(size_t)y * numTaps];
+			float* dstRow = dst + (size_t)y * numFloats;
+			memset(dstRow, 0, sizeof(float) * numFloats);
+			for (int k = 0; k < numTaps; k++)
+			{
+				if (weights[k] == 0.0f) {
+					continue;
+				}
+				const float* srcRow = src + (size_t)indices[k] * numFloats;
+				int i = 0;
+#ifdef EW_MIPMAP_AVX2
+				__m256 w8 = _mm256_set1_ps(weights[k]);
+				for (; i + 8 <= numFloats; i += 8)
+				{
+					_mm256_storeu_ps(dstRow + i, _mm256_add_ps(_mm256_loadu_ps(dstRow + i), _mm256_mul_ps(w8, _mm256_loadu_ps(srcRow + i))));
+				}
+#endif
+#ifdef EW_MIPMAP_SSE
+				__m128 w4 = _mm_set1_ps(weights[k]);
+				for (; i + 4 <= numFloats; i += 4)
+				{
+					_mm_storeu_ps(dstRow + i, _mm_add_ps(_mm_loadu_ps(dstRow + i), _mm_mul_ps(w4, _mm_loadu_ps(srcRow + i))));
+				}
+#endif
+				for (; i < numFloats; i++)
+				{
+					dstRow[i] += weights[k] * srcRow[i];
+				}
+			}
+		}
+	}
+
+	//Writes rows of an RGBA float level to 8 bit pixels with numComponents components
+	static void quantizeRows(const float* src, int width, unsigned char* dst, int numComponents, bool srgb, int firstRow, int endRow) {
+		const ColorTables& tables = getColorTables();
+		int numColor = srgb ? (numComponents < 3 ? 0 : 3) : 0;
+		for (int y = firstRow; y < endRow; y++)
+		{
+			const float* srcRow = src + (size_t)y * width * 4;
+			unsigned char* dstRow = dst + (size_t)y * width * numComponents;
+			for (int x = 0; x < width; x++)
+			{
+				for (int c = 0; c < numComponents; c++)
+				{
+					float v = srcRow[x * 4 + c];
+					dstRow[x * numComponents + c] = c < numColor ? encodeSrgb(tables, v) : encodeUnorm(v);
+				}
+			}
+		}
+	}
+
+	void buildMipChain(const ImageData& image, MipFilter filter, bool srgb, bool wrap, MipChain* chain, JobSystem* jobs)
+	{
+		buildMipChain(image.pixels.get(), image.width, image.height, image.numComponents, filter, srgb, wrap, chain, jobs);
+	}
+
+	void buildMipChain(const unsigned char* pixels, int width, int height, int numComponents, MipFilter filter, bool srgb, bool wrap,
+		MipChain* chain, JobSystem* jobs)
+	{
+		chain->numComponents = numComponents;
+		chain->levels.clear();
+
+		//Lay out every level up front
+		size_t totalSize = 0;
+		for (int w = width, h = height; ; w = w > 1 ? w / 2 : 1, h = h > 1 ? h / 2 : 1)
+		{
+			MipLevel level = { w, h, totalSize };
+			chain->levels.push_back(level);
+			totalSize += (size_t)w * h * numComponents;
+			if (w == 1 && h == 1) {
+				break;
+			}
+		}
+		chain->pixels.resize(totalSize);
+		memcpy(chain->pixels.data(), pixels, (size_t)width * height * numComponents);
+
+		//Level 0 as linear RGBA floats. Only color channels of 3 and 4 component images are sRGB.
+		const ColorTables& tables = getColorTables();
+		const float* colorTable = srgb && numComponents >= 3 ? tables.srgbToLinear : tables.unormToFloat;
+		bool parallel = width * height >= MIN_PARALLEL_PIXELS;
+		std::vector<float> current((size_t)width * height * 4, 0.0f);
+		forEachBand(jobs, height, parallel, [&](int firstRow, int endRow) {
+			for (size_t i = (size_t)firstRow * width; i < (size_t)endRow * width; i++)
+			{
+				const unsigned char* p = pixels + i * numComponents;
+				for (int c = 0; c < numComponents; c++)
+				{
+					current[i * 4 + c] = c < 3 ? colorTable[p[c]] : tables.unormToFloat[p[c]];
+				}
+			}
+		});
+
+		//Each level is filtered from the float copy of the one before, so rounding doesn't accumulate
+		std::vector<float> rows;
+		std::vector<float> next;
+		FilterAxis horizontal, vertical;
+		for (size_t l = 1; l < chain->levels.size(); l++)
+		{
+			const MipLevel& srcLevel = chain->levels[l - 1];
+			const MipLevel& dstLevel = chain->levels[l];
+			buildFilterAxis(srcLevel.width, dstLevel.width, filter, wrap, &horizontal);
+			buildFilterAxis(srcLevel.height, dstLevel.height, filter, wrap, &vertical);
+			parallel = srcLevel.width * srcLevel.height >= MIN_PARALLEL_PIXELS;
+
+			rows.resize((size_t)dstLevel.width * srcLevel.height * 4);
+			forEachBand(jobs, srcLevel.height, parallel, [&](int firstRow, int endRow) {
+				filterRows(current.data(), srcLevel.width, rows.data(), dstLevel.width, horizontal, firstRow, endRow);
+			});
+			next.resize((size_t)dstLevel.width * dstLevel.height * 4);
+			unsigned char* dstPixels = chain->pixels.data() + dstLevel.offset;
+			forEachBand(jobs, dstLevel.height, parallel, [&](int firstRow, int endRow) {
+				filterColumns(rows.data(), next.data(), dstLevel.width, vertical, firstRow, endRow);
+				quantizeRows(next.data(), dstLevel.width, dstPixels, numComponents, srgb, firstRow, endRow);
+			});
+			current.swap(next);
+		}
+	}
+
+	static uint64_t makeMipCacheHash(const char* filePath, const TextureParams& params) {
+		uint64_t hash = hashBytes(filePath, strlen(filePath));
+		int fields[4] = { params.flipVertically ? 1 : 0, params.srgb ? 1 : 0, (int)params.mipFilter, params.wrapMode == GL_REPEAT ? 1 : 0 };
+		return hashBytes(fields, sizeof(fields), hash);
+	}
+
+	bool loadMipChain(const char* filePath, const TextureParams& params, MipChain* chain, JobSystem* jobs)
+	{
+		MeshCacheKey key;
+		bool cacheable = params.useMipCache && getSourceFileInfo(filePath, &key);
+		std::string cookedPath;
+		if (cacheable) {
+			key.hash = makeMipCacheHash(filePath, params);
+			cookedPath = getMipCachePath(filePath, key);
+			if (readMipChain(cookedPath, key, chain)) {
+				return true;
+			}
+		}
+		ImageData image;
+		if (!decodeImage(filePath, params.flipVertically, &image)) {
+			return false;
+		}
+		buildMipChain(image, params.mipFilter, params.srgb, params.wrapMode == GL_REPEAT, chain, jobs);
+		if (cacheable) {
+			writeMipChain(cookedPath, key, *chain);
+		}
+		return true;
+	}
+
+	bool cookMipChain(const char* filePath, const TextureParams& params, std::string* cookedPath, MeshCacheKey* key, JobSystem* jobs)
+	{
+		if (!getSourceFileInfo(filePath, key)) {
+			printf("Failed to cook mips for %s\n", filePath);
+			return false;
+		}
+		key->hash = makeMipCacheHash(filePath, params);
+		*cookedPath = getMipCachePath(filePath, *key);
+		MipChain chain;
+		if (readMipChain(*cookedPath, *key, &chain, 0, 0)) {
+			return true;
+		}
+		ImageData image;
+		if (!decodeImage(filePath, params.flipVertically, &image)) {
+			return false;
+		}
+		buildMipChain(image, params.mipFilter, params.srgb, params.wrapMode == GL_REPEAT, &chain, jobs);
+		return writeMipChain(*cookedPath, *key, chain);
+	}
+
+	std::string getMipCachePath(const std::string& sourcePath, const MeshCacheKey& key)
+	{
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%016llx.ewmip", (unsigned long long)key.hash);
+		return sourcePath + suffix;
+	}
+
+	bool readMipChain(const std::string& cookedPath, const MeshCacheKey& key, MipChain* chain, int firstLevel, int numLevels)
+	{
+		MappedFile file;
+		if (!file.open(cookedPath.c_str())) {
+			return false;
+		}
+		const unsigned char* data = file.getData();
+		uint64_t size = file.getSize();
+		MipFileHeader header;
+		if (size < sizeof(header)) {
+			return false;
+		}
+		memcpy(&header, data, sizeof(header));
+		uint64_t pixelsOffset = sizeof(header) + (uint64_t)header.numLevels * sizeof(MipFileLevel);
+		if (memcmp(header.magic, MIP_MAGIC, sizeof(MIP_MAGIC)) != 0 || header.version != MIP_VERSION
+			|| header.sourceMtime != key.sourceMtime || header.sourceSize != key.sourceSize || header.hash != key.hash
+			|| header.numComponents < 1 || header.numComponents > 4 || header.numLevels == 0 || pixelsOffset > size) {
+			return false;
+		}
+		chain->numComponents = (int)header.numComponents;
+		chain->levels.resize(header.numLevels);
+		uint64_t pixelsSize = size - pixelsOffset;
+		for (uint32_t i = 0; i < header.numLevels; i++)
+		{
+			MipFileLevel level;
+			memcpy(&level, data + sizeof(header) + i * sizeof(MipFileLevel), sizeof(level));
+			if (level.offset + (uint64_t)level.width * level.height * header.numComponents > pixelsSize) {
+				printf("Cooked mips %s are truncated\n", cookedPath.c_str());
+				chain->levels.clear();
+				return false;
+			}
+			chain->levels[i].width = (int)level.width;
+			chain->levels[i].height = (int)level.height;
+			chain->levels[i].offset = (size_t)level.offset;
+		}
+
+		//Only the requested levels are copied, with their offsets moved to the start of pixels
+		int endLevel = numLevels < 0 ? (int)header.numLevels : std::min(firstLevel + numLevels, (int)header.numLevels);
+		firstLevel = std::max(firstLevel, 0);
+		chain->pixels.clear();
+		if (firstLevel < endLevel) {
+			const MipLevel& last = chain->levels[endLevel - 1];
+			size_t begin = chain->levels[firstLevel].offset;
+			size_t end = last.offset + (size_t)last.width * last.height * header.numComponents;
+			chain->pixels.assign(data + pixelsOffset + begin, data + pixelsOffset + end);
+			for (int i = firstLevel; i < endLevel; i++)
+			{
+				chain->levels[i].offset -= begin;
+			}
+		}
+		return true;
+	}
+
+	bool writeMipChain(const std::string& cookedPath, const MeshCacheKey& key, const MipChain& chain)
+	{
+		MipFileHeader header;
+		memcpy(header.magic, MIP_MAGIC, sizeof(MIP_MAGIC));
+		header.version = MIP_VERSION;
+		header.sourceMtime = key.sourceMtime;
+		header.sourceSize = key.sourceSize;
+		header.hash = key.hash;
+		header.numComponents = (uint32_t)chain.numComponents;
+		header.numLevels = (uint32_t)chain.levels.size();
+		std::vector<MipFileLevel> levels(chain.levels.size());
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			levels[i].width = (uint32_t)chain.levels[i].width;
+			levels[i].height = (uint32_t)chain.levels[i].height;
+			levels[i].offset = chain.levels[i].offset;
+		}
+
+		//Write to a temporary file first so a crash never leaves a half written cache entry behind
+		std::string tempPath = cookedPath + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write cooked mips %s\n", cookedPath.c_str());
+			return false;
+		}
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = ok && fwrite(levels.data(), sizeof(MipFileLevel), levels.size(), file) == levels.size();
+		ok = ok && fwrite(chain.pixels.data(), 1, chain.pixels.size(), file) == chain.pixels.size();
+		ok = fclose(file) == 0 && ok;
+
+		remove(cookedPath.c_str());
+		if (!ok || rename(tempPath.c_str(), cookedPath.c_str()) != 0) {
+			printf("Failed to write cooked mips %s\n", cookedPath.c_str());
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+}
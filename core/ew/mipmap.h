@@ -0,0 +1,29 @@
+#pragma once
+#include "texture.h"
+#include "jobSystem.h"
+#include "meshCache.h"
+#include <string>
+
+namespace ew {
+	//Builds every level of image down to 1x1 with a box or Kaiser filter (DRIVER is treated as box).
+	//sRGB images with 3 or 4 components are filtered in linear space, alpha is always linear.
+	//wrap filters across the edges for repeating textures instead of clamping. Large images are split into jobs.
+	void buildMipChain(const ImageData& image, MipFilter filter, bool srgb, bool wrap, MipChain* chain, JobSystem* jobs = nullptr);
+	void buildMipChain(const unsigned char* pixels, int width, int height, int numComponents, MipFilter filter, bool srgb, bool wrap,
+		MipChain* chain, JobSystem* jobs = nullptr);
+
+	//Decodes filePath and builds its mips with params. If params.useMipCache, an up to date cooked chain is loaded
+	//instead, or written after building. Returns false if the image can't be decoded.
+	bool loadMipChain(const char* filePath, const TextureParams& params, MipChain* chain, JobSystem* jobs = nullptr);
+
+	//Where the cooked mips for a key live, next to the source
+	std::string getMipCachePath(const std::string& sourcePath, const MeshCacheKey& key);
+	//Makes sure an up to date cooked chain exists for filePath and params, building it if not, without keeping the pixels.
+	//Returns where it is and the key to read it with.
+	bool cookMipChain(const char* filePath, const TextureParams& params, std::string* cookedPath, MeshCacheKey* key,
+		JobSystem* jobs = nullptr);
+	//Returns false on a missing, stale or corrupt file. chain->levels always lists every level, but only
+	//[firstLevel, firstLevel + numLevels) are read into pixels and have valid offsets. numLevels < 0 reads to the end.
+	bool readMipChain(const std::string& cookedPath, const MeshCacheKey& key, MipChain* chain, int firstLevel = 0, int numLevels = -1);
+	bool writeMipChain(const std::string& cookedPath, const MeshCacheKey& key, const MipChain& chain);
+}
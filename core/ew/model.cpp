@@ -3,32 +3,133 @@
 */
 
 #include "model.h"
+#include "meshSimplifier.h"
+#include "objLoader.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <ctype.h>
+#include <stdio.h>
 
 namespace ew {
-	ew::Mesh processAiMesh(aiMesh* aiMesh);
+	ew::MeshData processAiMesh(aiMesh* aiMesh);
 
-	Model::Model(const std::string& filePath)
+	//True if filePath ends in .obj, in any case
+	static bool isObjFile(const std::string& filePath) {
+		if (filePath.size() < 4) {
+			return false;
+		}
+		std::string extension = filePath.substr(filePath.size() - 4);
+		for (size_t i = 0; i < extension.size(); i++)
+		{
+			extension[i] = (char)tolower(extension[i]);
+		}
+		return extension == ".obj";
+	}
+
+	const char* getModelSourceName(ModelSource source)
 	{
+		switch (source) {
+		case ModelSource::ASSIMP:
+			return "Assimp";
+		case ModelSource::OBJ_READER:
+			return "loadObj";
+		case ModelSource::COOKED_CACHE:
+			return "cooked cache";
+		default:
+			return "nothing";
+		}
+	}
+
+	ModelSource getModelImporter(const std::string& filePath, const ModelLoadOptions& options)
+	{
+		return options.useObjReader && isObjFile(filePath) ? ModelSource::OBJ_READER : ModelSource::ASSIMP;
+	}
+
+	std::vector<MeshData> loadModelMeshData(const std::string& filePath, const ModelLoadOptions& options,
+		std::vector<MeshOptimizationReport>* reports, JobSystem* jobs)
+	{
+		std::vector<MeshData> meshes;
 		Assimp::Importer importer;
-		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
-		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
-		{
-			aiMesh* aiMesh = aiScene->mMeshes[i];
-			m_meshes.push_back(processAiMesh(aiMesh));
+		const aiScene* aiScene = nullptr;
+		if (getModelImporter(filePath, options) == ModelSource::OBJ_READER) {
+			meshes.resize(1);
+			if (!loadObj(filePath, &meshes[0], jobs)) {
+				meshes.clear();
+				return meshes;
+			}
+		}
+		else {
+			aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
+			if (aiScene == nullptr) {
+				printf("Failed to load model %s: %s\n", filePath.c_str(), importer.GetErrorString());
+				return meshes;
+			}
+			meshes.resize(aiScene->mNumMeshes);
 		}
+		unsigned int numMeshes = (unsigned int)meshes.size();
+		std::vector<MeshOptimizationReport> meshReports(numMeshes);
+
+		//Meshes are independent, so conversion, optimization and LODs can run as jobs
+		auto processMesh = [&](unsigned int i) {
+			ew::MeshData& meshData = meshes[i];
+			if (aiScene != nullptr) {
+				meshData = processAiMesh(aiScene->mMeshes[i]);
+			}
+			if (options.optimizeMeshes) {
+				MeshOptimizationReport report = optimizeMesh(&meshData);
+				if (options.verbose) {
+					printf("Optimized %s mesh %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", filePath.c_str(), i,
+						report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr);
+				}
+				meshReports[i] = report;
+			}
+			if (!options.lodRatios.empty()) {
+				generateLods(&meshData, options.lodRatios);
+				for (size_t j = 1; j < meshData.lods.size() && options.verbose; j++)
+				{
+					printf("%s mesh %u LOD %zu: %u triangles, error %f\n", filePath.c_str(), i, j,
+						meshData.lods[j].indexCount / 3, meshData.lods[j].error);
+				}
+			}
+		};
+		if (jobs != nullptr) {
+			jobs->parallelForEach(numMeshes, processMesh);
+		}
+		else {
+			for (unsigned int i = 0; i < numMeshes; i++)
+			{
+				processMesh(i);
+			}
+		}
+		if (options.optimizeMeshes && reports != nullptr) {
+			reports->insert(reports->end(), meshReports.begin(), meshReports.end());
+		}
+		return meshes;
 	}
 
-	void Model::draw()
+	bool makeModelCacheKey(const std::string& filePath, const ModelLoadOptions& options,
+		const VertexAttribute* attributes, int numAttributes, unsigned int vertexSize, MeshCacheKey* key)
 	{
-		for (size_t i = 0; i < m_meshes.size(); i++)
+		if (!getSourceFileInfo(filePath, key)) {
+			return false;
+		}
+		uint64_t hash = hashBytes(filePath.data(), filePath.size());
+		hash = hashBytes(&options.optimizeMeshes, sizeof(options.optimizeMeshes), hash);
+		hash = hashBytes(options.lodRatios.data(), options.lodRatios.size() * sizeof(float), hash);
+		hash = hashBytes(&options.useObjReader, sizeof(options.useObjReader), hash);
+		hash = hashBytes(&vertexSize, sizeof(vertexSize), hash);
+		for (int i = 0; i < numAttributes; i++)
 		{
-			m_meshes[i].draw();
+			const VertexAttribute& attribute = attributes[i];
+			unsigned int fields[5] = { attribute.location, (unsigned int)attribute.components, (unsigned int)attribute.type,
+				attribute.normalized ? 1u : 0u, attribute.offset };
+			hash = hashBytes(fields, sizeof(fields), hash);
 		}
+		key->hash = hash;
+		return true;
 	}
 
 	glm::vec3 convertAIVec3(const aiVector3D& v) {
@@ -36,8 +137,10 @@ namespace ew {
 	}
 
 	//Utility functions local to this file
-	ew::Mesh processAiMesh(aiMesh* aiMesh) {
+	ew::MeshData processAiMesh(aiMesh* aiMesh) {
 		ew::MeshData meshData;
+		meshData.vertices.reserve(aiMesh->mNumVertices);
+		meshData.indices.reserve(aiMesh->mNumFaces * 3);
 		for (size_t i = 0; i < aiMesh->mNumVertices; i++)
 		{
 			ew::Vertex vertex;
@@ -58,7 +161,7 @@ namespace ew {
 				meshData.indices.push_back(aiMesh->mFaces[i].mIndices[j]);
 			}
 		}
-		return ew::Mesh(meshData);
+		return meshData;
 	}
 
 }
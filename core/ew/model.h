@@ -5,14 +5,166 @@
 #pragma once
 #include "mesh.h"
 #include "shader.h"
+#include "meshOptimizer.h"
+#include "camera.h"
+#include "meshCache.h"
+#include "jobSystem.h"
 #include <vector>
 
 namespace ew {
-	class Model {
+	struct ModelLoadOptions {
+		bool optimizeMeshes = false; //Reorder each mesh for the vertex cache, overdraw and vertex fetch
+		std::vector<float> lodRatios; //Triangle ratio of each simplified level after the full mesh, e.g. {0.5, 0.25}
+		bool useMeshCache = false; //Load from a cooked file next to the source if it is up to date, otherwise import and write one
+		bool useObjReader = false; //Read .obj files with loadObj instead of Assimp. All of the file becomes one mesh.
+		bool verbose = false; //Print each mesh's optimization report and LOD triangle counts as it is processed
+	};
+
+	//Where a model's meshes came from
+	enum class ModelSource {
+		NONE = 0, //Not loaded, or the import failed
+		ASSIMP = 1,
+		OBJ_READER = 2,
+		COOKED_CACHE = 3
+	};
+	const char* getModelSourceName(ModelSource source);
+	//The importer loadModelMeshData uses for filePath, ASSIMP or OBJ_READER
+	ModelSource getModelImporter(const std::string& filePath, const ModelLoadOptions& options);
+
+	//Imports every mesh in a file with Assimp, or loadObj for .obj files, and applies the load options. Meshes are processed as jobs if jobs is not null.
+	//Optimization reports are appended to reports if not null.
+	std::vector<MeshData> loadModelMeshData(const std::string& filePath, const ModelLoadOptions& options,
+		std::vector<MeshOptimizationReport>* reports = nullptr, JobSystem* jobs = nullptr);
+
+	//Cache key for a model file loaded with options into a vertex layout. Returns false if the source cannot be read.
+	bool makeModelCacheKey(const std::string& filePath, const ModelLoadOptions& options,
+		const VertexAttribute* attributes, int numAttributes, unsigned int vertexSize, MeshCacheKey* key);
+
+	//The CPU half of loading a model: maps an up to date cooked file, or imports with Assimp, encodes to the layout
+	//and writes the cooked file. Does no GL calls, so it can run on any thread.
+	//Mesh views point into the mapping or into encoded data owned by this object.
+	template<class Layout>
+	class ModelImport {
+	public:
+		typedef typename Layout::VertexType VertexType;
+
+		//False if the file could not be imported or has no meshes
+		bool run(const std::string& filePath, const ModelLoadOptions& options, JobSystem* jobs = nullptr) {
+			MeshCacheKey key;
+			bool cacheable = options.useMeshCache && makeModelCacheKey(filePath, options,
+				Layout::attributes(), Layout::NUM_ATTRIBUTES, sizeof(VertexType), &key);
+			std::string cookedPath = cacheable ? getCookedPath(filePath, key) : std::string();
+			if (cacheable && m_cookedFile.open(cookedPath, key)) {
+				for (size_t i = 0; i < m_cookedFile.getNumMeshes(); i++)
+				{
+					m_meshes.push_back(m_cookedFile.getMesh(i));
+					if (m_meshes.back().hasReport) {
+						m_reports.push_back(m_meshes.back().report);
+					}
+				}
+				m_source = ModelSource::COOKED_CACHE;
+				return true;
+			}
+
+			//Cache miss, import and cook the result
+			std::vector<MeshData> meshData = loadModelMeshData(filePath, options, &m_reports, jobs);
+			if (meshData.empty()) {
+				return false;
+			}
+			m_encoded.resize(meshData.size());
+			m_meshes.resize(meshData.size());
+			for (size_t i = 0; i < meshData.size(); i++)
+			{
+				m_encoded[i] = encodeMeshData<Layout>(meshData[i]);
+				const BasicMeshData<VertexType>& encoded = m_encoded[i];
+				CookedMesh& cooked = m_meshes[i];
+				cooked.vertices = encoded.vertices.data();
+				cooked.numVertices = (unsigned int)encoded.vertices.size();
+				cooked.vertexSize = sizeof(VertexType);
+				cooked.indices = encoded.indices.data();
+				cooked.numIndices = (unsigned int)encoded.indices.size();
+				cooked.indexType = encoded.indices.getType();
+				cooked.lods = encoded.lods.data();
+				cooked.numLods = (unsigned int)encoded.lods.size();
+				cooked.hasReport = i < m_reports.size();
+				if (cooked.hasReport) {
+					cooked.report = m_reports[i];
+				}
+			}
+			if (cacheable) {
+				writeCookedModel(cookedPath, key, m_meshes);
+			}
+			m_source = getModelImporter(filePath, options);
+			return true;
+		}
+		inline const std::vector<CookedMesh>& getMeshes()const { return m_meshes; }
+		inline const std::vector<MeshOptimizationReport>& getReports()const { return m_reports; }
+		inline ModelSource getSource()const { return m_source; }
+	private:
+		CookedModelFile m_cookedFile;
+		std::vector<BasicMeshData<VertexType>> m_encoded;
+		std::vector<CookedMesh> m_meshes;
+		std::vector<MeshOptimizationReport> m_reports;
+		ModelSource m_source = ModelSource::NONE;
+	};
+
+	template<class Layout>
+	class BasicModel {
 	public:
-		Model(const std::string& filePath);
-		void draw();
+		typedef typename Layout::VertexType VertexType;
+
+		//Empty, meshes are added by ModelLoader as they upload
+		BasicModel() {};
+		BasicModel(const std::string& filePath, const ModelLoadOptions& options = ModelLoadOptions()) {
+			ModelImport<Layout> import;
+			import.run(filePath, options);
+			for (size_t i = 0; i < import.getMeshes().size(); i++)
+			{
+				addMesh(import.getMeshes()[i]);
+			}
+			m_optimizationReports = import.getReports();
+			m_source = import.getSource();
+		}
+		//Uploads one mesh straight from its imported or mapped memory. GL thread only.
+		void addMesh(const CookedMesh& mesh) {
+			m_meshes.push_back(BasicMesh<Layout>());
+			m_meshes.back().load((const VertexType*)mesh.vertices, mesh.numVertices, mesh.indices, mesh.numIndices,
+				mesh.indexType, mesh.lods, mesh.numLods);
+		}
+		inline void setOptimizationReports(const std::vector<MeshOptimizationReport>& reports) { m_optimizationReports = reports; }
+		inline void setSource(ModelSource source) { m_source = source; }
+		void draw() {
+			for (size_t i = 0; i < m_meshes.size(); i++)
+			{
+				m_meshes[i].draw();
+			}
+		}
+		//Draws each mesh at the level of detail picked from its projected size
+		void draw(const Camera& camera, const glm::mat4& modelMatrix, float maxScreenError = 0.001f) {
+			for (size_t i = 0; i < m_meshes.size(); i++)
+			{
+				m_meshes[i].draw(camera, modelMatrix, maxScreenError);
+			}
+		}
+		void drawInstanced(unsigned int instanceCount)const {
+			for (size_t i = 0; i < m_meshes.size(); i++)
+			{
+				m_meshes[i].drawInstanced(instanceCount);
+			}
+		}
+		inline size_t getNumMeshes()const { return m_meshes.size(); }
+		inline const BasicMesh<Layout>& getMesh(size_t index)const { return m_meshes[index]; }
+		//One report per mesh, empty unless optimizeMeshes was set
+		inline const std::vector<MeshOptimizationReport>& getOptimizationReports()const { return m_optimizationReports; }
+		//True if the meshes came from a cooked file instead of Assimp
+		inline ModelSource getSource()const { return m_source; }
+		inline bool wasLoadedFromCache()const { return m_source == ModelSource::COOKED_CACHE; }
 	private:
-		std::vector<ew::Mesh> m_meshes;
+		std::vector<BasicMesh<Layout>> m_meshes;
+		std::vector<MeshOptimizationReport> m_optimizationReports;
+		ModelSource m_source = ModelSource::NONE;
 	};
+
+	typedef BasicModel<StandardLayout> Model;
+	typedef BasicModel<CompactLayout> CompactModel;
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#pragma once
+#include "model.h"
+#include "jobSystem.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <stdio.h>
+
+namespace ew {
+	enum class ModelLoadState {
+		IMPORTING = 0, //Parsing and converting in a background task
+		UPLOADING = 1, //Waiting for, or partway through, uploads on the GL thread
+		READY = 2,
+		FAILED = 3 //The import failed, the model stays empty
+	};
+
+	//Shared between a loader and the handles it gave out
+	template<class Layout>
+	struct PendingModel {
+		std::string filePath;
+		ModelLoadOptions options;
+		std::atomic<int> state{ (int)ModelLoadState::IMPORTING };
+		std::unique_ptr<ModelImport<Layout>> import;
+		BasicModel<Layout> model;
+		size_t numUploaded = 0;
+		std::chrono::high_resolution_clock::time_point startTime;
+	};
+
+	//A model that may still be loading. Copies refer to the same model.
+	template<class Layout>
+	class BasicModelHandle {
+	public:
+		BasicModelHandle() {};
+		BasicModelHandle(const std::shared_ptr<PendingModel<Layout>>& pending) : m_pending(pending) {}
+
+		inline bool isValid()const { return m_pending != nullptr; }
+		inline ModelLoadState getState()const { return (ModelLoadState)m_pending->state.load(std::memory_order_acquire); }
+		inline bool isReady()const { return isValid() && getState() == ModelLoadState::READY; }
+		inline bool isFailed()const { return isValid() && getState() == ModelLoadState::FAILED; }
+		//nullptr until every mesh has been uploaded, and for good if the import failed
+		inline BasicModel<Layout>* get()const { return isReady() ? &m_pending->model : nullptr; }
+
+		//All draw nothing until the model is ready
+		void draw()const {
+			if (isReady()) {
+				m_pending->model.draw();
+			}
+		}
+		void draw(const Camera& camera, const glm::mat4& modelMatrix, float maxScreenError = 0.001f)const {
+			if (isReady()) {
+				m_pending->model.draw(camera, modelMatrix, maxScreenError);
+			}
+		}
+		void drawInstanced(unsigned int instanceCount)const {
+			if (isReady()) {
+				m_pending->model.drawInstanced(instanceCount);
+			}
+		}
+	private:
+		std::shared_ptr<PendingModel<Layout>> m_pending;
+	};
+
+	//Loads models in the background. Import and conversion run as JobSystem background tasks, each model's meshes
+	//converting in parallel. Finished imports queue up for the GL thread, which uploads them in update().
+	template<class Layout>
+	class BasicModelLoader {
+	public:
+		//uploadBudgetMs is how long update() may spend uploading per frame. At least one mesh is uploaded per call.
+		BasicModelLoader(JobSystem* jobs, float uploadBudgetMs = 2.0f)
+			: m_jobs(jobs), m_uploadBudgetMs(uploadBudgetMs), m_queue(std::make_shared<UploadQueue>()) {}
+
+		BasicModelHandle<Layout> load(const std::string& filePath, const ModelLoadOptions& options = ModelLoadOptions()) {
+			std::shared_ptr<PendingModel<Layout>> pending = std::make_shared<PendingModel<Layout>>();
+			pending->filePath = filePath;
+			pending->options = options;
+			pending->import.reset(new ModelImport<Layout>());
+			pending->startTime = std::chrono::high_resolution_clock::now();
+			m_numInFlight++;
+
+			//The task holds the queue, so it stays valid if the loader goes away first
+			std::shared_ptr<UploadQueue> queue = m_queue;
+			JobSystem* jobs = m_jobs;
+			m_jobs->submitBackground([pending, queue, jobs] {
+				bool imported = pending->import->run(pending->filePath, pending->options, jobs);
+				pending->state.store((int)(imported ? ModelLoadState::UPLOADING : ModelLoadState::FAILED), std::memory_order_release);
+				std::lock_guard<std::mutex> lock(queue->mutex);
+				queue->models.push_back(pending);
+			});
+			return BasicModelHandle<Layout>(pending);
+		}
+
+		//Call once per frame on the GL thread
+		void update() {
+			auto start = std::chrono::high_resolution_clock::now();
+			{
+				std::lock_guard<std::mutex> lock(m_queue->mutex);
+				m_uploading.insert(m_uploading.end(), m_queue->models.begin(), m_queue->models.end());
+				m_queue->models.clear();
+			}
+			m_meshesUploadedLastFrame = 0;
+			while (!m_uploading.empty()) {
+				PendingModel<Layout>& pending = *m_uploading.front();
+				if (pending.state.load(std::memory_order_acquire) == (int)ModelLoadState::FAILED) {
+					printf("Failed to load %s with %s\n", pending.filePath.c_str(),
+						getModelSourceName(getModelImporter(pending.filePath, pending.options)));
+					pending.import.reset();
+					m_uploading.pop_front();
+					m_numInFlight--;
+					continue;
+				}
+				const std::vector<CookedMesh>& meshes = pending.import->getMeshes();
+				if (pending.numUploaded < meshes.size()) {
+					pending.model.addMesh(meshes[pending.numUploaded++]);
+					m_meshesUploadedLastFrame++;
+				}
+				if (pending.numUploaded == meshes.size()) {
+					pending.model.setOptimizationReports(pending.import->getReports());
+					pending.model.setSource(pending.import->getSource());
+					//Frees the CPU copy of the meshes, or unmaps the cooked file
+					pending.import.reset();
+					pending.state.store((int)ModelLoadState::READY, std::memory_order_release);
+					printf("Loaded %s from %s in %.3fms\n", pending.filePath.c_str(), getModelSourceName(pending.model.getSource()),
+						std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - pending.startTime).count());
+					m_uploading.pop_front();
+					m_numInFlight--;
+				}
+				if (std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= m_uploadBudgetMs) {
+					break;
+				}
+			}
+			m_lastUpdateMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		inline void setUploadBudget(float uploadBudgetMs) { m_uploadBudgetMs = uploadBudgetMs; }
+		inline float getUploadBudget()const { return m_uploadBudgetMs; }
+		//Models that are not ready or failed yet
+		inline unsigned int getNumInFlight()const { return m_numInFlight; }
+		inline unsigned int getMeshesUploadedLastFrame()const { return m_meshesUploadedLastFrame; }
+		inline float getLastUpdateMs()const { return m_lastUpdateMs; }
+	private:
+		struct UploadQueue {
+			std::mutex mutex;
+			std::deque<std::shared_ptr<PendingModel<Layout>>> models;
+		};
+
+		JobSystem* m_jobs;
+		float m_uploadBudgetMs;
+		std::shared_ptr<UploadQueue> m_queue;
+		std::deque<std::shared_ptr<PendingModel<Layout>>> m_uploading;
+		unsigned int m_numInFlight = 0;
+		unsigned int m_meshesUploadedLastFrame = 0;
+		float m_lastUpdateMs = 0.0f;
+	};
+
+	typedef BasicModelHandle<StandardLayout> ModelHandle;
+	typedef BasicModelHandle<CompactLayout> CompactModelHandle;
+	typedef BasicModelLoader<StandardLayout> ModelLoader;
+	typedef BasicModelLoader<CompactLayout> CompactModelLoader;
+}
@@ -0,0 +1,459 @@
+#include "objLoader.h"
+#include "mappedFile.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	//0-based indices, -1 if the corner has no texture coordinate or normal
+	struct ObjCorner {
+		int v;
+		int vt;
+		int vn;
+	};
+
+	//A negative index is relative to the vertices read so far. Corners using one store an index local to the
+	//chunk and are patched once the chunk's base is known.
+	struct ObjRelativeIndex {
+		unsigned int corner;
+		int component;
+	};
+
+	struct ObjChunk {
+		const char* begin;
+		const char* end;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+		std::vector<glm::vec3> normals;
+		std::vector<ObjCorner> corners; //3 per triangle
+		std::vector<ObjRelativeIndex> relativeIndices;
+		unsigned int lineError = 0; //Line in the chunk of the first error, 1-based
+	};
+
+	static const double POWERS_OF_TEN[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	static inline bool isDigit(char c) {
+		return (unsigned char)(c - '0') < 10;
+	}
+
+	static inline bool isSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	//Reads 8 ASCII digits at once as a 64 bit integer. From "Fast numerical parsing" (Lemire), SWAR variant.
+	static inline bool parseEightDigits(const char* p, uint64_t* value) {
+		uint64_t chunk;
+		memcpy(&chunk, p, sizeof(chunk));
+		//Every byte must be '0'-'9'
+		if ((((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) != 0x3333333333333333ull)) {
+			return false;
+		}
+		chunk -= 0x3030303030303030ull;
+		chunk = (chunk * 10) + (chunk >> 8);
+		chunk = (((chunk & 0x000000FF000000FFull) * 0x000F424000000064ull)
+			+ (((chunk >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) >> 32;
+		*value = (uint32_t)chunk;
+		return true;
+	}
+
+	//Appends digits to mantissa, counting how many were used. Digits past 19 only affect the exponent.
+	static inline const char* parseDigits(const char* p, const char* end, uint64_t* mantissa, int* numDigits, int* droppedDigits) {
+		while (end - p >= 8 && *numDigits + 8 <= 19) {
+			uint64_t eight;
+			if (!parseEightDigits(p, &eight)) {
+				break;
+			}
+			*mantissa = *mantissa * 100000000ull + eight;
+			*numDigits += 8;
+			p += 8;
+		}
+		while (p < end && isDigit(*p)) {
+			if (*numDigits < 19) {
+				*mantissa = *mantissa * 10 + (uint64_t)(*p - '0');
+				*numDigits += *mantissa != 0 ? 1 : 0;
+			}
+			else {
+				(*droppedDigits)++;
+			}
+			p++;
+		}
+		return p;
+	}
+
+	const char* parseFloat(const char* p, const char* end, float* value)
+	{
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		uint64_t mantissa = 0;
+		int numDigits = 0;
+		int droppedDigits = 0;
+		const char* digitsStart = p;
+		p = parseDigits(p, end, &mantissa, &numDigits, &droppedDigits);
+		int exponent = droppedDigits;
+		bool anyDigits = p != digitsStart;
+		if (p < end && *p == '.') {
+			p++;
+			const char* fractionStart = p;
+			int fractionDropped = 0;
+			p = parseDigits(p, end, &mantissa, &numDigits, &fractionDropped);
+			anyDigits = anyDigits || p != fractionStart;
+			//Every fraction digit that made it into the mantissa shifts it one place
+			exponent -= (int)(p - fractionStart) - fractionDropped;
+		}
+		if (!anyDigits) {
+			return start;
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char* exponentStart = p;
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negativeExponent = *p == '-';
+				p++;
+			}
+			if (p < end && isDigit(*p)) {
+				int e = 0;
+				while (p < end && isDigit(*p)) {
+					e = e < 10000 ? e * 10 + (*p - '0') : e;
+					p++;
+				}
+				exponent += negativeExponent ? -e : e;
+			}
+			else {
+				p = exponentStart;
+			}
+		}
+
+		double result = (double)mantissa;
+		if (exponent < 0) {
+			while (exponent < -22) {
+				result /= 1e22;
+				exponent += 22;
+			}
+			result /= POWERS_OF_TEN[-exponent];
+		}
+		else {
+			while (exponent > 22) {
+				result *= 1e22;
+				exponent -= 22;
+			}
+			result *= POWERS_OF_TEN[exponent];
+		}
+		*value = (float)(negative ? -result : result);
+		return p;
+	}
+
+	static inline const char* parseInt(const char* p, const char* end, int* value) {
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		const char* start = p;
+		int result = 0;
+		while (p < end && isDigit(*p)) {
+			result = result * 10 + (*p - '0');
+			p++;
+		}
+		if (p == start) {
+			return nullptr;
+		}
+		*value = negative ? -result : result;
+		return p;
+	}
+
+	static inline const char* skipSpaces(const char* p, const char* end) {
+		while (p < end && isSpace(*p)) {
+			p++;
+		}
+		return p;
+	}
+
+	//Returns the number of floats read, up to count
+	static inline int parseFloats(const char* p, const char* end, float* values, int count) {
+		for (int i = 0; i < count; i++)
+		{
+			p = skipSpaces(p, end);
+			const char* next = parseFloat(p, end, &values[i]);
+			if (next == p) {
+				return i;
+			}
+			p = next;
+		}
+		return count;
+	}
+
+	//Converts a 1-based or negative OBJ index to 0-based. Negative ones become local to the chunk.
+	static inline int resolveIndex(ObjChunk& chunk, int index, size_t localCount, int component) {
+		if (index > 0) {
+			return index - 1;
+		}
+		chunk.relativeIndices.push_back({ (unsigned int)chunk.corners.size(), component });
+		return (int)localCount + index;
+	}
+
+	static bool parseFace(ObjChunk& chunk, const char* p, const char* end) {
+		ObjCorner first = {};
+		ObjCorner previous = {};
+		int numCorners = 0;
+		while (true) {
+			p = skipSpaces(p, end);
+			if (p >= end) {
+				break;
+			}
+			ObjCorner corner = { -1, -1, -1 };
+			int index;
+			p = parseInt(p, end, &index);
+			if (p == nullptr || index == 0) {
+				return false;
+			}
+			corner.v = index;
+			if (p < end && *p == '/') {
+				p++;
+				if (p < end && *p != '/') {
+					p = parseInt(p, end, &index);
+					if (p == nullptr || index == 0) {
+						return false;
+					}
+					corner.vt = index;
+				}
+				if (p < end && *p == '/') {
+					p++;
+					p = parseInt(p, end, &index);
+					if (p == nullptr || index == 0) {
+						return false;
+					}
+					corner.vn = index;
+				}
+			}
+
+			//Corners are resolved as they are emitted so relative indices know which corner to patch
+			if (numCorners >= 2) {
+				//Fan: first, previous, current
+				ObjCorner triangle[3] = { first, previous, corner };
+				for (int c = 0; c < 3; c++)
+				{
+					ObjCorner resolved;
+					resolved.v = resolveIndex(chunk, triangle[c].v, chunk.positions.size(), 0);
+					resolved.vt = triangle[c].vt == -1 ? -1 : resolveIndex(chunk, triangle[c].vt, chunk.texCoords.size(), 1);
+					resolved.vn = triangle[c].vn == -1 ? -1 : resolveIndex(chunk, triangle[c].vn, chunk.normals.size(), 2);
+					chunk.corners.push_back(resolved);
+				}
+			}
+			if (numCorners == 0) {
+				first = corner;
+			}
+			previous = corner;
+			numCorners++;
+		}
+		return numCorners >= 3;
+	}
+
+	static void parseChunk(ObjChunk& chunk) {
+		const char* p = chunk.begin;
+		unsigned int line = 0;
+		while (p < chunk.end) {
+			const char* lineEnd = (const char*)memchr(p, '\n', chunk.end - p);
+			if (lineEnd == nullptr) {
+				lineEnd = chunk.end;
+			}
+			line++;
+			p = skipSpaces(p, lineEnd);
+			bool ok = true;
+			if (lineEnd - p >= 2 && p[0] == 'v' && isSpace(p[1])) {
+				float values[3];
+				ok = parseFloats(p + 2, lineEnd, values, 3) == 3;
+				chunk.positions.push_back(glm::vec3(values[0], values[1], values[2]));
+			}
+			else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+				float values[2] = { 0.0f, 0.0f };
+				ok = parseFloats(p + 3, lineEnd, values, 2) >= 1;
+				chunk.texCoords.push_back(glm::vec2(values[0], values[1]));
+			}
+			else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+				float values[3];
+				ok = parseFloats(p + 3, lineEnd, values, 3) == 3;
+				chunk.normals.push_back(glm::vec3(values[0], values[1], values[2]));
+			}
+			else if (lineEnd - p >= 2 && p[0] == 'f' && isSpace(p[1])) {
+				ok = parseFace(chunk, p + 2, lineEnd);
+			}
+			if (!ok) {
+				chunk.lineError = line;
+				return;
+			}
+			p = lineEnd + 1;
+		}
+	}
+
+	static inline uint32_t hashCorner(const ObjCorner& corner) {
+		uint32_t h = (uint32_t)corner.v * 0x9E3779B1u;
+		h ^= (uint32_t)corner.vt * 0x85EBCA77u + (h << 6) + (h >> 2);
+		h ^= (uint32_t)corner.vn * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+		return h ^ (h >> 15);
+	}
+
+	bool parseObj(const char* text, size_t size, MeshData* meshData, JobSystem* jobs)
+	{
+		//Split into line ranges of at least 1MB each
+		const size_t minChunkSize = 1 << 20;
+		size_t numChunks = jobs != nullptr ? jobs->getNumThreads() : 1;
+		while (numChunks > 1 && size / numChunks < minChunkSize) {
+			numChunks--;
+		}
+		std::vector<ObjChunk> chunks(numChunks);
+		const char* begin = text;
+		const char* end = text + size;
+		for (size_t i = 0; i < numChunks; i++)
+		{
+			const char* chunkEnd = i + 1 == numChunks ? end : text + size * (i + 1) / numChunks;
+			if (chunkEnd < begin) {
+				chunkEnd = begin;
+			}
+			const char* newline = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+			chunkEnd = newline != nullptr && i + 1 < numChunks ? newline + 1 : end;
+			chunks[i].begin = begin;
+			chunks[i].end = chunkEnd;
+			begin = chunkEnd;
+		}
+
+		if (jobs != nullptr && numChunks > 1) {
+			jobs->parallelForEach((unsigned int)numChunks, [&](unsigned int i) { parseChunk(chunks[i]); });
+		}
+		else {
+			for (size_t i = 0; i < numChunks; i++)
+			{
+				parseChunk(chunks[i]);
+			}
+		}
+
+		//Concatenate attributes and make chunk local indices global
+		size_t numPositions = 0, numTexCoords = 0, numNormals = 0, numCorners = 0;
+		unsigned int linesBefore = 0;
+		for (size_t i = 0; i < numChunks; i++)
+		{
+			ObjChunk& chunk = chunks[i];
+			if (chunk.lineError != 0) {
+				//Count lines in earlier chunks only on failure
+				for (size_t j = 0; j < i; j++)
+				{
+					for (const char* c = chunks[j].begin; c < chunks[j].end; c++)
+					{
+						linesBefore += *c == '\n' ? 1 : 0;
+					}
+				}
+				printf("Failed to parse OBJ line %u\n", linesBefore + chunk.lineError);
+				return false;
+			}
+			int base[3] = { (int)numPositions, (int)numTexCoords, (int)numNormals };
+			for (size_t r = 0; r < chunk.relativeIndices.size(); r++)
+			{
+				ObjCorner& corner = chunk.corners[chunk.relativeIndices[r].corner];
+				int* indices = &corner.v;
+				indices[chunk.relativeIndices[r].component] += base[chunk.relativeIndices[r].component];
+			}
+			numPositions += chunk.positions.size();
+			numTexCoords += chunk.texCoords.size();
+			numNormals += chunk.normals.size();
+			numCorners += chunk.corners.size();
+		}
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+		std::vector<glm::vec3> normals;
+		positions.reserve(numPositions);
+		texCoords.reserve(numTexCoords);
+		normals.reserve(numNormals);
+		for (size_t i = 0; i < numChunks; i++)
+		{
+			positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+			texCoords.insert(texCoords.end(), chunks[i].texCoords.begin(), chunks[i].texCoords.end());
+			normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+			chunks[i].positions = std::vector<glm::vec3>();
+			chunks[i].texCoords = std::vector<glm::vec2>();
+			chunks[i].normals = std::vector<glm::vec3>();
+		}
+
+		//Deduplicate v/vt/vn triplets with an open addressing table, kept at most half full
+		const uint32_t empty = 0xffffffffu;
+		size_t capacity = 64;
+		while (capacity < numPositions * 2) {
+			capacity *= 2;
+		}
+		std::vector<uint32_t> table(capacity, empty);
+		std::vector<ObjCorner> unique;
+		unique.reserve(numPositions);
+		meshData->vertices.clear();
+		meshData->indices.clear();
+		meshData->lods.clear();
+		meshData->indices.reserve(numCorners);
+		for (size_t i = 0; i < numChunks; i++)
+		{
+			const std::vector<ObjCorner>& corners = chunks[i].corners;
+			for (size_t c = 0; c < corners.size(); c++)
+			{
+				const ObjCorner& corner = corners[c];
+				if (corner.v < 0 || (size_t)corner.v >= numPositions || corner.vt >= (int)numTexCoords || corner.vn >= (int)numNormals
+					|| corner.vt < -1 || corner.vn < -1) {
+					printf("OBJ face index out of range\n");
+					return false;
+				}
+				if (unique.size() * 2 >= capacity) {
+					capacity *= 2;
+					table.assign(capacity, empty);
+					for (uint32_t u = 0; u < unique.size(); u++)
+					{
+						size_t slot = hashCorner(unique[u]) & (capacity - 1);
+						while (table[slot] != empty) {
+							slot = (slot + 1) & (capacity - 1);
+						}
+						table[slot] = u;
+					}
+				}
+				size_t slot = hashCorner(corner) & (capacity - 1);
+				while (table[slot] != empty) {
+					const ObjCorner& other = unique[table[slot]];
+					if (other.v == corner.v && other.vt == corner.vt && other.vn == corner.vn) {
+						break;
+					}
+					slot = (slot + 1) & (capacity - 1);
+				}
+				if (table[slot] == empty) {
+					table[slot] = (uint32_t)unique.size();
+					unique.push_back(corner);
+				}
+				meshData->indices.push_back(table[slot]);
+			}
+		}
+
+		meshData->vertices.resize(unique.size());
+		for (size_t i = 0; i < unique.size(); i++)
+		{
+			Vertex& vertex = meshData->vertices[i];
+			vertex.pos = positions[unique[i].v];
+			vertex.uv = unique[i].vt >= 0 ? texCoords[unique[i].vt] : glm::vec2(0);
+			vertex.normal = unique[i].vn >= 0 ? normals[unique[i].vn] : glm::vec3(0);
+		}
+		return true;
+	}
+
+	bool loadObj(const std::string& filePath, MeshData* meshData, JobSystem* jobs)
+	{
+		MappedFile file;
+		if (!file.open(filePath.c_str())) {
+			printf("Failed to open OBJ %s\n", filePath.c_str());
+			return false;
+		}
+		if (!parseObj((const char*)file.getData(), file.getSize(), meshData, jobs)) {
+			printf("Failed to load OBJ %s\n", filePath.c_str());
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "mesh.h"
+#include "jobSystem.h"
+#include <string>
+
+namespace ew {
+	//Reads a Wavefront OBJ into one mesh without going through Assimp.
+	//Supports v, vt, vn and f with any of the v, v/vt, v//vn and v/vt/vn forms, including negative indices.
+	//Polygons are fan triangulated. Objects, groups, smoothing groups and materials are ignored.
+	//The file is memory mapped and split into line ranges that parse as jobs if jobs is not null.
+	//Returns false and prints the error if the file can't be read or is malformed.
+	bool loadObj(const std::string& filePath, MeshData* meshData, JobSystem* jobs = nullptr);
+
+	//Same as loadObj, from OBJ text already in memory
+	bool parseObj(const char* text, size_t size, MeshData* meshData, JobSystem* jobs = nullptr);
+
+	//Parses a decimal float such as -1.5e-3 starting at p, stopping at end. Returns the character after it,
+	//or p if there was no number.
+	const char* parseFloat(const char* p, const char* end, float* value);
+}
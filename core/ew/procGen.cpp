@@ -3,6 +3,7 @@
 */
 
 #include "procGen.h"
+#include "meshOptimizer.h"
 #include <stdlib.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
@@ -48,7 +49,8 @@ namespace ew {
 	/// </summary>
 	/// <param name="size">Total width, height, depth</param>
 	/// <param name="mesh">MeshData struct to fill. Will be cleared.</param>
-	MeshData createCube(float size) {
+	/// <param name="optimize">Reorder for the vertex cache, overdraw and vertex fetch</param>
+	MeshData createCube(float size, bool optimize) {
 		MeshData mesh;
 		mesh.vertices.reserve(24); //6 x 4 vertices
 		mesh.indices.reserve(36); //6 x 6 indices
@@ -58,9 +60,12 @@ namespace ew {
 		createCubeFace(vec3{ -1.0f,+0.0f,+0.0f }, size, &mesh); //Left
 		createCubeFace(vec3{ +0.0f,-1.0f,+0.0f }, size, &mesh); //Bottom
 		createCubeFace(vec3{ +0.0f,+0.0f,-1.0f }, size, &mesh); //Back
+		if (optimize) {
+			optimizeMesh(&mesh);
+		}
 		return mesh;
 	}
-	MeshData createPlane(float width, float height, int subdivisions)
+	MeshData createPlane(float width, float height, int subdivisions, bool optimize)
 	{
 		//VERTICES
 		MeshData mesh;
@@ -93,9 +98,12 @@ namespace ew {
 				mesh.indices.push_back(start);
 			}
 		}
+		if (optimize) {
+			optimizeMesh(&mesh);
+		}
 		return mesh;
 	}
-	MeshData createSphere(float radius, int subdivisions)
+	MeshData createSphere(float radius, int subdivisions, bool optimize)
 	{
 		MeshData mesh;
 		//VERTICES
@@ -152,6 +160,9 @@ namespace ew {
 			mesh.indices.push_back(sideStart + i + 1);
 			mesh.indices.push_back(poleStart + i);
 		}
+		if (optimize) {
+			optimizeMesh(&mesh);
+		}
 		return mesh;
 	}
 	void createCylinderRing(MeshData* meshData, float radius, int subdivisions, float y, bool sideFacing) {
@@ -175,7 +186,7 @@ namespace ew {
 			meshData->vertices.push_back(v);
 		}
 	}
-	MeshData createCylinder(float radius, float height, int subdivisions)
+	MeshData createCylinder(float radius, float height, int subdivisions, bool optimize)
 	{
 		MeshData mesh;
 
@@ -235,6 +246,9 @@ namespace ew {
 				mesh.indices.push_back(sideStart + i + 1);
 			}
 		}
+		if (optimize) {
+			optimizeMesh(&mesh);
+		}
 		return mesh;
 	}
 }
\ No newline at end of file
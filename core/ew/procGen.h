@@ -6,8 +6,9 @@
 #include "mesh.h"
 
 namespace ew {
-	MeshData createCube(float size);
-	MeshData createPlane(float width, float height, int subdivisions);
-	MeshData createSphere(float radius, int subdivisions);
-	MeshData createCylinder(float radius, float height, int subdivisions);
+	//optimize runs ew::optimizeMesh on the result
+	MeshData createCube(float size, bool optimize = false);
+	MeshData createPlane(float width, float height, int subdivisions, bool optimize = false);
+	MeshData createSphere(float radius, int subdivisions, bool optimize = false);
+	MeshData createCylinder(float radius, float height, int subdivisions, bool optimize = false);
 }
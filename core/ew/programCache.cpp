@@ -0,0 +1,126 @@
+#include "programCache.h"
+#include "meshCache.h"
+#include "mappedFile.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	static const char PROGRAM_MAGIC[4] = { 'E', 'W', 'P', 'B' };
+	static const uint32_t PROGRAM_VERSION = 1;
+
+	struct ProgramFileHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		float buildMs;
+		uint64_t size;
+	};
+
+	uint64_t getDriverHash()
+	{
+		const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		std::string driver;
+		for (int i = 0; i < 3; i++)
+		{
+			const char* value = (const char*)glGetString(names[i]);
+			driver += value != NULL ? value : "";
+			driver += '\n';
+		}
+		return hashBytes(driver.data(), driver.size());
+	}
+
+	bool areProgramBinariesSupported()
+	{
+		int numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		return numFormats > 0;
+	}
+
+	std::string getProgramBinaryPath(const std::string& sourcePath, uint64_t identity)
+	{
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%016llx.ewprog", (unsigned long long)identity);
+		return sourcePath + suffix;
+	}
+
+	bool readProgramBinary(const std::string& filePath, uint64_t key, ProgramBinary* binary)
+	{
+		MappedFile file;
+		if (!file.open(filePath.c_str())) {
+			return false;
+		}
+		ProgramFileHeader header;
+		if (file.getSize() < sizeof(header)) {
+			return false;
+		}
+		memcpy(&header, file.getData(), sizeof(header));
+		if (memcmp(header.magic, PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC)) != 0 || header.version != PROGRAM_VERSION
+			|| header.key != key || header.size == 0 || header.size != file.getSize() - sizeof(header)) {
+			return false;
+		}
+		binary->format = header.format;
+		binary->buildMs = header.buildMs;
+		binary->data.assign(file.getData() + sizeof(header), file.getData() + file.getSize());
+		return true;
+	}
+
+	bool writeProgramBinary(const std::string& filePath, uint64_t key, const ProgramBinary& binary)
+	{
+		ProgramFileHeader header;
+		memcpy(header.magic, PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC));
+		header.version = PROGRAM_VERSION;
+		header.key = key;
+		header.format = binary.format;
+		header.buildMs = binary.buildMs;
+		header.size = binary.data.size();
+
+		//Write to a temporary file first so a crash never leaves a half written binary behind
+		std::string tempPath = filePath + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write program binary %s\n", filePath.c_str());
+			return false;
+		}
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = ok && fwrite(binary.data.data(), 1, binary.data.size(), file) == binary.data.size();
+		ok = fclose(file) == 0 && ok;
+
+		remove(filePath.c_str());
+		if (!ok || rename(tempPath.c_str(), filePath.c_str()) != 0) {
+			printf("Failed to write program binary %s\n", filePath.c_str());
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	unsigned int loadProgramBinary(const ProgramBinary& binary)
+	{
+		unsigned int program = glCreateProgram();
+		glProgramBinary(program, binary.format, binary.data.data(), (GLsizei)binary.data.size());
+		int success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	bool getProgramBinary(unsigned int program, ProgramBinary* binary)
+	{
+		int length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return false;
+		}
+		binary->data.resize(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary->data.data());
+		binary->data.resize(length);
+		binary->format = format;
+		return length > 0;
+	}
+}
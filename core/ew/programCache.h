@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace ew {
+	//A linked program as the driver hands it out through glGetProgramBinary
+	struct ProgramBinary {
+		unsigned int format = 0;
+		std::vector<unsigned char> data;
+		float buildMs = 0.0f; //How long compiling and linking from source took, to report what loading it saves
+	};
+
+	//Hash of GL_VENDOR, GL_RENDERER and GL_VERSION. Binaries only load on the driver that wrote them, so this is
+	//part of every key. Needs a current context.
+	uint64_t getDriverHash();
+	//False if the driver offers no binary formats, as some software drivers do. Needs a current context.
+	bool areProgramBinariesSupported();
+
+	//Where the binary of a program lives, next to sourcePath. identity names the program, not its contents, so a
+	//rebuild after an edit or a driver update overwrites the old binary instead of adding another file.
+	std::string getProgramBinaryPath(const std::string& sourcePath, uint64_t identity);
+	//Returns false on a missing or corrupt file, or one written for a different key
+	bool readProgramBinary(const std::string& filePath, uint64_t key, ProgramBinary* binary);
+	bool writeProgramBinary(const std::string& filePath, uint64_t key, const ProgramBinary& binary);
+
+	//Creates a program from a binary. Returns 0 if the driver rejects it, which it may do after any update.
+	unsigned int loadProgramBinary(const ProgramBinary& binary);
+	//Only works for programs linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	bool getProgramBinary(unsigned int program, ProgramBinary* binary);
+}
@@ -3,13 +3,105 @@
 */
 
 #include "shader.h"
+#include "meshCache.h"
+#include "programCache.h"
+#include "fileWatcher.h"
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include "external/glad.h"
+#include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+//GL_KHR_parallel_shader_compile and GL_ARB_parallel_shader_compile are extensions, so glad's core profile header
+//doesn't define them
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (GLAD_API_PTR* MaxShaderCompilerThreadsFunc)(GLuint count);
 
 namespace ew {
+	/// <summary>
+	/// Flat open-addressing hash table of a program's uniforms, filled once at link time.
+	/// Also remembers the last value uploaded to each uniform so redundant uploads can be skipped.
+	/// </summary>
+	struct UniformTable {
+		struct Entry {
+			std::string name;
+			uint32_t hash;
+			int location; //-1 if the name is not an active uniform
+			bool hasValue = false;
+			unsigned int size = 0;
+			unsigned char value[sizeof(glm::mat4)];
+		};
+		std::vector<Entry> entries;
+		std::vector<int> slots; //Index into entries, or -1 if empty. Size is always a power of 2
+		UniformStats stats;
+
+		//FNV-1a
+		static uint32_t hashName(const char* name, size_t length) {
+			uint32_t hash = 2166136261u;
+			for (size_t i = 0; i < length; i++)
+			{
+				hash ^= (unsigned char)name[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+		int find(const char* name, uint32_t hash) const {
+			if (slots.empty()) {
+				return -1;
+			}
+			size_t mask = slots.size() - 1;
+			for (size_t i = hash & mask; ; i = (i + 1) & mask)
+			{
+				int slot = slots[i];
+				if (slot < 0) {
+					return -1;
+				}
+				if (entries[slot].hash == hash && entries[slot].name == name) {
+					return slot;
+				}
+			}
+		}
+		void placeSlot(int slot) {
+			size_t mask = slots.size() - 1;
+			size_t i = entries[slot].hash & mask;
+			while (slots[i] >= 0) {
+				i = (i + 1) & mask;
+			}
+			slots[i] = slot;
+		}
+		int insert(const std::string& name, int location) {
+			uint32_t hash = hashName(name.c_str(), name.size());
+			int existing = find(name.c_str(), hash);
+			if (existing >= 0) {
+				return existing;
+			}
+			//Keep load factor at or below 0.5 so probes stay short
+			if ((entries.size() + 1) * 2 > slots.size()) {
+				slots.assign(slots.empty() ? 16 : slots.size() * 2, -1);
+				for (int i = 0; i < (int)entries.size(); i++)
+				{
+					placeSlot(i);
+				}
+			}
+			Entry entry;
+			entry.name = name;
+			entry.hash = hash;
+			entry.location = location;
+			entries.push_back(entry);
+			placeSlot((int)entries.size() - 1);
+			return (int)entries.size() - 1;
+		}
+	};
+
 	/// <summary>
 	/// Loads shader source code from a file.
 	/// </summary>
@@ -26,19 +118,195 @@ namespace ew {
 		return buffer.str();
 	}
 
+	//Nested deeper than this is almost certainly a cycle
+	static const int MAX_INCLUDE_DEPTH = 32;
+
+	//Removes "." and "dir/.." parts so the same file always gets the same name
+	static std::string normalizePath(const std::string& path) {
+		std::vector<std::string> parts;
+		size_t start = 0;
+		while (start <= path.size()) {
+			size_t end = path.find_first_of("/\\", start);
+			if (end == std::string::npos) {
+				end = path.size();
+			}
+			std::string part = path.substr(start, end - start);
+			if (part == "..") {
+				if (!parts.empty() && parts.back() != "..") {
+					parts.pop_back();
+				}
+				else {
+					parts.push_back(part);
+				}
+			}
+			else if (!part.empty() && part != ".") {
+				parts.push_back(part);
+			}
+			start = end + 1;
+		}
+		std::string result = !path.empty() && (path[0] == '/' || path[0] == '\\') ? "/" : "";
+		for (size_t i = 0; i < parts.size(); i++)
+		{
+			result += (i > 0 ? "/" : "") + parts[i];
+		}
+		return result;
+	}
+
+	//Returns the directive name if line is a preprocessor directive, and where its argument starts
+	static std::string getDirective(const std::string& line, size_t* argument) {
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line[i] != '#') {
+			return {};
+		}
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string::npos) {
+			return {};
+		}
+		size_t end = line.find_first_of(" \t", i);
+		*argument = end == std::string::npos ? line.size() : line.find_first_not_of(" \t", end);
+		if (*argument == std::string::npos) {
+			*argument = line.size();
+		}
+		return line.substr(i, (end == std::string::npos ? line.size() : end) - i);
+	}
+
+	struct Preprocessor {
+		const std::vector<std::string>* defines;
+		std::vector<std::string> files;
+		std::vector<std::string> onceFiles;
+		std::vector<std::string> includeStack;
+		std::string output;
+		bool versionFound = false;
+
+		void addDefines() {
+			for (size_t i = 0; i < defines->size(); i++)
+			{
+				std::string define = (*defines)[i];
+				size_t equals = define.find('=');
+				if (equals != std::string::npos) {
+					define[equals] = ' ';
+				}
+				output += "#define " + define + "\n";
+			}
+		}
+
+		bool appendFile(const std::string& filePath) {
+			std::string path = normalizePath(filePath);
+			for (size_t i = 0; i < onceFiles.size(); i++)
+			{
+				if (onceFiles[i] == path) {
+					return true;
+				}
+			}
+			for (size_t i = 0; i < includeStack.size(); i++)
+			{
+				if (includeStack[i] == path) {
+					printf("Shader include cycle through %s\n", path.c_str());
+					return false;
+				}
+			}
+			if (includeStack.size() >= MAX_INCLUDE_DEPTH) {
+				printf("Shader includes nested too deeply at %s\n", path.c_str());
+				return false;
+			}
+			std::ifstream fstream(path);
+			if (!fstream.is_open()) {
+				printf("Failed to load file %s\n", path.c_str());
+				return false;
+			}
+			int fileIndex = (int)files.size();
+			files.push_back(path);
+			includeStack.push_back(path);
+			size_t slash = path.find_last_of('/');
+			std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+			std::string line;
+			int lineNumber = 0;
+			bool ok = true;
+			if (versionFound) {
+				output += "#line 1 " + std::to_string(fileIndex) + "\n";
+			}
+			while (ok && std::getline(fstream, line)) {
+				lineNumber++;
+				if (!line.empty() && line.back() == '\r') {
+					line.pop_back();
+				}
+				size_t argument = 0;
+				std::string directive = getDirective(line, &argument);
+				if (directive == "version" && !versionFound) {
+					versionFound = true;
+					output += line + "\n";
+					addDefines();
+					output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+				}
+				else if (directive == "pragma" && line.compare(argument, 4, "once") == 0) {
+					onceFiles.push_back(path);
+					output += "\n";
+				}
+				else if (directive == "include") {
+					size_t open = line.find_first_of("\"<", argument);
+					size_t close = open == std::string::npos ? open : line.find_first_of("\">", open + 1);
+					if (close == std::string::npos) {
+						printf("%s(%d): malformed #include\n", path.c_str(), lineNumber);
+						ok = false;
+						break;
+					}
+					ok = appendFile(directory + line.substr(open + 1, close - open - 1));
+					output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+				}
+				else {
+					output += line + "\n";
+				}
+			}
+			includeStack.pop_back();
+			return ok;
+		}
+	};
+
 	/// <summary>
-	/// Creates and compiles a shader object of a given type
+	/// Loads shader source code from a file, resolving includes and adding defines after #version.
+	/// </summary>
+	std::string preprocessShaderSource(const std::string& filePath, const std::vector<std::string>& defines, std::vector<std::string>* files)
+	{
+		Preprocessor preprocessor;
+		preprocessor.defines = &defines;
+		bool ok = preprocessor.appendFile(filePath);
+		if (files != nullptr) {
+			*files = preprocessor.files;
+		}
+		if (!ok) {
+			return {};
+		}
+		//No #version, so the defines go first
+		if (!preprocessor.versionFound) {
+			std::string source = preprocessor.output;
+			preprocessor.output.clear();
+			preprocessor.addDefines();
+			preprocessor.output += "#line 1 0\n" + source;
+		}
+		return preprocessor.output;
+	}
+
+	/// <summary>
+	/// Creates a shader object of a given type and starts compiling it, without waiting for the result
 	/// </summary>
 	/// <param name="shaderType">Expects GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, etc.</param>
 	/// <param name="sourceCode">GLSL source code for the shader stage</param>
 	/// <returns></returns>
-	static unsigned int createShader(GLenum shaderType, const char* sourceCode) {
+	static unsigned int compileShader(GLenum shaderType, const char* sourceCode) {
 		//Create a new vertex shader object
 		unsigned int shader = glCreateShader(shaderType);
 		//Supply the shader object with source code
 		glShaderSource(shader, 1, &sourceCode, NULL);
 		//Compile the shader object
 		glCompileShader(shader);
+		return shader;
+	}
+
+	/// <summary>
+	/// Prints the info log if a shader failed to compile. Blocks until compiling is done.
+	/// </summary>
+	static bool checkShader(unsigned int shader) {
 		int success;
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 		if (!success) {
@@ -47,87 +315,783 @@ namespace ew {
 			glGetShaderInfoLog(shader, 512, NULL, infoLog);
 			printf("Failed to compile shader: %s", infoLog);
 		}
-		return shader;
+		return success != 0;
 	}
 
 	/// <summary>
-	/// Creates a shader program with a vertex and fragment shader
+	/// Prints the info log if a program failed to link. Blocks until linking is done.
 	/// </summary>
-	/// <param name="vertexShaderSource">GLSL source code for the vertex shader</param>
-	/// <param name="fragmentShaderSource">GLSL source code for the fragment shader</param>
-	/// <returns></returns>
-	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
-		unsigned int vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
-		unsigned int fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+	static bool checkProgram(unsigned int program) {
+		int success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetProgramInfoLog(program, 512, NULL, infoLog);
+			printf("Failed to link shader program: %s", infoLog);
+		}
+		return success != 0;
+	}
 
+	/// <summary>
+	/// Creates a program from compiled stages and starts linking it, without waiting for the result
+	/// </summary>
+	static unsigned int linkProgram(unsigned int vertexShader, unsigned int fragmentShader, bool retrievable) {
 		unsigned int shaderProgram = glCreateProgram();
+		if (retrievable) {
+			glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
 		//Attach each stage
 		glAttachShader(shaderProgram, vertexShader);
 		glAttachShader(shaderProgram, fragmentShader);
 		//Link all the stages together
 		glLinkProgram(shaderProgram);
-		int success;
-		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-		if (!success) {
-			char infoLog[512];
-			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-			printf("Failed to link shader program: %s", infoLog);
-		}
+		return shaderProgram;
+	}
+
+	/// <summary>
+	/// Creates a shader program with a vertex and fragment shader
+	/// </summary>
+	/// <param name="vertexShaderSource">GLSL source code for the vertex shader</param>
+	/// <param name="fragmentShaderSource">GLSL source code for the fragment shader</param>
+	/// <param name="retrievable">Lets getProgramBinary read the linked program back</param>
+	/// <returns></returns>
+	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource, bool retrievable) {
+		unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
+		unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+		checkShader(vertexShader);
+		checkShader(fragmentShader);
+		unsigned int shaderProgram = linkProgram(vertexShader, fragmentShader, retrievable);
+		checkProgram(shaderProgram);
 		//The linked program now contains our compiled code, so we can delete these intermediate objects
 		glDeleteShader(vertexShader);
 		glDeleteShader(fragmentShader);
 		return shaderProgram;
 	}
+
+	struct ProgramKey {
+		uint64_t hash = 0; //Preprocessed sources, for the session cache
+		uint64_t binaryKey = 0; //Also the driver, for the binary cache
+		std::string binaryPath;
+		bool useBinaries = false;
+	};
+
+	struct CachedProgram {
+		unsigned int id;
+		std::shared_ptr<UniformTable> uniforms;
+		unsigned int numUsers; //Shaders built or loaded with it. Only hot reloads ever give one back.
+	};
+	//Every program built this session, by hash of its preprocessed sources
+	static std::unordered_map<uint64_t, CachedProgram> s_programCache;
+	static ShaderCacheStats s_programCacheStats;
+	static bool s_useProgramBinaries = true;
+	static int s_programBinariesSupported = -1; //Asked once the first program is built, when a context exists
+	static uint64_t s_driverHash = 0;
+
+	ShaderCacheStats getShaderCacheStats()
+	{
+		return s_programCacheStats;
+	}
+
+	void setProgramBinaryCacheEnabled(bool enabled)
+	{
+		s_useProgramBinaries = enabled;
+	}
+
+	/// <summary>
+	/// Gives back one use of a cached program, deleting it and dropping it from the cache once nothing uses it
+	/// </summary>
+	static void releaseCachedProgram(uint64_t hash, unsigned int id) {
+		auto it = s_programCache.find(hash);
+		if (it == s_programCache.end() || it->second.id != id) {
+			return;
+		}
+		if (--it->second.numUsers == 0) {
+			glDeleteProgram(id);
+			s_programCache.erase(it);
+		}
+	}
+
+	/// <summary>
+	/// Loads the program binary for key if there is one the driver accepts.
+	/// </summary>
+	/// <returns>0 if the program has to be built from source</returns>
+	static unsigned int loadCachedProgram(const std::string& binaryPath, uint64_t key) {
+		auto start = std::chrono::high_resolution_clock::now();
+		ProgramBinary binary;
+		if (!readProgramBinary(binaryPath, key, &binary)) {
+			return 0;
+		}
+		unsigned int program = loadProgramBinary(binary);
+		if (program == 0) {
+			//Usually a driver update. The rebuilt program overwrites the file.
+			s_programCacheStats.binariesRejected++;
+			return 0;
+		}
+		float loadMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		s_programCacheStats.binariesLoaded++;
+		s_programCacheStats.msSaved += binary.buildMs > loadMs ? binary.buildMs - loadMs : 0.0f;
+		return program;
+	}
+
+	/// <summary>
+	/// Hashes the preprocessed sources, and works out where their program binary would be
+	/// </summary>
+	static ProgramKey makeProgramKey(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines,
+		const std::string& vertexShaderSource, const std::string& fragmentShaderSource) {
+		ProgramKey key;
+		//Defines are part of the sources by now. The null terminators keep the two sources from running together.
+		key.hash = hashBytes(vertexShaderSource.c_str(), vertexShaderSource.size() + 1);
+		key.hash = hashBytes(fragmentShaderSource.c_str(), fragmentShaderSource.size() + 1, key.hash);
+		if (s_useProgramBinaries && s_programBinariesSupported < 0) {
+			s_programBinariesSupported = areProgramBinariesSupported() ? 1 : 0;
+			s_driverHash = getDriverHash();
+		}
+		key.useBinaries = s_useProgramBinaries && s_programBinariesSupported == 1;
+		key.binaryKey = hashBytes(&s_driverHash, sizeof(s_driverHash), key.hash);
+		if (key.useBinaries) {
+			//Named by the files and defines rather than the contents, so every version of a permutation shares one file.
+			//binaryKey in its header tells whether it is still current.
+			uint64_t identity = hashBytes(vertexShader.c_str(), vertexShader.size() + 1);
+			identity = hashBytes(fragmentShader.c_str(), fragmentShader.size() + 1, identity);
+			for (size_t i = 0; i < defines.size(); i++)
+			{
+				identity = hashBytes(defines[i].c_str(), defines[i].size() + 1, identity);
+			}
+			key.binaryPath = getProgramBinaryPath(vertexShader, identity);
+		}
+		return key;
+	}
+
 	/// <summary>
 	/// Creates a shader instance with vertex + fragment stages
 	/// </summary>
 	/// <param name="vertexShader">File path to vertex shader</param>
 	/// <param name="fragmentShader">File path to fragment shader</param>
-	Shader::Shader(const std::string& vertexShader, const std::string& fragmentShader)
+	/// <param name="defines">Added to both stages, "NAME" or "NAME VALUE"</param>
+	Shader::Shader(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines)
+	{
+		std::string vertexShaderSource = ew::preprocessShaderSource(vertexShader, defines);
+		std::string fragmentShaderSource = ew::preprocessShaderSource(fragmentShader, defines);
+		ProgramKey key = makeProgramKey(vertexShader, fragmentShader, defines, vertexShaderSource, fragmentShaderSource);
+		if (loadCached(key)) {
+			return;
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		unsigned int program = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str(), key.useBinaries);
+		finishBuild(program, key, std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+	/// <summary>
+	/// Takes the program from the session cache, or from its binary if the driver accepts it.
+	/// </summary>
+	/// <returns>False if it has to be built from source</returns>
+	bool Shader::loadCached(const ProgramKey& key)
+	{
+		auto it = s_programCache.find(key.hash);
+		if (it != s_programCache.end()) {
+			m_id = it->second.id;
+			m_uniforms = it->second.uniforms;
+			it->second.numUsers++;
+			s_programCacheStats.programsReused++;
+			return true;
+		}
+		m_id = key.useBinaries ? loadCachedProgram(key.binaryPath, key.binaryKey) : 0;
+		if (m_id == 0) {
+			return false;
+		}
+		reflectUniforms();
+		CachedProgram program = { m_id, m_uniforms, 1 };
+		s_programCache[key.hash] = program;
+		s_programCacheStats.programsCompiled++;
+		return true;
+	}
+	/// <summary>
+	/// Takes a program built from the sources key was made from, writes its binary and adds it to the session cache.
+	/// If another build of the same sources got there first, program is deleted and the cached one is used instead.
+	/// Linking must be finished.
+	/// </summary>
+	void Shader::finishBuild(unsigned int program, const ProgramKey& key, float buildMs)
 	{
-		std::string vertexShaderSource = ew::loadShaderSourceFromFile(vertexShader.c_str());
-		std::string fragmentShaderSource = ew::loadShaderSourceFromFile(fragmentShader.c_str());
-		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		//Two builds of the same sources can be in flight at once, such as a file saved twice before the first reload links
+		auto it = s_programCache.find(key.hash);
+		if (it != s_programCache.end()) {
+			glDeleteProgram(program);
+			m_id = it->second.id;
+			m_uniforms = it->second.uniforms;
+			it->second.numUsers++;
+			s_programCacheStats.programsReused++;
+			return;
+		}
+		m_id = program;
+		int linked = 0;
+		glGetProgramiv(m_id, GL_LINK_STATUS, &linked);
+		ProgramBinary binary;
+		if (key.useBinaries && linked && getProgramBinary(m_id, &binary)) {
+			binary.buildMs = buildMs;
+			writeProgramBinary(key.binaryPath, key.binaryKey, binary);
+		}
+		reflectUniforms();
+		CachedProgram cached = { m_id, m_uniforms, 1 };
+		s_programCache[key.hash] = cached;
+		s_programCacheStats.programsCompiled++;
+	}
+	/// <summary>
+	/// Queries every active uniform once and stores its location in the uniform table.
+	/// Arrays are also registered by their base name and by each element name.
+	/// </summary>
+	void Shader::reflectUniforms()
+	{
+		m_uniforms = std::make_shared<UniformTable>();
+		int numUniforms = 0;
+		int maxNameLength = 0;
+		glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &numUniforms);
+		glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+		std::vector<char> nameBuffer(maxNameLength + 1);
+		for (int i = 0; i < numUniforms; i++)
+		{
+			int nameLength = 0;
+			int arraySize = 0;
+			GLenum type;
+			glGetActiveUniform(m_id, i, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+			std::string name(nameBuffer.data(), nameLength);
+			int location = glGetUniformLocation(m_id, name.c_str());
+			//Uniform block members have no location
+			if (location < 0) {
+				continue;
+			}
+			m_uniforms->insert(name, location);
+			if (arraySize > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+				std::string baseName = name.substr(0, name.size() - 3);
+				m_uniforms->insert(baseName, location);
+				for (int j = 1; j < arraySize; j++)
+				{
+					std::string elementName = baseName + "[" + std::to_string(j) + "]";
+					m_uniforms->insert(elementName, glGetUniformLocation(m_id, elementName.c_str()));
+				}
+			}
+		}
 	}
 	void Shader::use()const
 	{
 		glUseProgram(m_id);
 	}
-	void Shader::setInt(const std::string& name, int v) const
+	/// <summary>
+	/// Resolves a uniform name to a handle that can be passed to the setters.
+	/// Names that are not active uniforms are resolved through the driver once and then remembered.
+	/// </summary>
+	UniformHandle Shader::getUniform(const char* name) const
 	{
-		glUniform1i(glGetUniformLocation(m_id, name.c_str()), v);
+		UniformHandle handle;
+		handle.slot = m_uniforms->find(name, UniformTable::hashName(name, strlen(name)));
+		if (handle.slot < 0) {
+			handle.slot = m_uniforms->insert(name, glGetUniformLocation(m_id, name));
+		}
+		return handle;
 	}
-	void Shader::setFloat(const std::string& name, float v) const
+	/// <summary>
+	/// Stores value as the last uploaded value of the uniform.
+	/// </summary>
+	/// <returns>False if the uniform does not exist or already holds this value</returns>
+	bool Shader::updateCache(UniformHandle handle, const void* value, unsigned int size) const
 	{
-		glUniform1f(glGetUniformLocation(m_id, name.c_str()), v);
+		if (!handle.isValid()) {
+			return false;
+		}
+		UniformTable::Entry& entry = m_uniforms->entries[handle.slot];
+		m_uniforms->stats.lookupsSkipped++;
+		if (entry.location < 0) {
+			return false;
+		}
+		if (entry.hasValue && entry.size == size && memcmp(entry.value, value, size) == 0) {
+			m_uniforms->stats.uploadsSkipped++;
+			return false;
+		}
+		memcpy(entry.value, value, size);
+		entry.size = size;
+		entry.hasValue = true;
+		m_uniforms->stats.uploads++;
+		return true;
 	}
-	void Shader::setVec2(const std::string& name, float x, float y) const
+	int Shader::getLocation(UniformHandle handle) const
 	{
-		glUniform2f(glGetUniformLocation(m_id, name.c_str()), x, y);
+		return m_uniforms->entries[handle.slot].location;
 	}
-	void Shader::setVec2(const std::string& name, const glm::vec2& v) const
+	void Shader::setInt(const char* name, int v) const
 	{
-		setVec2(name, v.x, v.y);
+		setInt(getUniform(name), v);
 	}
-	void Shader::setVec3(const std::string& name, float x, float y, float z) const
+	void Shader::setFloat(const char* name, float v) const
 	{
-		glUniform3f(glGetUniformLocation(m_id, name.c_str()), x, y, z);
+		setFloat(getUniform(name), v);
 	}
-	void Shader::setVec3(const std::string& name, const glm::vec3& v) const
+	void Shader::setVec2(const char* name, float x, float y) const
 	{
-		setVec3(name, v.x, v.y, v.z);
+		setVec2(getUniform(name), glm::vec2(x, y));
 	}
-	void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
+	void Shader::setVec2(const char* name, const glm::vec2& v) const
 	{
-		glUniform4f(glGetUniformLocation(m_id, name.c_str()), x, y, z, w);
+		setVec2(getUniform(name), v);
 	}
-	void Shader::setVec4(const std::string& name, const glm::vec4& v) const
+	void Shader::setVec3(const char* name, float x, float y, float z) const
 	{
-		setVec4(name, v.x, v.y, v.z, v.w);
+		setVec3(getUniform(name), glm::vec3(x, y, z));
 	}
-	void Shader::setMat4(const std::string& name, const glm::mat4& m) const
+	void Shader::setVec3(const char* name, const glm::vec3& v) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(m));
+		setVec3(getUniform(name), v);
+	}
+	void Shader::setVec4(const char* name, float x, float y, float z, float w) const
+	{
+		setVec4(getUniform(name), glm::vec4(x, y, z, w));
+	}
+	void Shader::setVec4(const char* name, const glm::vec4& v) const
+	{
+		setVec4(getUniform(name), v);
+	}
+	void Shader::setMat4(const char* name, const glm::mat4& m) const
+	{
+		setMat4(getUniform(name), m);
+	}
+	//glProgramUniform* is used so the cache stays correct even if another program is bound
+	void Shader::setInt(UniformHandle handle, int v) const
+	{
+		if (updateCache(handle, &v, sizeof(v))) {
+			glProgramUniform1i(m_id, getLocation(handle), v);
+		}
+	}
+	void Shader::setFloat(UniformHandle handle, float v) const
+	{
+		if (updateCache(handle, &v, sizeof(v))) {
+			glProgramUniform1f(m_id, getLocation(handle), v);
+		}
+	}
+	void Shader::setVec2(UniformHandle handle, const glm::vec2& v) const
+	{
+		if (updateCache(handle, glm::value_ptr(v), sizeof(v))) {
+			glProgramUniform2f(m_id, getLocation(handle), v.x, v.y);
+		}
+	}
+	void Shader::setVec3(UniformHandle handle, const glm::vec3& v) const
+	{
+		if (updateCache(handle, glm::value_ptr(v), sizeof(v))) {
+			glProgramUniform3f(m_id, getLocation(handle), v.x, v.y, v.z);
+		}
+	}
+	void Shader::setVec4(UniformHandle handle, const glm::vec4& v) const
+	{
+		if (updateCache(handle, glm::value_ptr(v), sizeof(v))) {
+			glProgramUniform4f(m_id, getLocation(handle), v.x, v.y, v.z, v.w);
+		}
+	}
+	void Shader::setMat4(UniformHandle handle, const glm::mat4& m) const
+	{
+		if (updateCache(handle, glm::value_ptr(m), sizeof(m))) {
+			glProgramUniformMatrix4fv(m_id, getLocation(handle), 1, GL_FALSE, glm::value_ptr(m));
+		}
+	}
+	int Shader::getUniformBlockSize(const char* blockName) const
+	{
+		unsigned int index = glGetUniformBlockIndex(m_id, blockName);
+		if (index == GL_INVALID_INDEX) {
+			return -1;
+		}
+		int size = 0;
+		glGetActiveUniformBlockiv(m_id, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		return size;
+	}
+	bool Shader::setUniformBlockBinding(const char* blockName, unsigned int bindingIndex) const
+	{
+		unsigned int index = glGetUniformBlockIndex(m_id, blockName);
+		if (index == GL_INVALID_INDEX) {
+			return false;
+		}
+		glUniformBlockBinding(m_id, index, bindingIndex);
+		return true;
+	}
+	bool Shader::checkUniformBlockSize(const char* blockName, unsigned int size) const
+	{
+		int blockSize = getUniformBlockSize(blockName);
+		if (blockSize < 0) {
+			printf("Uniform block %s is not active in program %u\n", blockName, m_id);
+			return false;
+		}
+		if ((unsigned int)blockSize != size) {
+			printf("Uniform block %s is %d bytes in program %u but %u bytes on the CPU\n", blockName, blockSize, m_id, size);
+			return false;
+		}
+		return true;
+	}
+	UniformStats Shader::getUniformStats() const
+	{
+		return m_uniforms->stats;
+	}
+	void Shader::resetUniformStats() const
+	{
+		m_uniforms->stats = UniformStats();
+	}
+
+	UniformBuffer::UniformBuffer(unsigned int size)
+		: m_size(size), m_uploaded(size)
+	{
+		glCreateBuffers(1, &m_ubo);
+		glNamedBufferStorage(m_ubo, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+	UniformBuffer::~UniformBuffer()
+	{
+		glDeleteBuffers(1, &m_ubo);
+	}
+	bool UniformBuffer::upload(const void* data)
+	{
+		if (m_hasValue && memcmp(m_uploaded.data(), data, m_size) == 0) {
+			return false;
+		}
+		memcpy(m_uploaded.data(), data, m_size);
+		m_hasValue = true;
+		glNamedBufferSubData(m_ubo, 0, m_size, data);
+		return true;
+	}
+	void UniformBuffer::bind(unsigned int bindingIndex) const
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, bindingIndex, m_ubo);
+	}
+
+	enum BuildStatus {
+		BUILD_PENDING,
+		BUILD_READY,
+		BUILD_FAILED
+	};
+
+	struct ShaderBuild {
+		std::atomic<int> status{ BUILD_PENDING };
+		Shader shader;
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::vector<std::string> defines;
+		std::vector<std::string> files; //Every file the sources were read from, includes too
+		std::weak_ptr<ShaderBuild> target; //For hot reloads, the build to swap into once this one links
+		unsigned int generation = 0; //Reloads count up from 1 per target. For a target, the reload it is running now.
+		unsigned int numReloads = 0; //Reloads started for this build
+		ProgramKey key;
+		std::string vertexSource;
+		std::string fragmentSource;
+		unsigned int vertexShader = 0; //Parallel compile only
+		unsigned int fragmentShader = 0;
+		unsigned int program = 0;
+		std::atomic<bool> linked{ false }; //Set by the worker once the program is usable from the main context
+		std::chrono::high_resolution_clock::time_point start;
+	};
+
+	bool ShaderHandle::isReady()const
+	{
+		return m_build != nullptr && m_build->status == BUILD_READY;
+	}
+	bool ShaderHandle::isFailed()const
+	{
+		return m_build != nullptr && m_build->status == BUILD_FAILED;
+	}
+	bool ShaderHandle::use()const
+	{
+		if (!isReady()) {
+			return false;
+		}
+		m_build->shader.use();
+		return true;
+	}
+	const Shader& ShaderHandle::get()const
+	{
+		return m_build->shader;
 	}
-}
 
+	static bool hasExtension(const char* name) {
+		int numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (int i = 0; i < numExtensions; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension != NULL && strcmp(extension, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	ShaderCompiler::ShaderCompiler(GLFWwindow* window, bool hotReload)
+	{
+		if (hotReload) {
+			m_watcher.reset(new FileWatcher());
+		}
+		bool khr = hasExtension("GL_KHR_parallel_shader_compile");
+		if (khr || hasExtension("GL_ARB_parallel_shader_compile")) {
+			MaxShaderCompilerThreadsFunc maxShaderCompilerThreads = (MaxShaderCompilerThreadsFunc)glfwGetProcAddress(
+				khr ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB");
+			if (maxShaderCompilerThreads != NULL) {
+				//As many threads as the driver wants
+				maxShaderCompilerThreads(0xFFFFFFFFu);
+				m_parallel = true;
+				return;
+			}
+		}
+		//The worker's context has to match the main one to share objects with it
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MAJOR));
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MINOR));
+		glfwWindowHint(GLFW_OPENGL_PROFILE, glfwGetWindowAttrib(window, GLFW_OPENGL_PROFILE));
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, glfwGetWindowAttrib(window, GLFW_OPENGL_FORWARD_COMPAT));
+		m_workerWindow = glfwCreateWindow(1, 1, "Shader Compiler", NULL, window);
+		glfwDefaultWindowHints();
+		if (m_workerWindow == NULL) {
+			printf("Failed to create a shader compile context, compiling on the GL thread\n");
+			return;
+		}
+		m_worker = std::thread(&ShaderCompiler::workerLoop, this);
+	}
+
+	ShaderCompiler::~ShaderCompiler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		if (m_worker.joinable()) {
+			m_worker.join();
+		}
+		if (m_workerWindow != NULL) {
+			glfwDestroyWindow(m_workerWindow);
+		}
+	}
+
+	void ShaderCompiler::workerLoop()
+	{
+		glfwMakeContextCurrent(m_workerWindow);
+		while (true) {
+			std::shared_ptr<ShaderBuild> build;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+				if (m_stop) {
+					break;
+				}
+				build = m_queue.front();
+				m_queue.pop_front();
+			}
+			unsigned int program = createShaderProgram(build->vertexSource.c_str(), build->fragmentSource.c_str(), build->key.useBinaries);
+			//The main context only sees the finished program once this context's commands are done
+			glFinish();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				build->program = program;
+				build->linked = true;
+			}
+			m_built.notify_all();
+		}
+		glfwMakeContextCurrent(NULL);
+	}
+
+	ShaderHandle ShaderCompiler::build(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines)
+	{
+		ShaderHandle handle;
+		handle.m_build = std::make_shared<ShaderBuild>();
+		ShaderBuild& build = *handle.m_build;
+		build.vertexPath = vertexShader;
+		build.fragmentPath = fragmentShader;
+		build.defines = defines;
+		preprocess(build);
+
+		//The same permutation twice shares one build
+		for (size_t i = 0; i < m_pending.size(); i++)
+		{
+			if (m_pending[i]->key.hash == build.key.hash && m_pending[i]->generation == 0) {
+				handle.m_build = m_pending[i];
+				return handle;
+			}
+		}
+		if (m_watcher != nullptr) {
+			m_watched.push_back(handle.m_build);
+		}
+		start(handle.m_build);
+		return handle;
+	}
+
+	void ShaderCompiler::preprocess(ShaderBuild& build)
+	{
+		std::vector<std::string> vertexFiles, fragmentFiles;
+		build.vertexSource = preprocessShaderSource(build.vertexPath, build.defines, &vertexFiles);
+		build.fragmentSource = preprocessShaderSource(build.fragmentPath, build.defines, &fragmentFiles);
+		build.key = makeProgramKey(build.vertexPath, build.fragmentPath, build.defines, build.vertexSource, build.fragmentSource);
+		build.files = vertexFiles;
+		build.files.insert(build.files.end(), fragmentFiles.begin(), fragmentFiles.end());
+		if (m_watcher != nullptr) {
+			for (size_t i = 0; i < build.files.size(); i++)
+			{
+				m_watcher->watch(build.files[i]);
+			}
+		}
+	}
+
+	void ShaderCompiler::start(const std::shared_ptr<ShaderBuild>& buildPtr)
+	{
+		ShaderBuild& build = *buildPtr;
+		if (build.shader.loadCached(build.key)) {
+			int linked = 0;
+			glGetProgramiv(build.shader.getId(), GL_LINK_STATUS, &linked);
+			build.status = linked ? BUILD_READY : BUILD_FAILED;
+			build.vertexSource = std::string();
+			build.fragmentSource = std::string();
+			return;
+		}
+
+		build.start = std::chrono::high_resolution_clock::now();
+		if (m_parallel) {
+			//Linking straight away is fine, the driver waits for the stages on its own threads
+			build.vertexShader = compileShader(GL_VERTEX_SHADER, build.vertexSource.c_str());
+			build.fragmentShader = compileShader(GL_FRAGMENT_SHADER, build.fragmentSource.c_str());
+			build.program = linkProgram(build.vertexShader, build.fragmentShader, build.key.useBinaries);
+		}
+		else if (m_workerWindow != NULL) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back(buildPtr);
+			m_wake.notify_one();
+		}
+		else {
+			build.program = createShaderProgram(build.vertexSource.c_str(), build.fragmentSource.c_str(), build.key.useBinaries);
+			build.linked = true;
+		}
+		m_pending.push_back(buildPtr);
+	}
+
+	void ShaderCompiler::reloadChanged()
+	{
+		std::vector<std::string> changed = m_watcher->poll();
+		if (changed.empty()) {
+			return;
+		}
+		for (size_t i = 0; i < m_watched.size(); )
+		{
+			std::shared_ptr<ShaderBuild> build = m_watched[i].lock();
+			if (build == nullptr) {
+				m_watched.erase(m_watched.begin() + i);
+				continue;
+			}
+			i++;
+			bool affected = false;
+			for (size_t j = 0; j < changed.size() && !affected; j++)
+			{
+				for (size_t k = 0; k < build->files.size() && !affected; k++)
+				{
+					affected = build->files[k] == changed[j];
+				}
+			}
+			if (!affected) {
+				continue;
+			}
+			//Built separately and swapped in once it links, so the old program keeps drawing until then
+			std::shared_ptr<ShaderBuild> reload = std::make_shared<ShaderBuild>();
+			reload->vertexPath = build->vertexPath;
+			reload->fragmentPath = build->fragmentPath;
+			reload->defines = build->defines;
+			reload->target = build;
+			reload->generation = ++build->numReloads;
+			preprocess(*reload);
+			start(reload);
+			if (reload->status != BUILD_PENDING) {
+				swapIn(*reload);
+			}
+		}
+	}
+
+	/// <summary>
+	/// True once nothing uses the reload's target, or a newer edit than the reload's has been swapped into it.
+	/// Reloads finish out of order when an edit compiles slower than the one after it.
+	/// </summary>
+	static bool isStaleReload(const ShaderBuild& reload) {
+		std::shared_ptr<ShaderBuild> target = reload.target.lock();
+		return target == nullptr || reload.generation <= target->generation;
+	}
+
+	void ShaderCompiler::swapIn(ShaderBuild& reload)
+	{
+		if (isStaleReload(reload)) {
+			releaseCachedProgram(reload.key.hash, reload.shader.getId());
+			return;
+		}
+		if (reload.status != BUILD_READY) {
+			printf("Keeping the previous %s + %s\n", reload.vertexPath.c_str(), reload.fragmentPath.c_str());
+			releaseCachedProgram(reload.key.hash, reload.shader.getId());
+			return;
+		}
+		//Copies of the old Shader have to get() the new one after update(), the old program is deleted if unshared
+		std::shared_ptr<ShaderBuild> target = reload.target.lock();
+		releaseCachedProgram(target->key.hash, target->shader.getId());
+		target->shader = reload.shader;
+		target->generation = reload.generation;
+		target->key = reload.key;
+		target->files = reload.files;
+		target->status = BUILD_READY;
+		m_numReloads++;
+		printf("Reloaded %s + %s\n", reload.vertexPath.c_str(), reload.fragmentPath.c_str());
+	}
+
+	void ShaderCompiler::update()
+	{
+		if (m_watcher != nullptr) {
+			reloadChanged();
+		}
+		for (size_t i = 0; i < m_pending.size(); )
+		{
+			ShaderBuild& build = *m_pending[i];
+			bool done = build.linked;
+			if (m_parallel) {
+				int complete = 0;
+				glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &complete);
+				done = complete != 0;
+			}
+			if (!done) {
+				i++;
+				continue;
+			}
+			if (m_parallel) {
+				checkShader(build.vertexShader);
+				checkShader(build.fragmentShader);
+				checkProgram(build.program);
+				glDeleteShader(build.vertexShader);
+				glDeleteShader(build.fragmentShader);
+			}
+			//A reload of a file changed while this was still compiling already swapped in the newer program,
+			//or this reload is older than one already swapped in. Neither program made it into the cache.
+			if (build.status != BUILD_PENDING || (build.generation > 0 && isStaleReload(build))) {
+				glDeleteProgram(build.program);
+				m_pending.erase(m_pending.begin() + i);
+				continue;
+			}
+			float buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - build.start).count();
+			build.shader.finishBuild(build.program, build.key, buildMs);
+			int linked = 0;
+			glGetProgramiv(build.shader.getId(), GL_LINK_STATUS, &linked);
+			build.status = linked ? BUILD_READY : BUILD_FAILED;
+			build.vertexSource = std::string();
+			build.fragmentSource = std::string();
+			if (build.generation > 0) {
+				swapIn(build);
+			}
+			m_pending.erase(m_pending.begin() + i);
+		}
+	}
+
+	void ShaderCompiler::finish()
+	{
+		for (size_t i = 0; i < m_pending.size(); i++)
+		{
+			ShaderBuild& build = *m_pending[i];
+			if (m_parallel) {
+				//Blocks until linking is done
+				int linked = 0;
+				glGetProgramiv(build.program, GL_LINK_STATUS, &linked);
+			}
+			else {
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_built.wait(lock, [&build] { return build.linked.load(); });
+			}
+		}
+		update();
+	}
+}
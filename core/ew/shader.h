@@ -4,25 +4,203 @@
 
 #pragma once
 #include <string>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <glm/glm.hpp>
 
+struct GLFWwindow;
+
 namespace ew {
 	std::string loadShaderSourceFromFile(const std::string& filePath);
-	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+	//Loads filePath and resolves #include "path" directives relative to the including file. Files containing
+	//#pragma once are only included the first time. Each define ("NAME" or "NAME VALUE") is added after #version.
+	//files receives every file read, indexed by the source string number used in the #line directives, so
+	//compile errors can be traced back to the file. Returns an empty string if a file can't be read.
+	std::string preprocessShaderSource(const std::string& filePath, const std::vector<std::string>& defines = {},
+		std::vector<std::string>* files = nullptr);
+	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource, bool retrievable = false);
+
+	//Pre-resolved uniform, returned by Shader::getUniform. Valid for the lifetime of the shader.
+	struct UniformHandle {
+		int slot = -1;
+		inline bool isValid()const { return slot >= 0; }
+	};
+
+	//Counts work avoided by the uniform cache since the last reset
+	struct UniformStats {
+		unsigned int lookupsSkipped = 0; //glGetUniformLocation calls served from the table
+		unsigned int uploadsSkipped = 0; //glUniform* calls skipped because the value did not change
+		unsigned int uploads = 0; //glUniform* calls actually made
+	};
+
+	//Counts programs built or reused by Shader since startup
+	struct ShaderCacheStats {
+		unsigned int programsCompiled = 0; //Including ones loaded from a binary
+		unsigned int programsReused = 0; //Same preprocessed sources, so the permutation was already compiled
+		unsigned int binariesLoaded = 0;
+		unsigned int binariesRejected = 0; //Rebuilt from source
+		float msSaved = 0.0f; //Build time the loaded binaries took when they were written, minus loading them
+	};
+	ShaderCacheStats getShaderCacheStats();
+	//Shader keeps each linked program in a .ewprog file next to its vertex shader, one per set of files and defines.
+	//It loads the binary instead of compiling while the preprocessed sources and the driver match, and rebuilding
+	//overwrites it otherwise. On by default.
+	void setProgramBinaryCacheEnabled(bool enabled);
+
+	//Uniform buffer holding one std140 block, see UniformBlock
+	class UniformBuffer {
+	public:
+		UniformBuffer(unsigned int size);
+		~UniformBuffer();
+		UniformBuffer(const UniformBuffer&) = delete;
+		UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+		//Copies size bytes into the buffer. Returns false, and uploads nothing, if they match the last upload.
+		bool upload(const void* data);
+		//Binds the buffer to a uniform buffer binding point, as in layout(std140, binding = N)
+		void bind(unsigned int bindingIndex)const;
+		inline unsigned int getId()const { return m_ubo; }
+		inline unsigned int getSize()const { return m_size; }
+	private:
+		unsigned int m_ubo = 0;
+		unsigned int m_size = 0;
+		bool m_hasValue = false;
+		std::vector<unsigned char> m_uploaded;
+	};
+
+	//A uniform buffer holding a T. T must match the block's std140 layout: vec3s are aligned to 16 bytes, array
+	//elements have a 16 byte stride and the block is padded to a multiple of 16. Shader::checkUniformBlock compares
+	//sizeof(T) with what the program expects.
+	template<typename T>
+	class UniformBlock : public UniformBuffer {
+	public:
+		static_assert(sizeof(T) % 16 == 0, "std140 blocks are padded to a multiple of 16 bytes");
+		UniformBlock() : UniformBuffer(sizeof(T)) {}
+		inline bool upload(const T& value) { return UniformBuffer::upload(&value); }
+	};
+
+	struct UniformTable;
+	struct ProgramKey;
+
 	class Shader {
 	public:
-		Shader(const std::string& vertexShader, const std::string& fragmentShader);
+		//Programs are cached by the preprocessed sources, so loading the same files with the same defines again
+		//shares the compiled program
+		Shader(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines = {});
 		void use()const;
-		void setInt(const std::string& name, int v) const;
-		void setFloat(const std::string& name, float v) const;
-		void setVec2(const std::string& name, float x, float y) const;
-		void setVec2(const std::string& name, const glm::vec2& v) const;
-		void setVec3(const std::string& name, float x, float y, float z) const;
-		void setVec3(const std::string& name, const glm::vec3& v) const;
-		void setVec4(const std::string& name, float x, float y, float z, float w) const;
-		void setVec4(const std::string& name, const glm::vec4& v) const;
-		void setMat4(const std::string& name, const glm::mat4& m) const;
+		inline unsigned int getId()const { return m_id; }
+		//Names are C strings so setting a uniform by a literal name doesn't build a std::string every frame
+		UniformHandle getUniform(const char* name) const;
+		inline UniformHandle getUniform(const std::string& name) const { return getUniform(name.c_str()); }
+		void setInt(const char* name, int v) const;
+		void setFloat(const char* name, float v) const;
+		void setVec2(const char* name, float x, float y) const;
+		void setVec2(const char* name, const glm::vec2& v) const;
+		void setVec3(const char* name, float x, float y, float z) const;
+		void setVec3(const char* name, const glm::vec3& v) const;
+		void setVec4(const char* name, float x, float y, float z, float w) const;
+		void setVec4(const char* name, const glm::vec4& v) const;
+		void setMat4(const char* name, const glm::mat4& m) const;
+		void setInt(UniformHandle handle, int v) const;
+		void setFloat(UniformHandle handle, float v) const;
+		void setVec2(UniformHandle handle, const glm::vec2& v) const;
+		void setVec3(UniformHandle handle, const glm::vec3& v) const;
+		void setVec4(UniformHandle handle, const glm::vec4& v) const;
+		void setMat4(UniformHandle handle, const glm::mat4& m) const;
+		//Size in bytes of the named uniform block, or -1 if the program has no such block
+		int getUniformBlockSize(const char* blockName) const;
+		//Points the named block at a binding index, for blocks without a layout(binding = N). Returns false if the
+		//program has no such block.
+		bool setUniformBlockBinding(const char* blockName, unsigned int bindingIndex) const;
+		//Prints a message and returns false unless the program has the block and it is the size of T
+		template<typename T>
+		bool checkUniformBlock(const char* blockName) const {
+			return checkUniformBlockSize(blockName, sizeof(T));
+		}
+		UniformStats getUniformStats()const;
+		void resetUniformStats()const;
 	private:
+		bool checkUniformBlockSize(const char* blockName, unsigned int size) const;
+		friend struct ShaderBuild;
+		friend class ShaderCompiler;
+		Shader() : m_id(0) {}
+		bool loadCached(const ProgramKey& key);
+		void finishBuild(unsigned int program, const ProgramKey& key, float buildMs);
+		void reflectUniforms();
+		bool updateCache(UniformHandle handle, const void* value, unsigned int size) const;
+		int getLocation(UniformHandle handle) const;
+
 		unsigned int m_id; //Shader program handle
+		std::shared_ptr<UniformTable> m_uniforms; //Shared between copies, since they refer to the same program
+	};
+
+	struct ShaderBuild;
+
+	//A program built by ShaderCompiler. Copies share the build.
+	class ShaderHandle {
+	public:
+		bool isValid()const { return m_build != nullptr; }
+		//True once linked successfully
+		bool isReady()const;
+		bool isFailed()const;
+		//Binds the program if it is ready. Returns false and binds nothing while it is compiling, or if it failed.
+		bool use()const;
+		//Only valid once ready
+		const Shader& get()const;
+	private:
+		friend class ShaderCompiler;
+		std::shared_ptr<ShaderBuild> m_build;
+	};
+
+	class FileWatcher;
+
+	//Builds programs without blocking on each one. With GL_KHR_parallel_shader_compile (or the ARB version) every
+	//stage is handed to the driver's compiler threads at once. Otherwise programs compile on a worker thread with a
+	//hidden window sharing the context. Programs found in the session or binary cache are ready immediately.
+	//With hotReload, every file a build read, includes too, is watched. update() rebuilds the programs whose files
+	//changed and swaps each into its handles once it links, keeping the old program if it doesn't. A reload that
+	//finishes after a newer edit's is dropped. The replaced program is deleted unless another Shader was built with
+	//the same sources, so Shaders copied out of a handle must be refreshed with get() after update().
+	//Create, use and destroy on the GL thread.
+	class ShaderCompiler {
+	public:
+		ShaderCompiler(GLFWwindow* window, bool hotReload = false);
+		~ShaderCompiler();
+		ShaderCompiler(const ShaderCompiler&) = delete;
+		ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+		ShaderHandle build(const std::string& vertexShader, const std::string& fragmentShader, const std::vector<std::string>& defines = {});
+		//Call once per frame. Finishes builds the driver or worker are done with.
+		void update();
+		//Blocks until every build so far is finished
+		void finish();
+
+		inline bool isParallel()const { return m_parallel; }
+		inline size_t getNumPending()const { return m_pending.size(); }
+		inline unsigned int getNumReloads()const { return m_numReloads; }
+	private:
+		void preprocess(ShaderBuild& build);
+		void start(const std::shared_ptr<ShaderBuild>& build);
+		void reloadChanged();
+		void swapIn(ShaderBuild& reload);
+		void workerLoop();
+
+		bool m_parallel = false;
+		std::vector<std::shared_ptr<ShaderBuild>> m_pending;
+		std::unique_ptr<FileWatcher> m_watcher;
+		std::vector<std::weak_ptr<ShaderBuild>> m_watched;
+		unsigned int m_numReloads = 0;
+		//Worker fallback only
+		GLFWwindow* m_workerWindow = nullptr;
+		std::thread m_worker;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_built;
+		std::deque<std::shared_ptr<ShaderBuild>> m_queue;
+		bool m_stop = false;
 	};
-}
\ No newline at end of file
+}
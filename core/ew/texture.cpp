@@ -3,60 +3,193 @@
 */
 
 #include "texture.h"
+#include "mipmap.h"
+#include "textureCompression.h"
 #include "external/glad.h"
 #include "external/stb_image.h"
+#include <stdio.h>
 
-static int getTextureFormat(int numComponents) {
-	switch (numComponents) {
+//S3TC is an extension, so glad's core profile header doesn't define its formats
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+static int getCompressedFormat(ew::TextureCompression compression, bool srgb) {
+	switch (compression) {
 	default:
-		return GL_RGBA;
-	case 3:
-		return GL_RGB;
-	case 2:
-		return GL_RG;
-	case 1:
-		return GL_RED;
+	case ew::TextureCompression::BC1:
+		return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case ew::TextureCompression::BC3:
+		return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case ew::TextureCompression::BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	case ew::TextureCompression::BC7:
+		return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
 	}
 }
+
+static void setSamplerParams(const ew::TextureParams& params) {
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, params.wrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, params.wrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, params.minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, params.magFilter);
+
+	//Black border by default
+	float borderColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+}
 namespace ew {
-	unsigned int loadTexture(const char* filePath) {
-		stbi_set_flip_vertically_on_load(true);
+	int getTextureFormat(int numComponents) {
+		switch (numComponents) {
+		default:
+			return GL_RGBA;
+		case 3:
+			return GL_RGB;
+		case 2:
+			return GL_RG;
+		case 1:
+			return GL_RED;
+		}
+	}
+
+	int getInternalFormat(int numComponents, bool srgb) {
+		switch (numComponents) {
+		default:
+			return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		case 3:
+			return srgb ? GL_SRGB8 : GL_RGB8;
+		case 2:
+			return GL_RG8;
+		case 1:
+			return GL_R8;
+		}
+	}
+
+	TextureParams::TextureParams()
+		: wrapMode(GL_REPEAT), magFilter(GL_LINEAR), minFilter(GL_LINEAR_MIPMAP_LINEAR), mipmap(true), flipVertically(true),
+		srgb(false), mipFilter(MipFilter::DRIVER), useMipCache(false), compression(TextureCompression::NONE) {}
 
-		return loadTexture(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true);
+	TextureParams::TextureParams(int wrapMode, int magFilter, int minFilter, bool mipmap, bool flipVertically)
+		: wrapMode(wrapMode), magFilter(magFilter), minFilter(minFilter), mipmap(mipmap), flipVertically(flipVertically),
+		srgb(false), mipFilter(MipFilter::DRIVER), useMipCache(false), compression(TextureCompression::NONE) {}
 
+	void ImageFree::operator()(unsigned char* pixels)const {
+		stbi_image_free(pixels);
 	}
-	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap) {
+
+	bool decodeImage(const char* filePath, bool flipVertically, ImageData* image) {
+		//Per thread, so parallel decodes with different settings don't race
+		stbi_set_flip_vertically_on_load_thread(flipVertically);
 		int width, height, numComponents;
 		unsigned char* data = stbi_load(filePath, &width, &height, &numComponents, 0);
 		if (data == NULL) {
-			printf("Failed to load image %s", filePath);
-			stbi_image_free(data);
-			return 0;
+			printf("Failed to load image %s: %s\n", filePath, stbi_failure_reason());
+			return false;
 		}
+		image->width = width;
+		image->height = height;
+		image->numComponents = numComponents;
+		image->pixels.reset(data);
+		return true;
+	}
+
+	unsigned int createTexture(const ImageData& image, const TextureParams& params, unsigned int pixelBuffer) {
 		unsigned int texture;
 		glGenTextures(1, &texture);
 		glBindTexture(GL_TEXTURE_2D, texture);
-		int format = getTextureFormat(numComponents);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
-
-		//Black border by default
-		float borderColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
-		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-		if (mipmap) {
+		int format = getTextureFormat(image.numComponents);
+		//RGB and RG rows are not always 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		glTexImage2D(GL_TEXTURE_2D, 0, getInternalFormat(image.numComponents, params.srgb), image.width, image.height, 0,
+			format, GL_UNSIGNED_BYTE, pixelBuffer != 0 ? NULL : image.pixels.get());
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		setSamplerParams(params);
+
+		if (params.mipmap) {
 			glGenerateMipmap(GL_TEXTURE_2D);
 		}
 
 		glBindTexture(GL_TEXTURE_2D, 0);
-		stbi_image_free(data);
 		return texture;
 	}
 
+	unsigned int createTexture(const MipChain& chain, const TextureParams& params, unsigned int pixelBuffer) {
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		int format = getTextureFormat(chain.numComponents);
+		glTexStorage2D(GL_TEXTURE_2D, (GLsizei)chain.levels.size(), getInternalFormat(chain.numComponents, params.srgb),
+			chain.levels[0].width, chain.levels[0].height);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		for (size_t i = 0; i < chain.levels.size(); i++)
+		{
+			const MipLevel& level = chain.levels[i];
+			const void* pixels = pixelBuffer != 0 ? (const void*)level.offset : chain.pixels.data() + level.offset;
+			glTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height, format, GL_UNSIGNED_BYTE, pixels);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		setSamplerParams(params);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
 
+	unsigned int createTexture(const CompressedTexture& compressed, const TextureParams& params, unsigned int pixelBuffer) {
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		int format = getCompressedFormat(compressed.compression, compressed.srgb);
+		glTexStorage2D(GL_TEXTURE_2D, (GLsizei)compressed.levels.size(), format, compressed.levels[0].width, compressed.levels[0].height);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		for (size_t i = 0; i < compressed.levels.size(); i++)
+		{
+			const CompressedLevel& level = compressed.levels[i];
+			const void* data = pixelBuffer != 0 ? (const void*)level.offset : compressed.data.data() + level.offset;
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height, format, (GLsizei)level.size, data);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		setSamplerParams(params);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
 
+	unsigned int loadTexture(const char* filePath) {
+		return loadTexture(filePath, TextureParams());
+	}
+	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap) {
+		return loadTexture(filePath, TextureParams(wrapMode, magFilter, minFilter, mipmap));
+	}
+	unsigned int loadTexture(const char* filePath, const TextureParams& params) {
+		if (params.compression != TextureCompression::NONE || isCompressedTextureFile(filePath)) {
+			CompressedTexture compressed;
+			if (!loadCompressedTexture(filePath, params, &compressed)) {
+				return 0;
+			}
+			return createTexture(compressed, params);
+		}
+		if (params.mipmap && params.mipFilter != MipFilter::DRIVER) {
+			MipChain chain;
+			if (!loadMipChain(filePath, params, &chain)) {
+				return 0;
+			}
+			return createTexture(chain, params);
+		}
+		ImageData image;
+		if (!decodeImage(filePath, params.flipVertically, &image)) {
+			return 0;
+		}
+		return createTexture(image, params);
+	}
 }
-
@@ -3,8 +3,100 @@
 */
 
 #pragma once
+#include <memory>
+#include <vector>
 
 namespace ew {
+	enum class MipFilter {
+		DRIVER = 0, //glGenerateMipmap after upload
+		BOX = 1, //2x2 average, built on the CPU
+		KAISER = 2 //Kaiser windowed sinc, sharper than box with little ringing, built on the CPU
+	};
+
+	enum class TextureCompression {
+		NONE = 0,
+		BC1 = 1, //RGB, 4 bits per pixel
+		BC3 = 2, //RGBA, BC1 color plus a separate alpha block, 8 bits per pixel
+		BC5 = 3, //Two independent channels such as normal map XY, 8 bits per pixel
+		BC7 = 4 //RGBA with better color precision than BC1/BC3, 8 bits per pixel
+	};
+
+	//How a texture is sampled and whether it is flipped to OpenGL's bottom-up row order on load
+	struct TextureParams {
+		//GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, glGenerateMipmap, flipped, not sRGB, uncompressed
+		TextureParams();
+		TextureParams(int wrapMode, int magFilter, int minFilter, bool mipmap, bool flipVertically = true);
+		int wrapMode;
+		int magFilter;
+		int minFilter;
+		bool mipmap;
+		bool flipVertically;
+		bool srgb; //Color data. Stored as sRGB so sampling and CPU mip filtering happen in linear space.
+		MipFilter mipFilter; //CPU filters are opt in, DRIVER keeps mips on the GPU
+		bool useMipCache; //Load CPU built mips from a file next to the source if it is up to date, otherwise build and write one
+		//Block compress on the CPU and keep the result in a .ewtex file next to the source. Mips are always built on the CPU,
+		//with a box filter if mipFilter is DRIVER.
+		TextureCompression compression;
+	};
+
+	struct ImageFree {
+		void operator()(unsigned char* pixels)const;
+	};
+
+	//8 bits per component, rows tightly packed
+	struct ImageData {
+		int width = 0;
+		int height = 0;
+		int numComponents = 0;
+		std::unique_ptr<unsigned char, ImageFree> pixels;
+	};
+
+	struct MipLevel {
+		int width;
+		int height;
+		size_t offset; //Into MipChain::pixels
+	};
+
+	//Every level of a texture in one block, largest first, 8 bits per component
+	struct MipChain {
+		int numComponents = 0;
+		std::vector<MipLevel> levels;
+		std::vector<unsigned char> pixels;
+	};
+
+	struct CompressedLevel {
+		int width;
+		int height;
+		size_t offset; //Into CompressedTexture::data
+		size_t size;
+	};
+
+	//Block compressed levels, largest first
+	struct CompressedTexture {
+		TextureCompression compression = TextureCompression::NONE;
+		bool srgb = false;
+		std::vector<CompressedLevel> levels;
+		std::vector<unsigned char> data;
+	};
+
+	//Pixel transfer format (GL_RED to GL_RGBA) and 8 bit internal format for a number of components
+	int getTextureFormat(int numComponents);
+	int getInternalFormat(int numComponents, bool srgb);
+
+	//Decodes an image file. Safe to call from any thread. Returns false and prints the error on failure.
+	bool decodeImage(const char* filePath, bool flipVertically, ImageData* image);
+	//Uploads a decoded image to a new texture. pixelBuffer is an optional GL_PIXEL_UNPACK_BUFFER holding the pixels
+	//at offset 0, in which case image.pixels is not read.
+	unsigned int createTexture(const ImageData& image, const TextureParams& params, unsigned int pixelBuffer = 0);
+	//Uploads every level of a chain with glTexSubImage2D, without generating mips. pixelBuffer works as above
+	//with the whole of chain.pixels in it.
+	unsigned int createTexture(const MipChain& chain, const TextureParams& params, unsigned int pixelBuffer = 0);
+
+	//Uploads compressed levels directly with glCompressedTexSubImage2D
+	unsigned int createTexture(const CompressedTexture& texture, const TextureParams& params, unsigned int pixelBuffer = 0);
+
 	unsigned int loadTexture(const char* filePath);
 	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
+	//Honors every TextureParams field. A .ewtex file written by writeCompressedTexture is uploaded as is.
+	unsigned int loadTexture(const char* filePath, const TextureParams& params);
 }
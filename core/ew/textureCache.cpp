@@ -0,0 +1,207 @@
+#include "textureCache.h"
+#include "mipmap.h"
+#include "textureCompression.h"
+#include "external/glad.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	TextureHandle::TextureHandle(TextureCache* cache, const std::shared_ptr<TextureEntry>& entry)
+		: m_cache(cache), m_entry(entry)
+	{
+		m_entry->refCount++;
+	}
+
+	TextureHandle::TextureHandle(const TextureHandle& other)
+		: m_cache(other.m_cache), m_entry(other.m_entry)
+	{
+		if (m_entry != nullptr) {
+			m_entry->refCount++;
+		}
+	}
+
+	TextureHandle& TextureHandle::operator=(const TextureHandle& other)
+	{
+		if (other.m_entry != nullptr) {
+			other.m_entry->refCount++;
+		}
+		release();
+		m_cache = other.m_cache;
+		m_entry = other.m_entry;
+		return *this;
+	}
+
+	TextureHandle::~TextureHandle()
+	{
+		release();
+	}
+
+	void TextureHandle::release()
+	{
+		if (m_entry != nullptr && --m_entry->refCount == 0) {
+			m_cache->release(*m_entry);
+		}
+		m_entry.reset();
+		m_cache = nullptr;
+	}
+
+	TextureCache::TextureCache(JobSystem* jobs, float uploadBudgetMs)
+		: m_jobs(jobs), m_uploadBudgetMs(uploadBudgetMs), m_queue(std::make_shared<DecodeQueue>())
+	{
+		glGenBuffers(NUM_PIXEL_BUFFERS, m_pixelBuffers);
+	}
+
+	TextureCache::~TextureCache()
+	{
+		for (auto& it : m_entries)
+		{
+			if (it.second->texture != 0) {
+				glDeleteTextures(1, &it.second->texture);
+			}
+		}
+		glDeleteBuffers(NUM_PIXEL_BUFFERS, m_pixelBuffers);
+	}
+
+	static std::string makeTextureKey(const std::string& filePath, const TextureParams& params) {
+		char suffix[64];
+		snprintf(suffix, sizeof(suffix), "|%x|%x|%x|%d|%d|%d|%d|%d|%d", params.wrapMode, params.magFilter, params.minFilter,
+			params.mipmap ? 1 : 0, params.flipVertically ? 1 : 0, params.srgb ? 1 : 0, (int)params.mipFilter, params.useMipCache ? 1 : 0,
+			(int)params.compression);
+		return filePath + suffix;
+	}
+
+	TextureHandle TextureCache::load(const std::string& filePath, const TextureParams& params)
+	{
+		std::string key = makeTextureKey(filePath, params);
+		auto it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			m_numHits++;
+			return TextureHandle(this, it->second);
+		}
+		std::shared_ptr<TextureEntry> entry = std::make_shared<TextureEntry>();
+		entry->key = key;
+		entry->filePath = filePath;
+		entry->params = params;
+		m_entries[key] = entry;
+		m_numInFlight++;
+
+		//The task holds the queue, so it stays valid if the cache goes away first
+		std::shared_ptr<DecodeQueue> queue = m_queue;
+		JobSystem* jobs = m_jobs;
+		m_jobs->submitBackground([entry, queue, jobs] {
+			const TextureParams& params = entry->params;
+			if (params.compression != TextureCompression::NONE || isCompressedTextureFile(entry->filePath.c_str())) {
+				entry->failed = !loadCompressedTexture(entry->filePath.c_str(), params, &entry->compressed, jobs);
+			}
+			else if (params.mipmap && params.mipFilter != MipFilter::DRIVER) {
+				entry->failed = !loadMipChain(entry->filePath.c_str(), params, &entry->mips, jobs);
+			}
+			else {
+				entry->failed = !decodeImage(entry->filePath.c_str(), params.flipVertically, &entry->image);
+			}
+			std::lock_guard<std::mutex> lock(queue->mutex);
+			queue->entries.push_back(entry);
+			queue->decoded.notify_all();
+		});
+		return TextureHandle(this, entry);
+	}
+
+	unsigned int TextureCache::fillPixelBuffer(const void* data, size_t size)
+	{
+		//Reallocating the buffer orphans the storage a previous upload may still be reading from
+		unsigned int pixelBuffer = m_pixelBuffers[m_nextPixelBuffer];
+		m_nextPixelBuffer = (m_nextPixelBuffer + 1) % NUM_PIXEL_BUFFERS;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		bool ok = mapped != NULL;
+		if (ok) {
+			memcpy(mapped, data, size);
+			ok = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return ok ? pixelBuffer : 0;
+	}
+
+	void TextureCache::upload(TextureEntry& entry)
+	{
+		//All fall back to a plain upload if the buffer could not be mapped
+		if (!entry.compressed.levels.empty()) {
+			entry.width = entry.compressed.levels[0].width;
+			entry.height = entry.compressed.levels[0].height;
+			unsigned int pixelBuffer = fillPixelBuffer(entry.compressed.data.data(), entry.compressed.data.size());
+			entry.texture = createTexture(entry.compressed, entry.params, pixelBuffer);
+			entry.compressed = CompressedTexture();
+			return;
+		}
+		if (!entry.mips.levels.empty()) {
+			entry.width = entry.mips.levels[0].width;
+			entry.height = entry.mips.levels[0].height;
+			unsigned int pixelBuffer = fillPixelBuffer(entry.mips.pixels.data(), entry.mips.pixels.size());
+			entry.texture = createTexture(entry.mips, entry.params, pixelBuffer);
+			entry.mips = MipChain();
+			return;
+		}
+		const ImageData& image = entry.image;
+		entry.width = image.width;
+		entry.height = image.height;
+		unsigned int pixelBuffer = fillPixelBuffer(image.pixels.get(), (size_t)image.width * image.height * image.numComponents);
+		entry.texture = createTexture(image, entry.params, pixelBuffer);
+		entry.image.pixels.reset();
+	}
+
+	void TextureCache::update()
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		while (true) {
+			std::shared_ptr<TextureEntry> entry;
+			{
+				std::lock_guard<std::mutex> lock(m_queue->mutex);
+				if (m_queue->entries.empty()) {
+					break;
+				}
+				entry = m_queue->entries.front();
+				m_queue->entries.pop_front();
+			}
+			m_numInFlight--;
+			//Skip textures whose handles were all released while decoding
+			if (entry->refCount > 0) {
+				if (entry->failed) {
+					printf("Failed to load texture %s\n", entry->filePath.c_str());
+				}
+				else {
+					upload(*entry);
+				}
+			}
+			if (std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= m_uploadBudgetMs) {
+				break;
+			}
+		}
+		m_lastUpdateMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void TextureCache::finish()
+	{
+		float budget = m_uploadBudgetMs;
+		m_uploadBudgetMs = 1e30f;
+		while (m_numInFlight > 0) {
+			{
+				std::unique_lock<std::mutex> lock(m_queue->mutex);
+				m_queue->decoded.wait(lock, [this] { return !m_queue->entries.empty(); });
+			}
+			update();
+		}
+		m_uploadBudgetMs = budget;
+	}
+
+	void TextureCache::release(TextureEntry& entry)
+	{
+		if (entry.texture != 0) {
+			glDeleteTextures(1, &entry.texture);
+			entry.texture = 0;
+		}
+		//The entry may outlive this if its decode task is still running
+		m_entries.erase(entry.key);
+	}
+}
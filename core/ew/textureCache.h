@@ -0,0 +1,104 @@
+#pragma once
+#include "texture.h"
+#include "jobSystem.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ew {
+	class TextureCache;
+
+	//One cached texture. Owned by the cache and any decode task still working on it.
+	struct TextureEntry {
+		std::string key;
+		std::string filePath;
+		TextureParams params;
+		ImageData image; //Freed once uploaded
+		MipChain mips; //Used instead of image when params ask for CPU built mips
+		CompressedTexture compressed; //Used instead of both when params ask for compression
+		bool failed = false; //Set by the decode task
+		unsigned int texture = 0; //0 until uploaded
+		int width = 0;
+		int height = 0;
+		int refCount = 0;
+	};
+
+	//Reference to a cached texture. Copies share the texture, which is deleted once the last handle is gone.
+	//Handles must be copied and destroyed on the GL thread, and may not outlive their cache.
+	class TextureHandle {
+	public:
+		TextureHandle() {};
+		TextureHandle(const TextureHandle& other);
+		TextureHandle& operator=(const TextureHandle& other);
+		~TextureHandle();
+
+		inline bool isValid()const { return m_entry != nullptr; }
+		inline bool isReady()const { return isValid() && m_entry->texture != 0; }
+		//0 until the image has been decoded and uploaded, or if it failed to load
+		inline unsigned int get()const { return isValid() ? m_entry->texture : 0; }
+		inline int getWidth()const { return m_entry->width; }
+		inline int getHeight()const { return m_entry->height; }
+		inline const std::string& getFilePath()const { return m_entry->filePath; }
+	private:
+		friend class TextureCache;
+		TextureHandle(TextureCache* cache, const std::shared_ptr<TextureEntry>& entry);
+		void release();
+
+		TextureCache* m_cache = nullptr;
+		std::shared_ptr<TextureEntry> m_entry;
+	};
+
+	//Loads each file and parameter combination once. Images decode, and build their mips if asked, in parallel
+	//on a JobSystem, and update()
+	//uploads finished ones on the GL thread through a ring of pixel unpack buffers, so decoding the next
+	//textures overlaps with the driver copying the last ones.
+	class TextureCache {
+	public:
+		//uploadBudgetMs is how long update() may spend uploading per frame. At least one texture is uploaded per call.
+		TextureCache(JobSystem* jobs, float uploadBudgetMs = 2.0f);
+		~TextureCache();
+		TextureCache(const TextureCache&) = delete;
+		TextureCache& operator=(const TextureCache&) = delete;
+
+		//Returns the cached texture if this path was already loaded with the same params, otherwise starts decoding it
+		TextureHandle load(const std::string& filePath, const TextureParams& params = TextureParams());
+		//Call once per frame on the GL thread
+		void update();
+		//Blocks until every load so far is uploaded. Use after queueing startup textures.
+		void finish();
+
+		inline size_t getNumTextures()const { return m_entries.size(); }
+		inline unsigned int getNumInFlight()const { return m_numInFlight; }
+		//How many load() calls were served from the cache
+		inline unsigned int getNumHits()const { return m_numHits; }
+		inline float getLastUpdateMs()const { return m_lastUpdateMs; }
+	private:
+		friend class TextureHandle;
+		struct DecodeQueue {
+			std::mutex mutex;
+			std::condition_variable decoded;
+			std::deque<std::shared_ptr<TextureEntry>> entries;
+		};
+		static const int NUM_PIXEL_BUFFERS = 4;
+
+		void upload(TextureEntry& entry);
+		//Copies size bytes into the next pixel unpack buffer. Returns 0 if it could not be mapped.
+		unsigned int fillPixelBuffer(const void* data, size_t size);
+		void release(TextureEntry& entry);
+
+		JobSystem* m_jobs;
+		float m_uploadBudgetMs;
+		std::shared_ptr<DecodeQueue> m_queue;
+		std::unordered_map<std::string, std::shared_ptr<TextureEntry>> m_entries;
+		unsigned int m_pixelBuffers[NUM_PIXEL_BUFFERS] = {};
+		int m_nextPixelBuffer = 0;
+		unsigned int m_numInFlight = 0;
+		unsigned int m_numHits = 0;
+		float m_lastUpdateMs = 0.0f;
+	};
+}
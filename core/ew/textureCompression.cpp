@@ -0,0 +1,824 @@
+#include "textureCompression.h"
+#include "mipmap.h"
+#include "mappedFile.h"
+#include "external/glad.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	static const char TEXTURE_MAGIC[4] = { 'E', 'W', 'T', 'X' };
+	static const uint32_t TEXTURE_VERSION = 1;
+
+	//Rows of blocks compressed per task
+	static const int BLOCK_ROWS_PER_TASK = 8;
+
+	//BC7 4 bit index interpolation weights, out of 64
+	static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct TextureFileHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceMtime;
+		uint64_t sourceSize;
+		uint64_t hash;
+		uint32_t compression;
+		uint32_t srgb;
+		uint32_t numLevels;
+		uint32_t padding;
+	};
+
+	struct TextureFileLevel {
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	//A 4x4 block as RGBA, row by row
+	struct BlockRGBA {
+		unsigned char pixels[16][4];
+	};
+
+	size_t getBlockSize(TextureCompression compression)
+	{
+		return compression == TextureCompression::BC1 ? 8 : 16;
+	}
+
+	size_t getCompressedSize(TextureCompression compression, int width, int height)
+	{
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(compression);
+	}
+
+	static void fetchBlock(const unsigned char* pixels, int width, int height, int numComponents, int blockX, int blockY, BlockRGBA* block) {
+		for (int y = 0; y < 4; y++)
+		{
+			int sy = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+			for (int x = 0; x < 4; x++)
+			{
+				int sx = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+				const unsigned char* p = pixels + ((size_t)sy * width + sx) * numComponents;
+				unsigned char* out = block->pixels[y * 4 + x];
+				switch (numComponents) {
+				case 1:
+					out[0] = out[1] = out[2] = p[0];
+					out[3] = 255;
+					break;
+				case 2:
+					out[0] = p[0];
+					out[1] = p[1];
+					out[2] = 0;
+					out[3] = 255;
+					break;
+				case 3:
+					out[0] = p[0];
+					out[1] = p[1];
+					out[2] = p[2];
+					out[3] = 255;
+					break;
+				default:
+					memcpy(out, p, 4);
+					break;
+				}
+			}
+		}
+	}
+
+	//Mean and direction of greatest variance of the first numChannels channels, by power iteration on the covariance.
+	//axis is zero for a flat block.
+	static void principalAxis(const BlockRGBA& block, int numChannels, float mean[4], float axis[4]) {
+		for (int c = 0; c < 4; c++)
+		{
+			mean[c] = 0.0f;
+			axis[c] = 0.0f;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < numChannels; c++)
+			{
+				mean[c] += block.pixels[i][c] / 16.0f;
+			}
+		}
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float d[4];
+			for (int c = 0; c < numChannels; c++)
+			{
+				d[c] = block.pixels[i][c] - mean[c];
+			}
+			for (int a = 0; a < numChannels; a++)
+			{
+				for (int b = 0; b < numChannels; b++)
+				{
+					covariance[a][b] += d[a] * d[b];
+				}
+			}
+		}
+		float v[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (int a = 0; a < numChannels; a++)
+			{
+				for (int b = 0; b < numChannels; b++)
+				{
+					next[a] += covariance[a][b] * v[b];
+				}
+				length = fmaxf(length, fabsf(next[a]));
+			}
+			if (length < 1e-6f) {
+				return;
+			}
+			for (int a = 0; a < numChannels; a++)
+			{
+				v[a] = next[a] / length;
+			}
+		}
+		float length = 0.0f;
+		for (int c = 0; c < numChannels; c++)
+		{
+			length += v[c] * v[c];
+		}
+		length = sqrtf(length);
+		for (int c = 0; c < numChannels; c++)
+		{
+			axis[c] = v[c] / length;
+		}
+	}
+
+	static inline int clampInt(int v, int lo, int hi) {
+		return v < lo ? lo : (v > hi ? hi : v);
+	}
+
+	static inline uint16_t packRgb565(const float c[3]) {
+		int r = clampInt((int)(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+		int g = clampInt((int)(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+		int b = clampInt((int)(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	static inline void unpackRgb565(uint16_t v, int c[3]) {
+		int r = (v >> 11) & 31;
+		int g = (v >> 5) & 63;
+		int b = v & 31;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	//Picks the nearest of the four colors between c0 and c1 for every pixel. Returns the squared error.
+	static int evaluateBc1(const BlockRGBA& block, uint16_t c0, uint16_t c1, uint32_t* indices) {
+		int palette[4][3];
+		unpackRgb565(c0, palette[0]);
+		unpackRgb565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		int error = 0;
+		*indices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			int bestError = 1 << 30;
+			for (int j = 0; j < 4; j++)
+			{
+				int dr = block.pixels[i][0] - palette[j][0];
+				int dg = block.pixels[i][1] - palette[j][1];
+				int db = block.pixels[i][2] - palette[j][2];
+				int e = dr * dr + dg * dg + db * db;
+				if (e < bestError) {
+					bestError = e;
+					best = j;
+				}
+			}
+			*indices |= (uint32_t)best << (i * 2);
+			error += bestError;
+		}
+		return error;
+	}
+
+	//Endpoints along the principal axis, then one least squares refit to the chosen indices
+	static void encodeBc1(const BlockRGBA& block, unsigned char* output) {
+		float mean[4], axis[4];
+		principalAxis(block, 3, mean, axis);
+		float tMin = 0.0f, tMax = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < 3; c++)
+			{
+				t += (block.pixels[i][c] - mean[c]) * axis[c];
+			}
+			tMin = fminf(tMin, t);
+			tMax = fmaxf(tMax, t);
+		}
+		float e0[3], e1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			e0[c] = mean[c] + axis[c] * tMax;
+			e1[c] = mean[c] + axis[c] * tMin;
+		}
+		uint16_t c0 = packRgb565(e0);
+		uint16_t c1 = packRgb565(e1);
+		uint32_t indices;
+		int error = evaluateBc1(block, c0, c1, &indices);
+
+		//Weight of c0 for each index
+		static const float WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[3] = {}, bx[3] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float a = WEIGHTS[(indices >> (i * 2)) & 3];
+			float b = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < 3; c++)
+			{
+				ax[c] += a * block.pixels[i][c];
+				bx[c] += b * block.pixels[i][c];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (fabsf(det) > 1e-6f) {
+			for (int c = 0; c < 3; c++)
+			{
+				e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+				e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+			}
+			uint16_t r0 = packRgb565(e0);
+			uint16_t r1 = packRgb565(e1);
+			uint32_t refinedIndices;
+			int refinedError = evaluateBc1(block, r0, r1, &refinedIndices);
+			if (refinedError < error) {
+				c0 = r0;
+				c1 = r1;
+				indices = refinedIndices;
+			}
+		}
+
+		//c0 > c1 selects four colors. Swapping the endpoints swaps indices 0/1 and 2/3.
+		if (c0 < c1) {
+			uint16_t swap = c0;
+			c0 = c1;
+			c1 = swap;
+			indices ^= 0x55555555u;
+		}
+		else if (c0 == c1) {
+			indices = 0;
+		}
+		output[0] = (unsigned char)(c0 & 0xff);
+		output[1] = (unsigned char)(c0 >> 8);
+		output[2] = (unsigned char)(c1 & 0xff);
+		output[3] = (unsigned char)(c1 >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			output[4 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	//One channel, eight levels between the block's min and max
+	static void encodeBc4(const BlockRGBA& block, int channel, unsigned char* output) {
+		int lo = 255, hi = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			lo = block.pixels[i][channel] < lo ? block.pixels[i][channel] : lo;
+			hi = block.pixels[i][channel] > hi ? block.pixels[i][channel] : hi;
+		}
+		output[0] = (unsigned char)hi;
+		output[1] = (unsigned char)lo;
+		uint64_t indices = 0;
+		if (hi > lo) {
+			//Index 0 is hi, 1 is lo, 2-7 step from hi to lo
+			static const int ORDER[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+			for (int i = 0; i < 16; i++)
+			{
+				int step = (int)(((block.pixels[i][channel] - lo) * 7.0f) / (hi - lo) + 0.5f);
+				indices |= (uint64_t)ORDER[7 - step] << (i * 3);
+			}
+		}
+		for (int i = 0; i < 6; i++)
+		{
+			output[2 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	//Writes fields least significant bit first
+	struct BitWriter {
+		unsigned char* bytes;
+		int bit = 0;
+		void write(uint32_t value, int numBits) {
+			for (int i = 0; i < numBits; i++, bit++)
+			{
+				if ((value >> i) & 1) {
+					bytes[bit >> 3] |= (unsigned char)(1 << (bit & 7));
+				}
+			}
+		}
+	};
+
+	struct BitReader {
+		const unsigned char* bytes;
+		int bit = 0;
+		uint32_t read(int numBits) {
+			uint32_t value = 0;
+			for (int i = 0; i < numBits; i++, bit++)
+			{
+				value |= (uint32_t)((bytes[bit >> 3] >> (bit & 7)) & 1) << i;
+			}
+			return value;
+		}
+	};
+
+	//Squared error of the best index for each pixel between endpoints v0 and v1
+	static int evaluateBc7(const BlockRGBA& block, const int v0[4], const int v1[4], int indices[16]) {
+		int palette[16][4];
+		for (int j = 0; j < 16; j++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				palette[j][c] = ((64 - BC7_WEIGHTS[j]) * v0[c] + BC7_WEIGHTS[j] * v1[c] + 32) >> 6;
+			}
+		}
+		int d[4];
+		int lengthSquared = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			d[c] = v1[c] - v0[c];
+			lengthSquared += d[c] * d[c];
+		}
+		int error = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			//Project onto the endpoint line, then check the neighbouring indices
+			int guess = 0;
+			if (lengthSquared > 0) {
+				int dot = 0;
+				for (int c = 0; c < 4; c++)
+				{
+					dot += (block.pixels[i][c] - v0[c]) * d[c];
+				}
+				guess = clampInt((int)(dot * 15.0f / lengthSquared + 0.5f), 0, 15);
+			}
+			int best = guess;
+			int bestError = 1 << 30;
+			for (int j = guess > 0 ? guess - 1 : 0; j <= (guess < 15 ? guess + 1 : 15); j++)
+			{
+				int e = 0;
+				for (int c = 0; c < 4; c++)
+				{
+					int diff = block.pixels[i][c] - palette[j][c];
+					e += diff * diff;
+				}
+				if (e < bestError) {
+					bestError = e;
+					best = j;
+				}
+			}
+			indices[i] = best;
+			error += bestError;
+		}
+		return error;
+	}
+
+	//Mode 6 only: one subset, 7 bit RGBA endpoints with a shared low bit each, 4 bit indices.
+	//Covers most color and alpha content well and is the fastest mode to search.
+	static void encodeBc7(const BlockRGBA& block, unsigned char* output) {
+		float mean[4], axis[4];
+		principalAxis(block, 4, mean, axis);
+		float tMin = 0.0f, tMax = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				t += (block.pixels[i][c] - mean[c]) * axis[c];
+			}
+			tMin = fminf(tMin, t);
+			tMax = fmaxf(tMax, t);
+		}
+
+		int bestError = 1 << 30;
+		int bestQ0[4] = {}, bestQ1[4] = {}, bestIndices[16] = {};
+		int bestP0 = 0, bestP1 = 0;
+		for (int pbits = 0; pbits < 4; pbits++)
+		{
+			int p0 = pbits & 1;
+			int p1 = pbits >> 1;
+			int q0[4], q1[4], v0[4], v1[4];
+			for (int c = 0; c < 4; c++)
+			{
+				float e0 = mean[c] + axis[c] * tMin;
+				float e1 = mean[c] + axis[c] * tMax;
+				q0[c] = clampInt((int)floorf((e0 - p0) * 0.5f + 0.5f), 0, 127);
+				q1[c] = clampInt((int)floorf((e1 - p1) * 0.5f + 0.5f), 0, 127);
+				v0[c] = (q0[c] << 1) | p0;
+				v1[c] = (q1[c] << 1) | p1;
+			}
+			int indices[16];
+			int error = evaluateBc7(block, v0, v1, indices);
+			if (error < bestError) {
+				bestError = error;
+				memcpy(bestQ0, q0, sizeof(q0));
+				memcpy(bestQ1, q1, sizeof(q1));
+				memcpy(bestIndices, indices, sizeof(indices));
+				bestP0 = p0;
+				bestP1 = p1;
+			}
+		}
+
+		//The first index is stored without its top bit, so it must be below 8
+		if (bestIndices[0] >= 8) {
+			for (int c = 0; c < 4; c++)
+			{
+				int swap = bestQ0[c];
+				bestQ0[c] = bestQ1[c];
+				bestQ1[c] = swap;
+			}
+			int swap = bestP0;
+			bestP0 = bestP1;
+			bestP1 = swap;
+			for (int i = 0; i < 16; i++)
+			{
+				bestIndices[i] = 15 - bestIndices[i];
+			}
+		}
+
+		memset(output, 0, 16);
+		BitWriter writer;
+		writer.bytes = output;
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.write((uint32_t)bestQ0[c], 7);
+			writer.write((uint32_t)bestQ1[c], 7);
+		}
+		writer.write((uint32_t)bestP0, 1);
+		writer.write((uint32_t)bestP1, 1);
+		for (int i = 0; i < 16; i++)
+		{
+			writer.write((uint32_t)bestIndices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	static void encodeBlock(const BlockRGBA& block, TextureCompression compression, unsigned char* output) {
+		switch (compression) {
+		case TextureCompression::BC1:
+			encodeBc1(block, output);
+			break;
+		case TextureCompression::BC3:
+			encodeBc4(block, 3, output);
+			encodeBc1(block, output + 8);
+			break;
+		case TextureCompression::BC5:
+			encodeBc4(block, 0, output);
+			encodeBc4(block, 1, output + 8);
+			break;
+		case TextureCompression::BC7:
+			encodeBc7(block, output);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void compressImage(const unsigned char* pixels, int width, int height, int numComponents, TextureCompression compression,
+		unsigned char* output, JobSystem* jobs)
+	{
+		int blocksX = (width + 3) / 4;
+		int blocksY = (height + 3) / 4;
+		size_t blockSize = getBlockSize(compression);
+		unsigned int numTasks = (unsigned int)((blocksY + BLOCK_ROWS_PER_TASK - 1) / BLOCK_ROWS_PER_TASK);
+		auto compressRows = [&](unsigned int task) {
+			int endY = ((int)task + 1) * BLOCK_ROWS_PER_TASK < blocksY ? ((int)task + 1) * BLOCK_ROWS_PER_TASK : blocksY;
+			BlockRGBA block;
+			for (int by = (int)task * BLOCK_ROWS_PER_TASK; by < endY; by++)
+			{
+				for (int bx = 0; bx < blocksX; bx++)
+				{
+					fetchBlock(pixels, width, height, numComponents, bx, by, &block);
+					encodeBlock(block, compression, output + ((size_t)by * blocksX + bx) * blockSize);
+				}
+			}
+		};
+		if (jobs != nullptr && numTasks > 1) {
+			jobs->parallelForEach(numTasks, compressRows);
+		}
+		else {
+			for (unsigned int i = 0; i < numTasks; i++)
+			{
+				compressRows(i);
+			}
+		}
+	}
+
+	void compressMipChain(const MipChain& chain, TextureCompression compression, bool srgb, CompressedTexture* texture, JobSystem* jobs)
+	{
+		texture->compression = compression;
+		texture->srgb = srgb;
+		texture->levels.resize(chain.levels.size());
+		size_t totalSize = 0;
+		for (size_t i = 0; i < chain.levels.size(); i++)
+		{
+			CompressedLevel& level = texture->levels[i];
+			level.width = chain.levels[i].width;
+			level.height = chain.levels[i].height;
+			level.offset = totalSize;
+			level.size = getCompressedSize(compression, level.width, level.height);
+			totalSize += level.size;
+		}
+		texture->data.assign(totalSize, 0);
+		for (size_t i = 0; i < chain.levels.size(); i++)
+		{
+			const MipLevel& level = chain.levels[i];
+			compressImage(chain.pixels.data() + level.offset, level.width, level.height, chain.numComponents, compression,
+				texture->data.data() + texture->levels[i].offset, jobs);
+		}
+	}
+
+	static void decodeBc1(const unsigned char* input, unsigned char rgba[16][4], bool alwaysFourColors) {
+		uint16_t c0 = (uint16_t)(input[0] | (input[1] << 8));
+		uint16_t c1 = (uint16_t)(input[2] | (input[3] << 8));
+		uint32_t indices = (uint32_t)input[4] | ((uint32_t)input[5] << 8) | ((uint32_t)input[6] << 16) | ((uint32_t)input[7] << 24);
+		int palette[4][4];
+		unpackRgb565(c0, palette[0]);
+		unpackRgb565(c1, palette[1]);
+		palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+		for (int c = 0; c < 3; c++)
+		{
+			if (c0 > c1 || alwaysFourColors) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else {
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		if (c0 <= c1 && !alwaysFourColors) {
+			palette[3][3] = 0;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (indices >> (i * 2)) & 3;
+			for (int c = 0; c < 4; c++)
+			{
+				rgba[i][c] = (unsigned char)palette[index][c];
+			}
+		}
+	}
+
+	static void decodeBc4(const unsigned char* input, unsigned char rgba[16][4], int channel) {
+		int a0 = input[0];
+		int a1 = input[1];
+		int palette[8] = { a0, a1 };
+		for (int i = 1; i < 7; i++)
+		{
+			palette[i + 1] = a0 > a1 ? ((7 - i) * a0 + i * a1) / 7 : (i < 5 ? ((5 - i) * a0 + i * a1) / 5 : (i == 5 ? 0 : 255));
+		}
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			indices |= (uint64_t)input[2 + i] << (i * 8);
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			rgba[i][channel] = (unsigned char)palette[(indices >> (i * 3)) & 7];
+		}
+	}
+
+	static bool decodeBc7(const unsigned char* input, unsigned char rgba[16][4]) {
+		BitReader reader;
+		reader.bytes = input;
+		if (reader.read(7) != (1 << 6)) {
+			return false;
+		}
+		int v0[4], v1[4];
+		for (int c = 0; c < 4; c++)
+		{
+			v0[c] = (int)reader.read(7) << 1;
+			v1[c] = (int)reader.read(7) << 1;
+		}
+		int p0 = (int)reader.read(1);
+		int p1 = (int)reader.read(1);
+		for (int c = 0; c < 4; c++)
+		{
+			v0[c] |= p0;
+			v1[c] |= p1;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (int)reader.read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; c++)
+			{
+				rgba[i][c] = (unsigned char)(((64 - BC7_WEIGHTS[index]) * v0[c] + BC7_WEIGHTS[index] * v1[c] + 32) >> 6);
+			}
+		}
+		return true;
+	}
+
+	bool decompressImage(const unsigned char* blocks, int width, int height, TextureCompression compression, unsigned char* rgba)
+	{
+		int blocksX = (width + 3) / 4;
+		int blocksY = (height + 3) / 4;
+		size_t blockSize = getBlockSize(compression);
+		unsigned char decoded[16][4];
+		for (int by = 0; by < blocksY; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				const unsigned char* block = blocks + ((size_t)by * blocksX + bx) * blockSize;
+				switch (compression) {
+				case TextureCompression::BC1:
+					decodeBc1(block, decoded, false);
+					break;
+				case TextureCompression::BC3:
+					decodeBc1(block + 8, decoded, true);
+					decodeBc4(block, decoded, 3);
+					break;
+				case TextureCompression::BC5:
+					memset(decoded, 0, sizeof(decoded));
+					decodeBc4(block, decoded, 0);
+					decodeBc4(block + 8, decoded, 1);
+					for (int i = 0; i < 16; i++)
+					{
+						decoded[i][3] = 255;
+					}
+					break;
+				case TextureCompression::BC7:
+					if (!decodeBc7(block, decoded)) {
+						return false;
+					}
+					break;
+				default:
+					return false;
+				}
+				for (int y = 0; y < 4 && by * 4 + y < height; y++)
+				{
+					for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+					{
+						memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, decoded[y * 4 + x], 4);
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	static uint64_t makeCompressedTextureHash(const char* filePath, const TextureParams& params) {
+		uint64_t hash = hashBytes(filePath, strlen(filePath));
+		int fields[6] = { params.flipVertically ? 1 : 0, params.srgb ? 1 : 0, (int)params.mipFilter,
+			params.wrapMode == GL_REPEAT ? 1 : 0, params.mipmap ? 1 : 0, (int)params.compression };
+		return hashBytes(fields, sizeof(fields), hash);
+	}
+
+	bool isCompressedTextureFile(const char* filePath)
+	{
+		size_t length = strlen(filePath);
+		return length >= 6 && strcmp(filePath + length - 6, ".ewtex") == 0;
+	}
+
+	bool loadCompressedTexture(const char* filePath, const TextureParams& params, CompressedTexture* texture, JobSystem* jobs)
+	{
+		if (isCompressedTextureFile(filePath)) {
+			if (!readCompressedTexture(filePath, nullptr, texture)) {
+				printf("Failed to load compressed texture %s\n", filePath);
+				return false;
+			}
+			return true;
+		}
+		MeshCacheKey key;
+		bool cacheable = params.useMipCache && getSourceFileInfo(filePath, &key);
+		std::string cookedPath;
+		if (cacheable) {
+			key.hash = makeCompressedTextureHash(filePath, params);
+			cookedPath = getCompressedTexturePath(filePath, key);
+			if (readCompressedTexture(cookedPath, &key, texture)) {
+				return true;
+			}
+		}
+
+		MipChain chain;
+		if (params.mipmap) {
+			//The compressed file replaces the mip cache, so don't write both
+			TextureParams mipParams = params;
+			mipParams.useMipCache = false;
+			if (!loadMipChain(filePath, mipParams, &chain, jobs)) {
+				return false;
+			}
+		}
+		else {
+			ImageData image;
+			if (!decodeImage(filePath, params.flipVertically, &image)) {
+				return false;
+			}
+			MipLevel level = { image.width, image.height, 0 };
+			chain.numComponents = image.numComponents;
+			chain.levels.push_back(level);
+			chain.pixels.assign(image.pixels.get(), image.pixels.get() + (size_t)image.width * image.height * image.numComponents);
+		}
+		compressMipChain(chain, params.compression, params.srgb, texture, jobs);
+		if (cacheable) {
+			writeCompressedTexture(cookedPath, key, *texture);
+		}
+		return true;
+	}
+
+	std::string getCompressedTexturePath(const std::string& sourcePath, const MeshCacheKey& key)
+	{
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%016llx.ewtex", (unsigned long long)key.hash);
+		return sourcePath + suffix;
+	}
+
+	bool readCompressedTexture(const std::string& filePath, const MeshCacheKey* key, CompressedTexture* texture)
+	{
+		MappedFile file;
+		if (!file.open(filePath.c_str())) {
+			return false;
+		}
+		const unsigned char* data = file.getData();
+		uint64_t size = file.getSize();
+		TextureFileHeader header;
+		if (size < sizeof(header)) {
+			return false;
+		}
+		memcpy(&header, data, sizeof(header));
+		uint64_t dataOffset = sizeof(header) + (uint64_t)header.numLevels * sizeof(TextureFileLevel);
+		if (memcmp(header.magic, TEXTURE_MAGIC, sizeof(TEXTURE_MAGIC)) != 0 || header.version != TEXTURE_VERSION
+			|| header.compression < (uint32_t)TextureCompression::BC1 || header.compression > (uint32_t)TextureCompression::BC7
+			|| header.numLevels == 0 || dataOffset > size) {
+			return false;
+		}
+		if (key != nullptr && (header.sourceMtime != key->sourceMtime || header.sourceSize != key->sourceSize || header.hash != key->hash)) {
+			return false;
+		}
+		texture->compression = (TextureCompression)header.compression;
+		texture->srgb = header.srgb != 0;
+		texture->levels.resize(header.numLevels);
+		uint64_t dataSize = size - dataOffset;
+		for (uint32_t i = 0; i < header.numLevels; i++)
+		{
+			TextureFileLevel level;
+			memcpy(&level, data + sizeof(header) + i * sizeof(TextureFileLevel), sizeof(level));
+			if (level.offset + level.size > dataSize || level.size != getCompressedSize(texture->compression, (int)level.width, (int)level.height)) {
+				printf("Compressed texture %s is truncated\n", filePath.c_str());
+				texture->levels.clear();
+				return false;
+			}
+			texture->levels[i].width = (int)level.width;
+			texture->levels[i].height = (int)level.height;
+			texture->levels[i].offset = (size_t)level.offset;
+			texture->levels[i].size = (size_t)level.size;
+		}
+		texture->data.assign(data + dataOffset, data + size);
+		return true;
+	}
+
+	bool writeCompressedTexture(const std::string& filePath, const MeshCacheKey& key, const CompressedTexture& texture)
+	{
+		TextureFileHeader header;
+		memcpy(header.magic, TEXTURE_MAGIC, sizeof(TEXTURE_MAGIC));
+		header.version = TEXTURE_VERSION;
+		header.sourceMtime = key.sourceMtime;
+		header.sourceSize = key.sourceSize;
+		header.hash = key.hash;
+		header.compression = (uint32_t)texture.compression;
+		header.srgb = texture.srgb ? 1 : 0;
+		header.numLevels = (uint32_t)texture.levels.size();
+		header.padding = 0;
+		std::vector<TextureFileLevel> levels(texture.levels.size());
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			levels[i].width = (uint32_t)texture.levels[i].width;
+			levels[i].height = (uint32_t)texture.levels[i].height;
+			levels[i].offset = texture.levels[i].offset;
+			levels[i].size = texture.levels[i].size;
+		}
+
+		//Write to a temporary file first so a crash never leaves a half written file behind
+		std::string tempPath = filePath + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file == NULL) {
+			printf("Failed to write compressed texture %s\n", filePath.c_str());
+			return false;
+		}
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = ok && fwrite(levels.data(), sizeof(TextureFileLevel), levels.size(), file) == levels.size();
+		ok = ok && fwrite(texture.data.data(), 1, texture.data.size(), file) == texture.data.size();
+		ok = fclose(file) == 0 && ok;
+
+		remove(filePath.c_str());
+		if (!ok || rename(tempPath.c_str(), filePath.c_str()) != 0) {
+			printf("Failed to write compressed texture %s\n", filePath.c_str());
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "texture.h"
+#include "jobSystem.h"
+#include "meshCache.h"
+#include <string>
+
+namespace ew {
+	//Bytes per 4x4 block
+	size_t getBlockSize(TextureCompression compression);
+	//Bytes for a whole level, partial blocks included
+	size_t getCompressedSize(TextureCompression compression, int width, int height);
+
+	//Compresses one level of 8 bit pixels with 1 to 4 components. Gray expands to RGB, missing alpha is opaque.
+	//Edge blocks repeat the last row and column. Rows of blocks are split into jobs.
+	void compressImage(const unsigned char* pixels, int width, int height, int numComponents, TextureCompression compression,
+		unsigned char* output, JobSystem* jobs = nullptr);
+	//Compresses every level of a chain
+	void compressMipChain(const MipChain& chain, TextureCompression compression, bool srgb, CompressedTexture* texture, JobSystem* jobs = nullptr);
+	//Decodes one level back to RGBA8, for measuring quality. BC7 only decodes mode 6, the only mode the encoder writes.
+	bool decompressImage(const unsigned char* blocks, int width, int height, TextureCompression compression, unsigned char* rgba);
+
+	//True for the .ewtex files writeCompressedTexture produces
+	bool isCompressedTextureFile(const char* filePath);
+
+	//Decodes filePath, builds its mips if params.mipmap and compresses them with params.compression. If
+	//params.useMipCache, an up to date .ewtex file is loaded instead, or written after compressing.
+	bool loadCompressedTexture(const char* filePath, const TextureParams& params, CompressedTexture* texture, JobSystem* jobs = nullptr);
+
+	//Where the compressed texture for a key lives, next to the source
+	std::string getCompressedTexturePath(const std::string& sourcePath, const MeshCacheKey& key);
+	//Pass key as nullptr to load an offline compressed file without checking its source.
+	//Returns false on a missing, stale or corrupt file.
+	bool readCompressedTexture(const std::string& filePath, const MeshCacheKey* key, CompressedTexture* texture);
+	bool writeCompressedTexture(const std::string& filePath, const MeshCacheKey& key, const CompressedTexture& texture);
+}
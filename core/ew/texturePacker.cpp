@@ -0,0 +1,381 @@
+#include "texturePacker.h"
+#include "mipmap.h"
+#include "external/glad.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace ew {
+	//std430 layout of one region
+	struct GpuTextureRegion {
+		glm::vec4 offsetScale;
+		int layer;
+		int padding[3];
+	};
+
+	SkylinePacker::SkylinePacker(int width, int height)
+		: m_width(width), m_height(height)
+	{
+		Segment ground = { 0, 0, width };
+		m_skyline.push_back(ground);
+	}
+
+	int SkylinePacker::fitAt(size_t i, int w, int h) const
+	{
+		int x = m_skyline[i].x;
+		if (x + w > m_width) {
+			return -1;
+		}
+		int y = 0;
+		int widthLeft = w;
+		for (size_t j = i; widthLeft > 0; j++)
+		{
+			y = std::max(y, m_skyline[j].y);
+			if (y + h > m_height) {
+				return -1;
+			}
+			widthLeft -= m_skyline[j].width;
+		}
+		return y;
+	}
+
+	bool SkylinePacker::pack(int w, int h, int* x, int* y)
+	{
+		int bestY = -1;
+		size_t bestIndex = 0;
+		for (size_t i = 0; i < m_skyline.size(); i++)
+		{
+			int fitY = fitAt(i, w, h);
+			if (fitY >= 0 && (bestY < 0 || fitY < bestY)) {
+				bestY = fitY;
+				bestIndex = i;
+			}
+		}
+		if (bestY < 0) {
+			return false;
+		}
+		*x = m_skyline[bestIndex].x;
+		*y = bestY;
+
+		//The new top edge replaces whatever it covers
+		Segment top = { *x, bestY + h, w };
+		m_skyline.insert(m_skyline.begin() + bestIndex, top);
+		for (size_t i = bestIndex + 1; i < m_skyline.size(); )
+		{
+			int covered = top.x + top.width - m_skyline[i].x;
+			if (covered <= 0) {
+				break;
+			}
+			if (covered >= m_skyline[i].width) {
+				m_skyline.erase(m_skyline.begin() + i);
+				continue;
+			}
+			m_skyline[i].x += covered;
+			m_skyline[i].width -= covered;
+			break;
+		}
+		for (size_t i = 0; i + 1 < m_skyline.size(); )
+		{
+			if (m_skyline[i].y == m_skyline[i + 1].y) {
+				m_skyline[i].width += m_skyline[i + 1].width;
+				m_skyline.erase(m_skyline.begin() + i + 1);
+			}
+			else {
+				i++;
+			}
+		}
+		return true;
+	}
+
+	int SkylinePacker::getUsedHeight() const
+	{
+		int height = 0;
+		for (size_t i = 0; i < m_skyline.size(); i++)
+		{
+			height = std::max(height, m_skyline[i].y);
+		}
+		return height;
+	}
+
+	struct PackImage {
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> rgba;
+	};
+
+	static void toRgba(const ImageData& image, PackImage* out) {
+		out->width = image.width;
+		out->height = image.height;
+		out->rgba.resize((size_t)image.width * image.height * 4);
+		const unsigned char* src = image.pixels.get();
+		for (size_t i = 0; i < (size_t)image.width * image.height; i++)
+		{
+			const unsigned char* p = src + i * image.numComponents;
+			unsigned char* q = &out->rgba[i * 4];
+			switch (image.numComponents) {
+			case 1:
+				q[0] = q[1] = q[2] = p[0];
+				q[3] = 255;
+				break;
+			case 2:
+				q[0] = p[0];
+				q[1] = p[1];
+				q[2] = 0;
+				q[3] = 255;
+				break;
+			case 3:
+				q[0] = p[0];
+				q[1] = p[1];
+				q[2] = p[2];
+				q[3] = 255;
+				break;
+			default:
+				memcpy(q, p, 4);
+				break;
+			}
+		}
+	}
+
+	//Copies image to (x, y) in a layer, with border texels on every side taken from the opposite edge
+	static void blit(const PackImage& image, std::vector<unsigned char>& layer, int layerWidth, int x, int y, int border) {
+		for (int row = -border; row < image.height + border; row++)
+		{
+			int srcRow = ((row % image.height) + image.height) % image.height;
+			for (int column = -border; column < image.width + border; column++)
+			{
+				int srcColumn = ((column % image.width) + image.width) % image.width;
+				memcpy(&layer[((size_t)(y + border + row) * layerWidth + x + border + column) * 4],
+					&image.rgba[((size_t)srcRow * image.width + srcColumn) * 4], 4);
+			}
+		}
+	}
+
+	static int roundUp(int value, int multiple) {
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	static int nextPowerOfTwo(int value) {
+		int result = 1;
+		while (result < value) {
+			result *= 2;
+		}
+		return result;
+	}
+
+	struct Placement {
+		int layer;
+		int x;
+		int y;
+	};
+
+	//Packs every rectangle into size x size pages, opening more pages if allowed. Returns false if one didn't fit.
+	static bool packPages(const std::vector<int>& widths, const std::vector<int>& heights, int size, bool multiplePages,
+		std::vector<Placement>* placements, int* numPages) {
+		//Tallest first leaves the flattest skyline
+		std::vector<size_t> order(widths.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return heights[a] != heights[b] ? heights[a] > heights[b] : widths[a] > widths[b]; });
+
+		std::vector<SkylinePacker> pages;
+		pages.push_back(SkylinePacker(size, size));
+		placements->assign(widths.size(), Placement());
+		for (size_t k = 0; k < order.size(); k++)
+		{
+			size_t i = order[k];
+			bool placed = false;
+			for (size_t page = 0; page < pages.size() && !placed; page++)
+			{
+				placed = pages[page].pack(widths[i], heights[i], &(*placements)[i].x, &(*placements)[i].y);
+				(*placements)[i].layer = (int)page;
+			}
+			if (!placed && multiplePages) {
+				pages.push_back(SkylinePacker(size, size));
+				placed = pages.back().pack(widths[i], heights[i], &(*placements)[i].x, &(*placements)[i].y);
+				(*placements)[i].layer = (int)pages.size() - 1;
+			}
+			if (!placed) {
+				return false;
+			}
+		}
+		*numPages = (int)pages.size();
+		return true;
+	}
+
+	bool packTextures(const std::vector<std::string>& filePaths, const TexturePackOptions& options, PackedTextures* packed, JobSystem* jobs)
+	{
+		packed->layers.clear();
+		packed->regions.assign(filePaths.size(), TextureRegion());
+		if (filePaths.empty()) {
+			return true;
+		}
+
+		std::vector<PackImage> images(filePaths.size());
+		std::vector<char> decoded(filePaths.size(), 0);
+		auto decode = [&](unsigned int i) {
+			ImageData image;
+			if (decodeImage(filePaths[i].c_str(), options.flipVertically, &image)) {
+				toRgba(image, &images[i]);
+				decoded[i] = 1;
+			}
+		};
+		if (jobs != nullptr) {
+			jobs->parallelForEach((unsigned int)filePaths.size(), decode);
+		}
+		else {
+			for (unsigned int i = 0; i < filePaths.size(); i++)
+			{
+				decode(i);
+			}
+		}
+		for (size_t i = 0; i < filePaths.size(); i++)
+		{
+			if (!decoded[i]) {
+				printf("Failed to pack %s\n", filePaths[i].c_str());
+				return false;
+			}
+		}
+
+		std::vector<std::vector<unsigned char>> layerPixels;
+		int numLevels = 0;
+		if (!options.atlas) {
+			//One texture per layer, at the origin of a layer as big as the largest. Tiling the texture over the rest
+			//keeps filtering at its edges close to what a standalone texture gives.
+			int width = 0, height = 0;
+			for (size_t i = 0; i < images.size(); i++)
+			{
+				width = std::max(width, images[i].width);
+				height = std::max(height, images[i].height);
+			}
+			if (width > options.maxSize || height > options.maxSize) {
+				printf("Textures are larger than the %d texel limit\n", options.maxSize);
+				return false;
+			}
+			packed->width = width;
+			packed->height = height;
+			layerPixels.resize(images.size());
+			for (size_t i = 0; i < images.size(); i++)
+			{
+				layerPixels[i].resize((size_t)width * height * 4);
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						memcpy(&layerPixels[i][((size_t)y * width + x) * 4],
+							&images[i].rgba[((size_t)(y % images[i].height) * images[i].width + x % images[i].width) * 4], 4);
+					}
+				}
+				TextureRegion& region = packed->regions[i];
+				region.layer = (int)i;
+				region.scale = glm::vec2((float)images[i].width / width, (float)images[i].height / height);
+			}
+		}
+		else {
+			//Mips past the level where the padding is one texel would mix neighbours. Aligning every rectangle to
+			//that level's texel size keeps each one's texels from sharing a mip texel with another.
+			int padding = std::max(options.padding, 0);
+			numLevels = 1;
+			while ((2 << (numLevels - 1)) <= padding) {
+				numLevels++;
+			}
+			int alignment = 1 << (numLevels - 1);
+
+			std::vector<int> widths(images.size()), heights(images.size());
+			int largest = 1;
+			for (size_t i = 0; i < images.size(); i++)
+			{
+				widths[i] = roundUp(images[i].width + padding * 2, alignment);
+				heights[i] = roundUp(images[i].height + padding * 2, alignment);
+				largest = std::max(largest, std::max(widths[i], heights[i]));
+			}
+			if (largest > options.maxSize) {
+				printf("Textures are larger than the %d texel limit\n", options.maxSize);
+				return false;
+			}
+			//Smallest square that holds everything on one layer, or as many maxSize layers as it takes
+			std::vector<Placement> placements;
+			int numPages = 0;
+			int size = nextPowerOfTwo(largest);
+			while (!packPages(widths, heights, std::min(size, options.maxSize), size >= options.maxSize, &placements, &numPages)) {
+				size *= 2;
+			}
+			size = std::min(size, options.maxSize);
+			packed->width = size;
+			packed->height = size;
+			layerPixels.resize(numPages);
+			for (int page = 0; page < numPages; page++)
+			{
+				layerPixels[page].assign((size_t)size * size * 4, 0);
+			}
+			for (size_t i = 0; i < images.size(); i++)
+			{
+				const Placement& placement = placements[i];
+				blit(images[i], layerPixels[placement.layer], size, placement.x, placement.y, padding);
+				TextureRegion& region = packed->regions[i];
+				region.layer = placement.layer;
+				region.offset = glm::vec2((float)(placement.x + padding) / size, (float)(placement.y + padding) / size);
+				region.scale = glm::vec2((float)images[i].width / size, (float)images[i].height / size);
+			}
+		}
+
+		packed->layers.resize(layerPixels.size());
+		for (size_t i = 0; i < layerPixels.size(); i++)
+		{
+			MipChain& chain = packed->layers[i];
+			buildMipChain(layerPixels[i].data(), packed->width, packed->height, 4, options.mipFilter, options.srgb, !options.atlas, &chain, jobs);
+			if (numLevels > 0 && (int)chain.levels.size() > numLevels) {
+				const MipLevel& last = chain.levels[numLevels - 1];
+				chain.pixels.resize(last.offset + (size_t)last.width * last.height * 4);
+				chain.levels.resize(numLevels);
+			}
+			layerPixels[i] = std::vector<unsigned char>();
+		}
+		return true;
+	}
+
+	unsigned int createTextureArray(const PackedTextures& packed, const TextureParams& params)
+	{
+		if (packed.layers.empty()) {
+			return 0;
+		}
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		GLsizei numLevels = (GLsizei)packed.layers[0].levels.size();
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, numLevels, params.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, packed.width, packed.height,
+			(GLsizei)packed.layers.size());
+		for (size_t layer = 0; layer < packed.layers.size(); layer++)
+		{
+			const MipChain& chain = packed.layers[layer];
+			for (GLsizei level = 0; level < numLevels; level++)
+			{
+				const MipLevel& mip = chain.levels[level];
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, (GLint)layer, mip.width, mip.height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+					chain.pixels.data() + mip.offset);
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, params.wrapMode);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, params.wrapMode);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, params.minFilter);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, params.magFilter);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		return texture;
+	}
+
+	unsigned int createRegionBuffer(const PackedTextures& packed)
+	{
+		std::vector<GpuTextureRegion> regions(packed.regions.size() > 0 ? packed.regions.size() : 1);
+		for (size_t i = 0; i < packed.regions.size(); i++)
+		{
+			const TextureRegion& region = packed.regions[i];
+			regions[i].offsetScale = glm::vec4(region.offset.x, region.offset.y, region.scale.x, region.scale.y);
+			regions[i].layer = region.layer;
+		}
+		unsigned int buffer;
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, sizeof(GpuTextureRegion) * regions.size(), regions.data(), 0);
+		return buffer;
+	}
+}
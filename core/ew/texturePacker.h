@@ -0,0 +1,69 @@
+#pragma once
+#include "texture.h"
+#include "jobSystem.h"
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace ew {
+	//Bottom-left skyline rectangle packer. Keeps the top edge of everything placed so far as a list of horizontal
+	//segments and puts each rectangle where it rests lowest.
+	class SkylinePacker {
+	public:
+		SkylinePacker(int width, int height);
+		//Returns false if w x h doesn't fit
+		bool pack(int w, int h, int* x, int* y);
+		inline int getWidth()const { return m_width; }
+		inline int getHeight()const { return m_height; }
+		//Area below the skyline, placed or wasted
+		int getUsedHeight()const;
+	private:
+		struct Segment {
+			int x;
+			int y;
+			int width;
+		};
+		//Lowest y where a w x h rectangle starting at segment i fits, or -1
+		int fitAt(size_t i, int w, int h)const;
+
+		int m_width;
+		int m_height;
+		std::vector<Segment> m_skyline;
+	};
+
+	//Where a packed texture ended up. Sample at vec3(offset + fract(uv) * scale, layer).
+	struct TextureRegion {
+		int layer = 0;
+		glm::vec2 offset = glm::vec2(0.0f);
+		glm::vec2 scale = glm::vec2(1.0f);
+	};
+
+	struct TexturePackOptions {
+		//false gives every texture its own array layer. true skyline packs them into as few layers as fit,
+		//for many small textures.
+		bool atlas = false;
+		int maxSize = 4096; //Largest layer width and height
+		//Atlas only. Texels copied around each texture, wrapping from the opposite edge. Mips stop at the level
+		//where this shrinks to one texel so neighbours never bleed in.
+		int padding = 8;
+		MipFilter mipFilter = MipFilter::BOX;
+		bool srgb = false;
+		bool flipVertically = true;
+	};
+
+	//CPU side of a packed texture array, RGBA8
+	struct PackedTextures {
+		int width = 0;
+		int height = 0;
+		std::vector<MipChain> layers; //Same size and number of levels
+		std::vector<TextureRegion> regions; //One per input, in input order
+	};
+
+	//Decodes filePaths as jobs and packs them. Returns false if one can't be decoded or doesn't fit in maxSize.
+	bool packTextures(const std::vector<std::string>& filePaths, const TexturePackOptions& options, PackedTextures* packed,
+		JobSystem* jobs = nullptr);
+	//Uploads every layer and level to a new GL_TEXTURE_2D_ARRAY. params.srgb picks the internal format.
+	unsigned int createTextureArray(const PackedTextures& packed, const TextureParams& params);
+	//Shader storage buffer of { vec4 offsetScale; int layer; } per region, std430
+	unsigned int createRegionBuffer(const PackedTextures& packed);
+}
@@ -0,0 +1,293 @@
+#include "textureStreamer.h"
+#include "mipmap.h"
+#include "external/glad.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+
+namespace ew {
+	//Level reads in flight at once. More only queue up behind each other and hold their bytes against the budget.
+	static const unsigned int MAX_PENDING_READS = 4;
+
+	float getScreenSize(const Camera& camera, const glm::vec3& center, float radius, int screenHeight)
+	{
+		if (camera.orthographic) {
+			return 2.0f * radius / camera.orthoHeight * screenHeight;
+		}
+		float distance = glm::length(center - camera.position);
+		if (distance <= radius) {
+			return (float)screenHeight;
+		}
+		return radius / (distance * tanf(glm::radians(camera.fov) * 0.5f)) * screenHeight;
+	}
+
+	TextureStreamer::TextureStreamer(JobSystem* jobs, size_t budgetBytes, int tailSize, float uploadBudgetMs)
+		: m_jobs(jobs), m_budgetBytes(budgetBytes), m_tailSize(tailSize), m_uploadBudgetMs(uploadBudgetMs),
+		m_queue(std::make_shared<ResultQueue>())
+	{
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			if (m_entries[i].texture != 0) {
+				glDeleteTextures(1, &m_entries[i].texture);
+			}
+		}
+	}
+
+	int TextureStreamer::load(const std::string& filePath, const TextureParams& params)
+	{
+		char suffix[64];
+		snprintf(suffix, sizeof(suffix), "|%x|%x|%x|%d|%d|%d", params.wrapMode, params.magFilter, params.minFilter,
+			params.flipVertically ? 1 : 0, params.srgb ? 1 : 0, (int)params.mipFilter);
+		std::string key = filePath + suffix;
+		auto it = m_ids.find(key);
+		if (it != m_ids.end()) {
+			return it->second;
+		}
+		int id = (int)m_entries.size();
+		m_ids[key] = id;
+		m_entries.push_back(Entry());
+		Entry& entry = m_entries.back();
+		entry.filePath = filePath;
+		entry.params = params;
+
+		//Cook if needed, then read just the levels up to tailSize. The task holds the queue, so it stays valid
+		//if the streamer goes away first.
+		std::shared_ptr<ResultQueue> queue = m_queue;
+		JobSystem* jobs = m_jobs;
+		int tailSize = m_tailSize;
+		m_jobs->submitBackground([id, filePath, params, tailSize, queue, jobs] {
+			Result result;
+			result.id = id;
+			result.firstLevel = 0;
+			result.failed = !cookMipChain(filePath.c_str(), params, &result.cookedPath, &result.key, jobs)
+				|| !readMipChain(result.cookedPath, result.key, &result.chain, 0, 0);
+			if (!result.failed) {
+				const std::vector<MipLevel>& levels = result.chain.levels;
+				int tailLevel = (int)levels.size() - 1;
+				while (tailLevel > 0 && std::max(levels[tailLevel - 1].width, levels[tailLevel - 1].height) <= tailSize) {
+					tailLevel--;
+				}
+				result.firstLevel = tailLevel;
+				result.failed = !readMipChain(result.cookedPath, result.key, &result.chain, tailLevel);
+			}
+			std::lock_guard<std::mutex> lock(queue->mutex);
+			queue->results.push_back(std::move(result));
+		});
+		return id;
+	}
+
+	void TextureStreamer::request(int id, float screenSize)
+	{
+		Entry& entry = m_entries[id];
+		if (entry.lastRequestFrame != m_frame) {
+			entry.lastRequestFrame = m_frame;
+			entry.screenSize = 0.0f;
+		}
+		entry.screenSize = std::max(entry.screenSize, screenSize);
+	}
+
+	size_t TextureStreamer::getLevelBytes(const Entry& entry, int firstLevel)const
+	{
+		size_t bytes = 0;
+		for (size_t i = firstLevel; i < entry.levels.size(); i++)
+		{
+			bytes += (size_t)entry.levels[i].width * entry.levels[i].height * entry.numComponents;
+		}
+		return bytes;
+	}
+
+	int TextureStreamer::getWantedLevel(const Entry& entry)const
+	{
+		//One texel per pixel across the object, assuming the texture covers it once
+		int size = std::max(entry.levels[0].width, entry.levels[0].height);
+		int level = 0;
+		while (level < entry.tailLevel && (size >> (level + 1)) >= entry.screenSize) {
+			level++;
+		}
+		return level;
+	}
+
+	void TextureStreamer::setResidency(Entry& entry, int firstLevel, const MipChain* chain)
+	{
+		int numLevels = (int)entry.levels.size();
+		unsigned int texture;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, numLevels - firstLevel, getInternalFormat(entry.numComponents, entry.params.srgb),
+			entry.levels[firstLevel].width, entry.levels[firstLevel].height);
+
+		//New levels from the chain, the rest copied on the GPU from the old texture
+		int copyLevel = std::max(firstLevel, entry.residentLevel);
+		if (chain != nullptr) {
+			int format = getTextureFormat(entry.numComponents);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			for (int level = firstLevel; level < copyLevel; level++)
+			{
+				const MipLevel& mip = chain->levels[level];
+				glTextureSubImage2D(texture, level - firstLevel, 0, 0, mip.width, mip.height, format, GL_UNSIGNED_BYTE,
+					chain->pixels.data() + mip.offset);
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		}
+		if (entry.texture != 0) {
+			for (int level = copyLevel; level < numLevels; level++)
+			{
+				glCopyImageSubData(entry.texture, GL_TEXTURE_2D, level - entry.residentLevel, 0, 0, 0,
+					texture, GL_TEXTURE_2D, level - firstLevel, 0, 0, 0, entry.levels[level].width, entry.levels[level].height, 1);
+			}
+			glDeleteTextures(1, &entry.texture);
+		}
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, entry.params.wrapMode);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, entry.params.wrapMode);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, entry.params.minFilter);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, entry.params.magFilter);
+
+		size_t bytes = getLevelBytes(entry, firstLevel);
+		m_residentBytes = m_residentBytes - entry.residentBytes + bytes;
+		entry.residentBytes = bytes;
+		entry.residentLevel = firstLevel;
+		entry.texture = texture;
+	}
+
+	void TextureStreamer::apply(Result& result)
+	{
+		Entry& entry = m_entries[result.id];
+		if (!entry.loaded) {
+			entry.loaded = true;
+			if (result.failed) {
+				printf("Failed to stream texture %s\n", entry.filePath.c_str());
+				entry.failed = true;
+				return;
+			}
+			entry.cookedPath = result.cookedPath;
+			entry.key = result.key;
+			entry.numComponents = result.chain.numComponents;
+			entry.levels = result.chain.levels;
+			entry.tailLevel = result.firstLevel;
+			entry.residentLevel = (int)entry.levels.size();
+			setResidency(entry, entry.tailLevel, &result.chain);
+			return;
+		}
+
+		entry.pending = false;
+		m_numPending--;
+		m_pendingBytes -= getLevelBytes(entry, result.firstLevel) - entry.residentBytes;
+		//A failed read means the source changed since it was cooked. Keep what is resident rather than retrying every frame.
+		if (result.failed) {
+			printf("Failed to stream levels of %s\n", entry.filePath.c_str());
+			entry.failed = true;
+			return;
+		}
+		setResidency(entry, result.firstLevel, &result.chain);
+		m_stats.numStreamedIn++;
+	}
+
+	bool TextureStreamer::evict(size_t target, int skipId, FrameArena* arena)
+	{
+		FrameVector<int> order(arena);
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			const Entry& entry = m_entries[i];
+			if ((int)i != skipId && entry.texture != 0 && !entry.pending && entry.residentLevel < entry.tailLevel) {
+				order.push_back((int)i);
+			}
+		}
+		std::sort(order.begin(), order.end(), [this](int a, int b) { return m_entries[a].lastRequestFrame < m_entries[b].lastRequestFrame; });
+		for (size_t i = 0; i < order.size() && m_residentBytes > target; i++)
+		{
+			Entry& entry = m_entries[order[i]];
+			int keepLevel = entry.lastRequestFrame == m_frame ? getWantedLevel(entry) : entry.tailLevel;
+			if (entry.residentLevel < keepLevel) {
+				setResidency(entry, keepLevel, nullptr);
+				m_stats.numEvicted++;
+			}
+		}
+		return m_residentBytes <= target;
+	}
+
+	void TextureStreamer::update(FrameArena* arena)
+	{
+		m_stats.numStreamedIn = 0;
+		m_stats.numEvicted = 0;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		while (true) {
+			Result result;
+			{
+				std::lock_guard<std::mutex> lock(m_queue->mutex);
+				if (m_queue->results.empty()) {
+					break;
+				}
+				result = std::move(m_queue->results.front());
+				m_queue->results.pop_front();
+			}
+			apply(result);
+			if (std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= m_uploadBudgetMs) {
+				break;
+			}
+		}
+
+		//A lowered budget takes effect right away
+		if (m_residentBytes > m_budgetBytes) {
+			evict(m_budgetBytes, -1, arena);
+		}
+
+		//Largest on screen first
+		FrameVector<int> wanted(arena);
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			const Entry& entry = m_entries[i];
+			if (entry.texture != 0 && !entry.failed && !entry.pending && entry.lastRequestFrame == m_frame
+				&& getWantedLevel(entry) < entry.residentLevel) {
+				wanted.push_back((int)i);
+			}
+		}
+		std::sort(wanted.begin(), wanted.end(), [this](int a, int b) { return m_entries[a].screenSize > m_entries[b].screenSize; });
+		for (size_t i = 0; i < wanted.size() && m_numPending < MAX_PENDING_READS; i++)
+		{
+			Entry& entry = m_entries[wanted[i]];
+			int firstLevel = getWantedLevel(entry);
+			size_t bytes = getLevelBytes(entry, firstLevel) - entry.residentBytes;
+			if (bytes + m_pendingBytes > m_budgetBytes) {
+				continue;
+			}
+			size_t target = m_budgetBytes - m_pendingBytes - bytes;
+			if (m_residentBytes > target && !evict(target, wanted[i], arena)) {
+				continue;
+			}
+			entry.pending = true;
+			m_numPending++;
+			m_pendingBytes += bytes;
+
+			std::shared_ptr<ResultQueue> queue = m_queue;
+			int id = wanted[i];
+			std::string cookedPath = entry.cookedPath;
+			MeshCacheKey key = entry.key;
+			int numLevels = entry.residentLevel - firstLevel;
+			m_jobs->submitBackground([id, firstLevel, numLevels, cookedPath, key, queue] {
+				Result result;
+				result.id = id;
+				result.firstLevel = firstLevel;
+				result.failed = !readMipChain(cookedPath, key, &result.chain, firstLevel, numLevels);
+				std::lock_guard<std::mutex> lock(queue->mutex);
+				queue->results.push_back(std::move(result));
+			});
+		}
+
+		m_stats.residentBytes = m_residentBytes;
+		m_stats.budgetBytes = m_budgetBytes;
+		m_stats.numPending = m_numPending;
+		m_stats.numLoading = 0;
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			if (!m_entries[i].loaded) {
+				m_stats.numLoading++;
+			}
+		}
+		m_frame++;
+	}
+}
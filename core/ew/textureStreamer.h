@@ -0,0 +1,118 @@
+#pragma once
+#include "texture.h"
+#include "jobSystem.h"
+#include "meshCache.h"
+#include "camera.h"
+#include "frameArena.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+namespace ew {
+	//Diameter in pixels that a sphere covers on a screenHeight tall viewport
+	float getScreenSize(const Camera& camera, const glm::vec3& center, float radius, int screenHeight);
+
+	struct TextureStreamingStats {
+		size_t residentBytes = 0;
+		size_t budgetBytes = 0;
+		unsigned int numPending = 0; //Level reads queued or running in the background
+		unsigned int numLoading = 0; //Textures whose smallest levels aren't uploaded yet
+		unsigned int numStreamedIn = 0; //Since the last update
+		unsigned int numEvicted = 0; //Since the last update
+	};
+
+	//Streams the levels of cooked mip chains in and out of VRAM. Each texture starts with only its levels up to
+	//tailSize uploaded. Larger levels are read from the cooked file in the background when an object using the texture is
+	//big enough on screen to need them, biggest first. When the budget would be exceeded, levels of the least
+	//recently requested textures are dropped again. Changing residency reallocates the texture, so call
+	//getTexture() every frame instead of keeping the name.
+	class TextureStreamer {
+	public:
+		//uploadBudgetMs is how long update() may spend uploading per frame. At least one result is uploaded per call.
+		TextureStreamer(JobSystem* jobs, size_t budgetBytes, int tailSize = 64, float uploadBudgetMs = 2.0f);
+		~TextureStreamer();
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		//Returns the id of the texture for this path and params, cooking its mips in the background the first time.
+		//params.mipFilter picks the filter, DRIVER is treated as box.
+		int load(const std::string& filePath, const TextureParams& params = TextureParams());
+		//Call every frame for every object drawn with the texture, with its size on screen in pixels
+		void request(int id, float screenSize);
+		inline void request(int id, const Camera& camera, const glm::vec3& center, float radius, int screenHeight) {
+			request(id, getScreenSize(camera, center, radius, screenHeight));
+		}
+		//Call once per frame on the GL thread, after the frame's requests. Scratch lists go in arena if given.
+		void update(FrameArena* arena = nullptr);
+
+		//0 until the smallest levels are uploaded, or if it failed to load
+		unsigned int getTexture(int id)const { return m_entries[id].texture; }
+		//Largest level in VRAM, 0 being full resolution. Equal to getNumLevels() while nothing is resident.
+		int getResidentLevel(int id)const { return m_entries[id].residentLevel; }
+		int getNumLevels(int id)const { return (int)m_entries[id].levels.size(); }
+		inline size_t getNumTextures()const { return m_entries.size(); }
+
+		inline void setBudgetBytes(size_t budgetBytes) { m_budgetBytes = budgetBytes; }
+		inline size_t getBudgetBytes()const { return m_budgetBytes; }
+		inline size_t getResidentBytes()const { return m_residentBytes; }
+		inline unsigned int getNumPending()const { return m_numPending; }
+		inline const TextureStreamingStats& getStats()const { return m_stats; }
+	private:
+		struct Entry {
+			std::string filePath;
+			TextureParams params;
+			std::string cookedPath;
+			MeshCacheKey key;
+			int numComponents = 0;
+			std::vector<MipLevel> levels; //Every level, offsets unused
+			bool loaded = false;
+			bool failed = false;
+			bool pending = false;
+			unsigned int texture = 0;
+			int residentLevel = 0;
+			int tailLevel = 0; //Never evicted
+			size_t residentBytes = 0;
+			float screenSize = 0.0f; //Largest requested this frame
+			uint64_t lastRequestFrame = 0;
+		};
+		//A cooked chain with levels [firstLevel, endLevel) read, handed from a background task to update()
+		struct Result {
+			int id;
+			bool failed;
+			int firstLevel;
+			std::string cookedPath; //Set by the first load only
+			MeshCacheKey key;
+			MipChain chain;
+		};
+		struct ResultQueue {
+			std::mutex mutex;
+			std::deque<Result> results;
+		};
+
+		void apply(Result& result);
+		//Reallocates the texture with levels [firstLevel, end). Levels above the current residency come from chain.
+		void setResidency(Entry& entry, int firstLevel, const MipChain* chain);
+		size_t getLevelBytes(const Entry& entry, int firstLevel)const;
+		int getWantedLevel(const Entry& entry)const;
+		//Drops levels, least recently requested textures first, until residentBytes fits target. Textures requested
+		//this frame keep what they need. Returns false if that wasn't enough.
+		bool evict(size_t target, int skipId, FrameArena* arena);
+
+		JobSystem* m_jobs;
+		size_t m_budgetBytes;
+		int m_tailSize;
+		float m_uploadBudgetMs;
+		std::shared_ptr<ResultQueue> m_queue;
+		std::vector<Entry> m_entries;
+		std::unordered_map<std::string, int> m_ids;
+		uint64_t m_frame = 1;
+		size_t m_residentBytes = 0;
+		size_t m_pendingBytes = 0;
+		unsigned int m_numPending = 0;
+		TextureStreamingStats m_stats;
+	};
+}
@@ -0,0 +1,110 @@
+#include "transformHierarchy.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_HIERARCHY_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace ew {
+	//out = a * b for column major matrices. out may not alias a or b.
+	static void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4* out)
+	{
+#ifdef EW_HIERARCHY_SSE
+		const float* pa = &a[0][0];
+		const float* pb = &b[0][0];
+		float* po = &(*out)[0][0];
+		__m128 a0 = _mm_loadu_ps(pa);
+		__m128 a1 = _mm_loadu_ps(pa + 4);
+		__m128 a2 = _mm_loadu_ps(pa + 8);
+		__m128 a3 = _mm_loadu_ps(pa + 12);
+		//Column j of the result is a's columns weighted by column j of b
+		for (int j = 0; j < 4; j++)
+		{
+			const float* column = pb + j * 4;
+			__m128 sum = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+			_mm_storeu_ps(po + j * 4, sum);
+		}
+#else
+		*out = a * b;
+#endif
+	}
+
+	int TransformHierarchy::addNode(int parent, const glm::mat4& localTransform)
+	{
+		int node = (int)m_parents.size();
+		if (parent >= node) {
+			printf("Transform hierarchy parent %d must be added before its children\n", parent);
+			parent = -1;
+		}
+		m_parents.push_back(parent);
+		m_localTransforms.push_back(localTransform);
+		m_globalTransforms.push_back(localTransform);
+		m_dirty.push_back(1);
+		m_firstDirty = std::min(m_firstDirty, (size_t)node);
+		return node;
+	}
+
+	void TransformHierarchy::reserve(size_t numNodes)
+	{
+		m_parents.reserve(numNodes);
+		m_localTransforms.reserve(numNodes);
+		m_globalTransforms.reserve(numNodes);
+		m_dirty.reserve(numNodes);
+	}
+
+	void TransformHierarchy::clear()
+	{
+		m_parents.clear();
+		m_localTransforms.clear();
+		m_globalTransforms.clear();
+		m_dirty.clear();
+		m_firstDirty = 0;
+		m_numUpdated = 0;
+	}
+
+	void TransformHierarchy::setLocalTransform(int node, const glm::mat4& localTransform)
+	{
+		m_localTransforms[node] = localTransform;
+		m_dirty[node] = 1;
+		m_firstDirty = std::min(m_firstDirty, (size_t)node);
+	}
+
+	void TransformHierarchy::update()
+	{
+		m_numUpdated = 0;
+		size_t numNodes = m_parents.size();
+		if (m_firstDirty >= numNodes) {
+			return;
+		}
+		const int* parents = m_parents.data();
+		const glm::mat4* locals = m_localTransforms.data();
+		glm::mat4* globals = m_globalTransforms.data();
+		unsigned char* dirty = m_dirty.data();
+		//Dirty spreads down the tree as the sweep reaches each child, since its parent was already visited
+		for (size_t i = m_firstDirty; i < numNodes; i++)
+		{
+			int parent = parents[i];
+			if (parent >= 0) {
+				dirty[i] |= dirty[parent];
+			}
+			if (!dirty[i]) {
+				continue;
+			}
+			if (parent >= 0) {
+				multiply(globals[parent], locals[i], &globals[i]);
+			}
+			else {
+				globals[i] = locals[i];
+			}
+			m_numUpdated++;
+		}
+		memset(dirty + m_firstDirty, 0, numNodes - m_firstDirty);
+		m_firstDirty = numNodes;
+	}
+}
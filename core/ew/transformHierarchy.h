@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace ew {
+	//Tree of transforms stored as flat arrays indexed by node. Every parent comes before its children, so one
+	//pass in index order computes each global transform after its parent's. Only nodes whose local transform was
+	//set since the last update, and their descendants, are recomputed.
+	class TransformHierarchy {
+	public:
+		//parent is -1 for a root. It must already be in the hierarchy, which keeps parents before children.
+		//Returns the new node's index.
+		int addNode(int parent, const glm::mat4& localTransform = glm::mat4(1.0f));
+		void reserve(size_t numNodes);
+		void clear();
+
+		void setLocalTransform(int node, const glm::mat4& localTransform);
+		inline const glm::mat4& getLocalTransform(int node)const { return m_localTransforms[node]; }
+		//As of the last update()
+		inline const glm::mat4& getGlobalTransform(int node)const { return m_globalTransforms[node]; }
+		inline const glm::mat4* getGlobalTransforms()const { return m_globalTransforms.data(); }
+		inline int getParent(int node)const { return m_parents[node]; }
+		inline size_t getNumNodes()const { return m_parents.size(); }
+
+		//Recomputes the global transforms of dirty nodes and their descendants
+		void update();
+		//Global transforms recomputed by the last update()
+		inline unsigned int getNumUpdated()const { return m_numUpdated; }
+	private:
+		std::vector<int> m_parents;
+		std::vector<glm::mat4> m_localTransforms;
+		std::vector<glm::mat4> m_globalTransforms;
+		std::vector<unsigned char> m_dirty;
+		size_t m_firstDirty = 0; //Nothing before this is dirty. getNumNodes() if nothing is.
+		unsigned int m_numUpdated = 0;
+	};
+}
@@ -0,0 +1,133 @@
+#include "vertexLayout.h"
+#include <string.h>
+#include <math.h>
+
+namespace ew {
+	//Out of class definitions so attributes() can return the tables before C++17
+	constexpr VertexAttribute StandardLayout::ATTRIBUTES[];
+	constexpr VertexAttribute CompactLayout::ATTRIBUTES[];
+
+	uint16_t encodeHalf(float f)
+	{
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+		uint32_t absBits = bits & 0x7fffffff;
+
+		//NaN stays NaN, anything too large becomes infinity
+		if (absBits > 0x7f800000) {
+			return sign | 0x7e00;
+		}
+		if (absBits >= 0x477ff000) {
+			return sign | 0x7c00;
+		}
+		//Denormal halfs, shift the mantissa with its implicit bit and round to nearest even
+		if (absBits < 0x38800000) {
+			if (absBits < 0x33000000) {
+				return sign;
+			}
+			uint32_t exponent = absBits >> 23;
+			uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+			uint32_t shift = 126 - exponent;
+			uint32_t half = mantissa >> shift;
+			uint32_t remainder = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (half & 1))) {
+				half++;
+			}
+			return sign | (uint16_t)half;
+		}
+		//Normal halfs, rebias the exponent and round to nearest even
+		uint32_t half = (absBits - 0x38000000) >> 13;
+		uint32_t remainder = absBits & 0x1fff;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+			half++;
+		}
+		return sign | (uint16_t)half;
+	}
+
+	float decodeHalf(uint16_t h)
+	{
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1f;
+		uint32_t mantissa = h & 0x3ff;
+		uint32_t bits;
+		if (exponent == 0x1f) {
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		}
+		else if (exponent != 0) {
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+		else if (mantissa != 0) {
+			//Denormal, normalize it for float
+			exponent = 113;
+			while ((mantissa & 0x400) == 0) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+		else {
+			bits = sign;
+		}
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	int16_t encodeSnorm16(float f)
+	{
+		f = glm::clamp(f, -1.0f, 1.0f);
+		return (int16_t)roundf(f * 32767.0f);
+	}
+
+	uint16_t encodeUnorm16(float f)
+	{
+		f = glm::clamp(f, 0.0f, 1.0f);
+		return (uint16_t)roundf(f * 65535.0f);
+	}
+
+	glm::vec2 encodeOctahedral(const glm::vec3& n)
+	{
+		float l1 = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+		if (l1 <= 0.0f) {
+			return glm::vec2(0.0f, 0.0f);
+		}
+		glm::vec2 e = glm::vec2(n.x, n.y) / l1;
+		if (n.z < 0.0f) {
+			glm::vec2 folded = glm::vec2(1.0f - glm::abs(e.y), 1.0f - glm::abs(e.x));
+			e.x = e.x >= 0.0f ? folded.x : -folded.x;
+			e.y = e.y >= 0.0f ? folded.y : -folded.y;
+		}
+		return e;
+	}
+
+	glm::vec3 decodeOctahedral(const glm::vec2& e)
+	{
+		glm::vec3 n = glm::vec3(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+		float t = glm::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return glm::normalize(n);
+	}
+
+	CompactVertex CompactLayout::encode(const Vertex& v)
+	{
+		CompactVertex c;
+		c.pos[0] = encodeHalf(v.pos.x);
+		c.pos[1] = encodeHalf(v.pos.y);
+		c.pos[2] = encodeHalf(v.pos.z);
+		c.pos[3] = encodeHalf(1.0f);
+		glm::vec2 octahedral = encodeOctahedral(v.normal);
+		c.normal[0] = encodeSnorm16(octahedral.x);
+		c.normal[1] = encodeSnorm16(octahedral.y);
+		c.uv[0] = encodeHalf(v.uv.x);
+		c.uv[1] = encodeHalf(v.uv.y);
+		return c;
+	}
+
+	glm::vec3 CompactLayout::decodePosition(const CompactVertex& v)
+	{
+		return glm::vec3(decodeHalf(v.pos[0]), decodeHalf(v.pos[1]), decodeHalf(v.pos[2]));
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ew {
+	//Full precision vertex that procGen, loaders and the mesh optimizers work with
+	struct Vertex {
+		glm::vec3 pos;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	enum class AttributeType {
+		FLOAT = 0,
+		HALF_FLOAT = 1,
+		SHORT = 2,
+		UNSIGNED_SHORT = 3
+	};
+
+	//One glVertexAttribPointer call
+	struct VertexAttribute {
+		unsigned int location;
+		int components;
+		AttributeType type;
+		bool normalized;
+		unsigned int offset;
+	};
+
+	//A layout is a struct with:
+	//	VertexType - the vertex as stored on the GPU
+	//	NUM_ATTRIBUTES and ATTRIBUTES - a constexpr table the VAO setup is unrolled from (see setupVertexArray in mesh.h)
+	//	encode(const Vertex&) and decodePosition(const VertexType&)
+	//Every layout uses locations 0-2 for position, normal and uv, so a shader picks the layout with a define
+	//instead of checking at runtime.
+
+	//32 bytes, float32 everything
+	struct StandardLayout {
+		typedef Vertex VertexType;
+		static constexpr int NUM_ATTRIBUTES = 3;
+		static constexpr VertexAttribute ATTRIBUTES[NUM_ATTRIBUTES] = {
+			{ 0, 3, AttributeType::FLOAT, false, offsetof(Vertex, pos) },
+			{ 1, 3, AttributeType::FLOAT, false, offsetof(Vertex, normal) },
+			{ 2, 2, AttributeType::FLOAT, false, offsetof(Vertex, uv) }
+		};
+		static inline const VertexAttribute* attributes() { return ATTRIBUTES; }
+		static inline Vertex encode(const Vertex& v) { return v; }
+		static inline glm::vec3 decodePosition(const Vertex& v) { return v.pos; }
+	};
+
+	struct CompactVertex {
+		uint16_t pos[4]; //Half floats, w is padding
+		int16_t normal[2]; //Octahedral, snorm16
+		uint16_t uv[2]; //Half floats, so tiled and mirrored uvs outside [0,1] survive
+	};
+	static_assert(sizeof(CompactVertex) == 16, "CompactVertex should be 16 bytes");
+
+	//16 bytes. The normal at location 1 is a vec2, so shaders drawing compact meshes are built with COMPACT_VERTEX
+	//and decode it themselves.
+	struct CompactLayout {
+		typedef CompactVertex VertexType;
+		static constexpr int NUM_ATTRIBUTES = 3;
+		static constexpr VertexAttribute ATTRIBUTES[NUM_ATTRIBUTES] = {
+			{ 0, 3, AttributeType::HALF_FLOAT, false, offsetof(CompactVertex, pos) },
+			{ 1, 2, AttributeType::SHORT, true, offsetof(CompactVertex, normal) },
+			{ 2, 2, AttributeType::HALF_FLOAT, false, offsetof(CompactVertex, uv) }
+		};
+		static inline const VertexAttribute* attributes() { return ATTRIBUTES; }
+		static CompactVertex encode(const Vertex& v);
+		static glm::vec3 decodePosition(const CompactVertex& v);
+	};
+
+	//Round to nearest half float. Out of range values become infinity.
+	uint16_t encodeHalf(float f);
+	float decodeHalf(uint16_t h);
+	int16_t encodeSnorm16(float f);
+	uint16_t encodeUnorm16(float f);
+	//Maps a unit vector to the [-1,1] square by projecting onto an octahedron and folding the lower half out
+	glm::vec2 encodeOctahedral(const glm::vec3& n);
+	glm::vec3 decodeOctahedral(const glm::vec2& e);
+}